@@ -66,17 +66,7 @@ int main(int argc, char** argv) {
     // Bind the texture
     glBindTexture(GL_TEXTURE_2D, texture);
 
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGBA,
-        image->getWidth(),
-        image->getHeight(),
-        0,
-        GL_RGBA,
-        GL_FLOAT,
-        image->getPixels()
-    );
+    uploadImage(GL_TEXTURE_2D, *image);
 
     // Texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -3,7 +3,7 @@
 #include <iostream>
 #include <glimac/Program.hpp>
 #include <glimac/FilePath.hpp>
-#include <glimac/Sphere.hpp>
+#include <glimac/ShapeRegistry.hpp>
 
 using namespace glimac;
 
@@ -45,73 +45,13 @@ int main(int argc, char** argv) {
     glm::mat4 MVMatrix = glm::translate(glm::mat4(1), glm::vec3(0, 0, -5));
     glm::mat4 NormalMatrix = glm::transpose(glm::inverse(MVMatrix));
 
-    // Create a sphere (using glimac class Sphere)
-    Sphere sphere(1, 32, 16);
-
-    // VBO creation
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-
-    // VBO binding
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    // Send data (related to the sphere) into the VBO
-    glBufferData(GL_ARRAY_BUFFER,  sphere.getVertexCount() * sizeof(ShapeVertex), sphere.getDataPointer(), GL_STATIC_DRAW);
-
-    // Unbind the VBO (to avoid errors)
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // VAO creation
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-
-    // VAO binding
-    glBindVertexArray(vao);
-
-    // Vertex attributs position
+    // Create a sphere (using glimac class ShapeRegistry): the moons are small on screen
+    // and draw one of its coarser tessellation levels
     const GLuint VERTEX_ATTR_POSITION = 0;
     const GLuint VERTEX_ATTR_NORMAL = 1;
     const GLuint VERTEX_ATTR_TEXCOORD = 2;
-
-    // Enable vertex attributes array
-    glEnableVertexAttribArray(VERTEX_ATTR_POSITION);
-    glEnableVertexAttribArray(VERTEX_ATTR_NORMAL);
-    glEnableVertexAttribArray(VERTEX_ATTR_TEXCOORD);
-
-    // Activation of vertex attributs
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    // Define arrays of attribute data
-    glVertexAttribPointer(
-        VERTEX_ATTR_POSITION,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(ShapeVertex),
-        (const GLvoid*) offsetof(ShapeVertex, position)
-    );
-    glVertexAttribPointer(
-        VERTEX_ATTR_NORMAL,
-        3,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(ShapeVertex),
-        (const GLvoid*) offsetof(ShapeVertex, normal)
-    );
-    glVertexAttribPointer(
-        VERTEX_ATTR_TEXCOORD,
-        2,
-        GL_FLOAT,
-        GL_FALSE,
-        sizeof(ShapeVertex),
-        (const GLvoid*) offsetof(ShapeVertex, texCoords)
-    );
-
-    // Unbind the VBO
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // Unbind the VAO
-    glBindVertexArray(0);
+    ShapeRegistry shapes(VERTEX_ATTR_POSITION, VERTEX_ATTR_NORMAL, VERTEX_ATTR_TEXCOORD);
+    ShapeRegistry::ShapeId sphere = shapes.getSphere(1, 32, 16);
 
     // Get a certain amount of random transformation (rotation) axes
     unsigned int moonCount = 32;
@@ -138,10 +78,10 @@ int main(int argc, char** argv) {
         glUniformMatrix4fv(MVMatrixLocation, 1, GL_FALSE, glm::value_ptr(MVMatrix));
         glUniformMatrix4fv(NormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(NormalMatrix));
 
-        // Bind the VAO
-        glBindVertexArray(vao);
+        // Bind the VAO (shared by every shape of the registry)
+        shapes.bind();
         // Drawing call
-        glDrawArrays(GL_TRIANGLES, 0, sphere.getVertexCount());
+        shapes.draw(sphere, ProjMatrix, MVMatrix, 600.f);
         // Unbind the VAO
         glBindVertexArray(0);
 
@@ -169,7 +109,7 @@ int main(int argc, char** argv) {
 
         // 3°) 32 moons moving around the earth
         // Bind the VAO
-        glBindVertexArray(vao);
+        shapes.bind();
         for(unsigned int i = 0; i < moonCount; i++) {
             // Moons transformation
             glm::mat4 MVMatrix = glm::translate(glm::mat4(1), glm::vec3(0, 0, -5)); // Translation
@@ -182,8 +122,8 @@ int main(int argc, char** argv) {
             glUniformMatrix4fv(MVMatrixLocation, 1, GL_FALSE, glm::value_ptr(MVMatrix));
             glUniformMatrix4fv(NormalMatrixLocation, 1, GL_FALSE, glm::value_ptr(NormalMatrix));
 
-            // Drawing call
-            glDrawArrays(GL_TRIANGLES, 0, sphere.getVertexCount());
+            // Drawing call (level of detail chosen from the size of the moon on screen)
+            shapes.draw(sphere, ProjMatrix, MVMatrix, 600.f);
         }
         // Unbind the VAO
         glBindVertexArray(0);
@@ -192,8 +132,5 @@ int main(int argc, char** argv) {
         windowManager.swapBuffers();
     }
 
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
-
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,59 @@
+#version 300 es
+
+precision highp float;
+precision highp int;
+
+in vec2 vTexCoords;
+
+out vec3 fFragColor;
+
+// Virtual texture (set by VirtualTexture::setUniforms)
+uniform sampler2D uVTPhysical;
+uniform sampler2D uVTPageTable;
+uniform ivec2 uVTVirtualSize;
+uniform int uVTTileSize;
+uniform int uVTBorder;
+uniform int uVTLevelCount;
+uniform ivec2 uVTSlotCount;
+
+ivec2 getLevelSize(int level) {
+    return max(uVTVirtualSize >> level, ivec2(1));
+}
+
+ivec2 getTileCount(int level) {
+    return (getLevelSize(level) + uVTTileSize - 1) / uVTTileSize;
+}
+
+// Level of the virtual mip chain with about one texel per pixel
+int getVirtualLevel(vec2 texCoords) {
+    vec2 dx = dFdx(texCoords * vec2(uVTVirtualSize));
+    vec2 dy = dFdy(texCoords * vec2(uVTVirtualSize));
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    return clamp(int(floor(lod)), 0, uVTLevelCount - 1);
+}
+
+vec4 sampleVirtualTexture(vec2 texCoords) {
+    texCoords = clamp(texCoords, 0.0, 1.0);
+    int level = getVirtualLevel(texCoords);
+    ivec2 tile = min(ivec2(texCoords * vec2(getLevelSize(level))) / uVTTileSize, getTileCount(level) - 1);
+
+    // Slot and level of the tile, or of its closest resident ancestor
+    vec4 entry = texelFetch(uVTPageTable, tile, level) * 255.0;
+    int residentLevel = int(entry.z + 0.5);
+    for (int l = level; l < residentLevel; ++l) {
+        tile = min(tile / 2, getTileCount(l + 1) - 1);
+    }
+
+    // Position in the tile, the border covering the rounding of odd level sizes
+    float tileSize = float(uVTTileSize);
+    float border = float(uVTBorder);
+    vec2 texel = texCoords * vec2(getLevelSize(residentLevel));
+    vec2 inTile = clamp(texel - vec2(tile * uVTTileSize), 0.5 - border, tileSize + border - 0.5);
+    float physicalTileSize = tileSize + 2.0 * border;
+    vec2 physical = floor(entry.xy + 0.5) * physicalTileSize + border + inTile;
+    return textureLod(uVTPhysical, physical / (vec2(uVTSlotCount) * physicalTileSize), 0.0);
+}
+
+void main() {
+    fFragColor = sampleVirtualTexture(vTexCoords).xyz;
+}
@@ -0,0 +1,41 @@
+#version 300 es
+
+precision highp float;
+precision highp int;
+
+in vec2 vTexCoords;
+
+out vec4 fFeedback;
+
+// Virtual texture (set by VirtualTexture::setUniforms)
+uniform ivec2 uVTVirtualSize;
+uniform int uVTTileSize;
+uniform int uVTLevelCount;
+
+// log2 of the feedback resolution over the screen resolution
+uniform float uVTLodBias;
+
+ivec2 getLevelSize(int level) {
+    return max(uVTVirtualSize >> level, ivec2(1));
+}
+
+ivec2 getTileCount(int level) {
+    return (getLevelSize(level) + uVTTileSize - 1) / uVTTileSize;
+}
+
+// Level of the virtual mip chain with about one texel per pixel of the screen
+int getVirtualLevel(vec2 texCoords) {
+    vec2 dx = dFdx(texCoords * vec2(uVTVirtualSize));
+    vec2 dy = dFdy(texCoords * vec2(uVTVirtualSize));
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + uVTLodBias;
+    return clamp(int(floor(lod)), 0, uVTLevelCount - 1);
+}
+
+// Tile seen by the pixel, as TileResidency::requestFeedback() reads it
+void main() {
+    vec2 texCoords = clamp(vTexCoords, 0.0, 1.0);
+    int level = getVirtualLevel(texCoords);
+    ivec2 tile = min(ivec2(texCoords * vec2(getLevelSize(level))) / uVTTileSize, getTileCount(level) - 1);
+    fFeedback = vec4(float(tile.x & 255), float(tile.y & 255), float((tile.x >> 8) | ((tile.y >> 8) << 4)),
+                     float(level + 1)) / 255.0;
+}
@@ -67,15 +67,7 @@ int main(int argc, char** argv) {
 
     // Bind the first texture
     glBindTexture(GL_TEXTURE_2D, textures[0]);
-    glTexImage2D(GL_TEXTURE_2D,
-		0,
-		GL_RGBA,
-		planetEarthTexture->getWidth(),
-		planetEarthTexture->getHeight(),
-		0,
-		GL_RGBA,
-		GL_FLOAT,
-		planetEarthTexture->getPixels());
+    uploadImage(GL_TEXTURE_2D, *planetEarthTexture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // Unbind
@@ -83,15 +75,7 @@ int main(int argc, char** argv) {
 
     // Bind the second texture
     glBindTexture(GL_TEXTURE_2D, textures[1]);
-    glTexImage2D(GL_TEXTURE_2D,
-		0,
-		GL_RGBA,
-		moonTexture->getWidth(),
-		moonTexture->getHeight(),
-		0,
-		GL_RGBA,
-		GL_FLOAT,
-		moonTexture->getPixels());
+    uploadImage(GL_TEXTURE_2D, *moonTexture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // Unbind
@@ -0,0 +1,143 @@
+#include <glimac/SDLWindowManager.hpp>
+#include <GL/glew.h>
+#include <iostream>
+
+#include <glimac/Program.hpp>
+#include <glimac/FilePath.hpp>
+#include <glimac/Sphere.hpp>
+#include <glimac/VirtualTexture.hpp>
+
+using namespace glimac;
+
+int main(int argc, char** argv) {
+    // Initialize SDL and open a window
+    SDLWindowManager windowManager(800, 600, "GLImac");
+
+    // Initialize glew for OpenGL3+ support
+    GLenum glewInitError = glewInit();
+    if(GLEW_OK != glewInitError) {
+        std::cerr << glewGetErrorString(glewInitError) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "OpenGL Version : " << glGetString(GL_VERSION) << std::endl;
+    std::cout << "GLEW Version : " << glewGetString(GLEW_VERSION) << std::endl;
+
+    // Load shaders (relative to the current directory path): one program draws the planet, the other
+    // one writes the tiles it needs in the feedback buffer
+    FilePath applicationPath(argv[0]);
+    Program program = loadProgram(
+        applicationPath.dirPath() + "shaders/3D.vs.glsl",
+        applicationPath.dirPath() + "shaders/virtualTexture.fs.glsl"
+    );
+    Program feedbackProgram = loadProgram(
+        applicationPath.dirPath() + "shaders/3D.vs.glsl",
+        applicationPath.dirPath() + "shaders/vtFeedback.fs.glsl"
+    );
+
+    // Activate GPU's depth test
+    glEnable(GL_DEPTH_TEST);
+
+    // Tiles of 128x128 pixels, baked next to the image on the first run, drawn from a cache of 8x8 tiles
+    std::unique_ptr<VirtualTexture> planetEarthTexture = VirtualTexture::load(
+        "/home/vincent/Documents/Github/GLImac/assets/textures/EarthMap.jpg", 8, 8);
+
+    if (planetEarthTexture == NULL) {
+        std::cout << "Planet Earth virtual texture unique ptr is null. Exit program." << std::endl;
+        return 0;
+    }
+
+    // The feedback pass is drawn at a quarter of the window resolution
+    FeedbackBuffer feedback(800 / 4, 600 / 4);
+
+    glm::mat4 ProjMatrix = glm::perspective(glm::radians(70.f), 800 / 600.f, 0.1f, 100.f);
+    glm::mat4 MVMatrix = glm::translate(glm::mat4(1), glm::vec3(0, 0, -5));
+    glm::mat4 NormalMatrix = glm::transpose(glm::inverse(MVMatrix));
+
+    // Create a sphere (using glimac class Sphere)
+    Sphere sphere(1, 64, 32);
+
+    // VBO creation
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER,  sphere.getVertexCount() * sizeof(ShapeVertex), sphere.getDataPointer(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // VAO creation
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // Vertex attributs position
+    const GLuint VERTEX_ATTR_POSITION = 0;
+    const GLuint VERTEX_ATTR_NORMAL = 1;
+    const GLuint VERTEX_ATTR_TEXCOORD = 2;
+
+    glEnableVertexAttribArray(VERTEX_ATTR_POSITION);
+    glEnableVertexAttribArray(VERTEX_ATTR_NORMAL);
+    glEnableVertexAttribArray(VERTEX_ATTR_TEXCOORD);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(VERTEX_ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (const GLvoid*) offsetof(ShapeVertex, position));
+    glVertexAttribPointer(VERTEX_ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (const GLvoid*) offsetof(ShapeVertex, normal));
+    glVertexAttribPointer(VERTEX_ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (const GLvoid*) offsetof(ShapeVertex, texCoords));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(0);
+
+    // Draws the planet with the program in use
+    auto drawPlanet = [&](GLuint programId) {
+        glUniformMatrix4fv(glGetUniformLocation(programId, "uMVPMatrix"), 1, GL_FALSE, glm::value_ptr(ProjMatrix * MVMatrix));
+        glUniformMatrix4fv(glGetUniformLocation(programId, "uMVMatrix"), 1, GL_FALSE, glm::value_ptr(MVMatrix));
+        glUniformMatrix4fv(glGetUniformLocation(programId, "uNormalMatrix"), 1, GL_FALSE, glm::value_ptr(NormalMatrix));
+        planetEarthTexture->setUniforms(programId, 0, 1);
+
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, sphere.getVertexCount());
+        glBindVertexArray(0);
+    };
+
+    // Application loop:
+    bool done = false;
+    while(!done) {
+        // Event loop:
+        SDL_Event e;
+        while(windowManager.pollEvent(e)) {
+            if(e.type == SDL_QUIT) {
+                done = true; // Leave the loop after this iteration
+            }
+        }
+
+        // Planet Earth transformations: it comes close to the camera and goes away, so that every level is seen
+        float distance = 3.1f - 1.9f * glm::cos(0.25f * windowManager.getTime());
+        MVMatrix = glm::translate(glm::mat4(1), glm::vec3(0, 0, -distance)); // Translation
+        MVMatrix = glm::rotate(MVMatrix, 0.2f * windowManager.getTime(), glm::vec3(0, 1, 0)); // Translation * Rotation
+        NormalMatrix = glm::transpose(glm::inverse(MVMatrix));
+
+        // Feedback pass: the tiles seen on screen, read back one frame later
+        feedback.begin();
+        feedbackProgram.use();
+        glUniform1f(glGetUniformLocation(feedbackProgram.getGLId(), "uVTLodBias"), -2.f);
+        drawPlanet(feedbackProgram.getGLId());
+        feedback.end();
+
+        // Loads the missing tiles of the previous feedback pass
+        planetEarthTexture->processFeedback(feedback);
+        planetEarthTexture->update();
+
+        // Clean the depth buffer on each loop
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        program.use();
+        drawPlanet(program.getGLId());
+
+        // Update the display
+        windowManager.swapBuffers();
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+
+    return EXIT_SUCCESS;
+}
@@ -1,11 +1,11 @@
 #include <glimac/SDLWindowManager.hpp>
 #include <GL/glew.h>
-#include <stb/stb_image.hpp>
 
 #include <glimac/Program.hpp>
 #include <glimac/FilePath.hpp>
 #include <glimac/Sphere.hpp>
 #include <glimac/Image.hpp>
+#include <glimac/Cubemap.hpp>
 #include <glimac/FreeflyCamera.hpp>
 
 #include <vector>
@@ -13,36 +13,6 @@
 
 using namespace glimac;
 
-unsigned int loadCubemap(std::vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
-
 struct PlanetProgram
 {
     Program m_Program;
@@ -223,14 +193,14 @@ int main(int argc, char **argv)
     glBindVertexArray(0);
 
     // Cubemap (Skybox)
-    std::vector<std::string> faces;
-
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/right.png");
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/left.png");
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/top.png");
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/bottom.png");
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/front.png");
-    faces.push_back("/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/back.png");
+    CubemapPaths faces = {{
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/right.png",
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/left.png",
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/top.png",
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/bottom.png",
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/front.png",
+        "/home/vincent/Documents/Github/GLImac/assets/textures/skybox/space/back.png"
+    }};
 
     GLuint cubemapTexture = loadCubemap(faces);
 
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+// Best time of repeatCount calls of f, in milliseconds
+template<typename Function>
+double measure(const Function& f, unsigned int repeatCount = 3u) {
+    auto best = std::numeric_limits<double>::max();
+    for (auto i = 0u; i < repeatCount; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
@@ -0,0 +1,161 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <glimac/BVH.hpp>
+#include "Benchmark.hpp"
+
+using namespace glimac;
+
+// Builds the BVH of a model and traces 512x512 primary rays through it, one by one and in packets of
+// 4 (2x2 pixels) and 8 (4x2 pixels), for the closest hit and any hit.
+//
+// Usage: bench_bvh [model.obj [mtl base path]], a 300x300 height field by default
+
+namespace {
+
+bool writeHeightField(const char* path, unsigned int side) {
+    auto pFile = std::fopen(path, "w");
+    if (!pFile) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> height(0.f, 1.f);
+    for (auto j = 0u; j < side; ++j) {
+        for (auto i = 0u; i < side; ++i) {
+            std::fprintf(pFile, "v %u %u %f\n", i, j, height(random));
+        }
+    }
+    for (auto j = 0u; j + 1 < side; ++j) {
+        for (auto i = 0u; i + 1 < side; ++i) {
+            auto a = j * side + i + 1, b = a + 1, c = a + side, d = c + 1;
+            std::fprintf(pFile, "f %u %u %u\nf %u %u %u\n", a, b, d, a, d, c);
+        }
+    }
+    std::fclose(pFile);
+    return true;
+}
+
+const auto WIDTH = 512u, HEIGHT = 512u;
+
+// Packet of the w x h pixels from (x, y)
+template<unsigned int N>
+RayPacket<N> getPacket(const std::vector<Ray>& rays, unsigned int x, unsigned int y, unsigned int w) {
+    RayPacket<N> packet;
+    for (auto i = 0u; i < N; ++i) {
+        packet.set(i, rays[(y + i / w) * WIDTH + x + i % w]);
+    }
+    return packet;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const char* heightFieldPath = "heightfield.obj";
+    FilePath modelPath = argc > 1 ? argv[1] : heightFieldPath;
+    FilePath mtlBasePath = argc > 2 ? argv[2] : "";
+    if (argc <= 1 && !writeHeightField(heightFieldPath, 300u)) {
+        return EXIT_FAILURE;
+    }
+
+    Geometry geometry;
+    std::clog.setstate(std::ios::failbit); // Loading messages
+    auto loaded = geometry.loadOBJ(modelPath, mtlBasePath, false);
+    std::clog.clear();
+    if (argc <= 1) {
+        std::remove(heightFieldPath);
+    }
+    if (!loaded) {
+        return EXIT_FAILURE;
+    }
+
+    BVH bvh;
+    auto buildTime = measure([&]() {
+        bvh.build(geometry);
+    });
+    std::cout << modelPath << ": " << bvh.getTriangleCount() << " triangles, build " << buildTime << " ms, "
+              << bvh.getNodes().size() << " nodes" << std::endl;
+
+    // From the front of the model, a little above it
+    auto box = bvh.getBoundingBox();
+    auto center = 0.5f * (box.lower + box.upper);
+    auto radius = glm::length(box.size());
+    auto eye = center + glm::vec3(0.1f * radius, 0.2f * radius, 1.2f * radius);
+    std::vector<Ray> rays;
+    rays.reserve(WIDTH * HEIGHT);
+    for (auto y = 0u; y < HEIGHT; ++y) {
+        for (auto x = 0u; x < WIDTH; ++x) {
+            auto offset = glm::vec3((float(x) - WIDTH / 2) / WIDTH, (float(y) - HEIGHT / 2) / HEIGHT, 0.f) * radius;
+            rays.emplace_back(eye, glm::normalize(center - eye + offset));
+        }
+    }
+
+    auto report = [&](const char* name, double time, size_t hitCount) {
+        std::cout << name << rays.size() / time / 1000. << " Mrays/s (" << hitCount << " hits)" << std::endl;
+    };
+
+    size_t hitCount = 0u;
+    auto time = measure([&]() {
+        hitCount = 0u;
+        for (const auto& ray: rays) {
+            RayHit hit;
+            hitCount += bvh.intersect(ray, hit);
+        }
+    });
+    report("closest hit, single rays  ", time, hitCount);
+
+    time = measure([&]() {
+        hitCount = 0u;
+        for (const auto& ray: rays) {
+            hitCount += bvh.occluded(ray);
+        }
+    });
+    report("any hit, single rays      ", time, hitCount);
+
+    time = measure([&]() {
+        hitCount = 0u;
+        for (auto y = 0u; y < HEIGHT; y += 2) {
+            for (auto x = 0u; x < WIDTH; x += 2) {
+                RayHit hits[4];
+                bvh.intersect(getPacket<4>(rays, x, y, 2), hits);
+                for (const auto& hit: hits) {
+                    hitCount += hit.hit();
+                }
+            }
+        }
+    });
+    report("closest hit, packets of 4 ", time, hitCount);
+
+    time = measure([&]() {
+        hitCount = 0u;
+        for (auto y = 0u; y < HEIGHT; y += 2) {
+            for (auto x = 0u; x < WIDTH; x += 4) {
+                RayHit hits[8];
+                bvh.intersect(getPacket<8>(rays, x, y, 4), hits);
+                for (const auto& hit: hits) {
+                    hitCount += hit.hit();
+                }
+            }
+        }
+    });
+    report("closest hit, packets of 8 ", time, hitCount);
+
+    time = measure([&]() {
+        hitCount = 0u;
+        for (auto y = 0u; y < HEIGHT; y += 2) {
+            for (auto x = 0u; x < WIDTH; x += 4) {
+                bool occluded[8];
+                bvh.occluded(getPacket<8>(rays, x, y, 4), occluded);
+                for (auto hit: occluded) {
+                    hitCount += hit;
+                }
+            }
+        }
+    });
+    report("any hit, packets of 8     ", time, hitCount);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "tiny_obj_loader.h"
+#include "Benchmark.hpp"
+
+// Loads a large synthetic OBJ: 4 groups of a side x side grid with positions, texture coordinates and
+// normals, faces mixing quads and triangles, absolute and relative indices, so that every face corner
+// goes through the vertex deduplication.
+//
+// Usage: bench_obj-loading [side (640)] [path of the generated file (synthetic.obj)]
+
+namespace {
+
+bool writeSyntheticOBJ(const char* path, unsigned int side) {
+    auto pFile = std::fopen(path, "w");
+    if (!pFile) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> height(0.f, 0.1f);
+    auto vertexCount = 0u;
+    for (auto group = 0u; group < 4u; ++group) {
+        std::fprintf(pFile, "g part%u\n", group);
+        for (auto j = 0u; j < side; ++j) {
+            for (auto i = 0u; i < side; ++i) {
+                std::fprintf(pFile, "v %f %f %f\n", i * 0.01f + group, j * 0.01f, height(random));
+                std::fprintf(pFile, "vt %f %f\n", float(i) / side, float(j) / side);
+                std::fprintf(pFile, "vn 0 0 1\n");
+            }
+        }
+        auto first = vertexCount + 1; // OBJ indices start at 1
+        vertexCount += side * side;
+        for (auto j = 0u; j + 1 < side; ++j) {
+            for (auto i = 0u; i + 1 < side; ++i) {
+                int a = first + j * side + i, b = a + 1, c = a + side, d = c + 1;
+                if ((i + j) % 3 == 0) {
+                    // Relative to the last vertex
+                    int last = vertexCount + 1;
+                    std::fprintf(pFile, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a - last, a - last, a - last,
+                                 b - last, b - last, b - last, d - last, d - last, d - last, c - last, c - last, c - last);
+                } else {
+                    std::fprintf(pFile, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, d, d, d);
+                    std::fprintf(pFile, "f %d//%d %d//%d %d//%d\n", a, a, d, d, c, c);
+                }
+            }
+        }
+    }
+    std::fclose(pFile);
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    unsigned int side = argc > 1 ? std::atoi(argv[1]) : 640u;
+    const char* path = argc > 2 ? argv[2] : "synthetic.obj";
+
+    if (!writeSyntheticOBJ(path, side)) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    size_t vertexCount = 0u, indexCount = 0u;
+    auto countVertices = [&]() {
+        vertexCount = indexCount = 0u;
+        for (const auto& shape: shapes) {
+            vertexCount += shape.mesh.positions.size() / 3;
+            indexCount += shape.mesh.indices.size();
+        }
+    };
+
+    auto streamTime = measure([&]() {
+        std::ifstream file(path, std::ios::binary);
+        tinyobj::MaterialFileReader materialReader("");
+        shapes.clear(); // Appended to by the istream loader
+        materials.clear();
+        auto error = tinyobj::LoadObj(shapes, materials, file, materialReader);
+        if (!error.empty()) {
+            std::cerr << error;
+        }
+    });
+    countVertices();
+    std::cout << path << ": " << vertexCount << " vertices, " << indexCount / 3 << " triangles" << std::endl;
+    std::cout << "LoadObj(istream), one thread   " << streamTime << " ms" << std::endl;
+
+    auto serialTime = measure([&]() {
+        tinyobj::LoadObj(shapes, materials, path, nullptr, 1u);
+    });
+    std::cout << "LoadObj(filename), one thread  " << serialTime << " ms" << std::endl;
+
+    auto parallelTime = measure([&]() {
+        tinyobj::LoadObj(shapes, materials, path);
+    });
+    std::cout << "LoadObj(filename), all threads " << parallelTime << " ms" << std::endl;
+
+    std::remove(path);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <cstdlib>
+#include <random>
+
+#include <glimac/ImageKernels.hpp>
+#include <glimac/Image.hpp>
+#include "Benchmark.hpp"
+
+using namespace glimac;
+
+// Throughput of the pixel kernels on an RGBA image of random pixels
+//
+// Usage: bench_pixel-kernels [side (8192)]
+
+int main(int argc, char** argv) {
+    size_t side = argc > 1 ? std::atoi(argv[1]) : 8192u;
+    auto pixelCount = side * side;
+
+    std::vector<uint8_t> pixels(4 * pixelCount), result(4 * pixelCount);
+    std::vector<float> floats(4 * pixelCount);
+    std::mt19937 random(1);
+    for (auto& value: pixels) {
+        value = uint8_t(random());
+    }
+
+    auto report = [pixelCount](const char* name, double time) {
+        std::cout << name << time << " ms, " << pixelCount / time / 1000. << " Mpixels/s" << std::endl;
+    };
+
+    std::cout << side << "x" << side << " RGBA pixels" << std::endl;
+    report("unorm8ToFloat        ", measure([&]() {
+        unorm8ToFloat(pixels.data(), floats.data(), 4 * pixelCount);
+    }));
+    report("floatToUnorm8        ", measure([&]() {
+        floatToUnorm8(floats.data(), result.data(), 4 * pixelCount);
+    }));
+    report("srgb8ToLinear        ", measure([&]() {
+        srgb8ToLinear(pixels.data(), floats.data(), pixelCount);
+    }));
+    report("linearToSrgb8        ", measure([&]() {
+        linearToSrgb8(floats.data(), result.data(), pixelCount);
+    }));
+    result = pixels;
+    report("premultiplyAlpha u8  ", measure([&]() {
+        premultiplyAlpha(result.data(), pixelCount);
+    }));
+    unorm8ToFloat(pixels.data(), floats.data(), 4 * pixelCount);
+    report("premultiplyAlpha f32 ", measure([&]() {
+        premultiplyAlpha(reinterpret_cast<glm::vec4*>(floats.data()), pixelCount);
+    }));
+    report("flipVertically       ", measure([&]() {
+        flipVertically(result.data(), 4 * side, side);
+    }));
+    report("swizzle BGRA         ", measure([&]() {
+        swizzle(pixels.data(), result.data(), pixelCount, {{ 2u, 1u, 0u, 3u }});
+    }));
+    report("expandToRGBA8 R8     ", measure([&]() {
+        expandToRGBA8(pixels.data(), 1u, result.data(), pixelCount);
+    }));
+    report("expandToRGBA8 RG8    ", measure([&]() {
+        expandToRGBA8(pixels.data(), 2u, result.data(), pixelCount);
+    }));
+    report("expandToRGBA8 RGB8   ", measure([&]() {
+        expandToRGBA8(pixels.data(), 3u, result.data(), pixelCount);
+    }));
+
+    Image image(side, side, PixelFormat::RGBA8);
+    std::copy(begin(pixels), end(pixels), image.getData());
+    report("Image RGBA8->RGBA32F ", measure([&]() {
+        image.convert(PixelFormat::RGBA32F);
+    }));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <cstdlib>
+
+#include <glimac/Sphere.hpp>
+#include <glimac/Cone.hpp>
+#include "Benchmark.hpp"
+
+using namespace glimac;
+
+// Builds 1000 high resolution shapes, as a procedural scene would at startup
+//
+// Usage: bench_shapes [shape count (1000)]
+
+int main(int argc, char** argv) {
+    unsigned int count = argc > 1 ? std::atoi(argv[1]) : 1000u;
+
+    // Sums of the vertex counts, so that the builds can't be optimized away
+    size_t vertexCount = 0u;
+
+    auto time = measure([&]() {
+        for (auto i = 0u; i < count; ++i) {
+            vertexCount += Sphere::buildIndexed(1.f, 256, 128).getVertexCount();
+        }
+    }, 1u);
+    std::cout << count << " x Sphere::buildIndexed(256x128)  " << time << " ms" << std::endl;
+
+    time = measure([&]() {
+        for (auto i = 0u; i < count; ++i) {
+            vertexCount += Cone::buildIndexed(1.f, 1.f, 256, 64).getVertexCount();
+        }
+    }, 1u);
+    std::cout << count << " x Cone::buildIndexed(256x64)     " << time << " ms" << std::endl;
+
+    time = measure([&]() {
+        for (auto i = 0u; i < count; ++i) {
+            vertexCount += Sphere(1.f, 64, 32).getVertexCount();
+        }
+    }, 1u);
+    std::cout << count << " x Sphere(64x32), not indexed     " << time << " ms" << std::endl;
+
+    return vertexCount ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include "glm.hpp"
+#include "BBox.hpp"
+#include "Geometry.hpp"
+
+namespace glimac {
+
+struct Ray {
+    glm::vec3 m_Origin;
+    glm::vec3 m_Direction; // Doesn't need to be normalized, distances are expressed in its unit
+    float m_fTMin = 0.f;
+    float m_fTMax = std::numeric_limits<float>::infinity();
+
+    Ray() = default;
+
+    Ray(const glm::vec3& origin, const glm::vec3& direction,
+        float tMin = 0.f, float tMax = std::numeric_limits<float>::infinity()):
+        m_Origin(origin), m_Direction(direction), m_fTMin(tMin), m_fTMax(tMax) {
+    }
+
+    /*! segment between two points, for line of sight queries */
+    static Ray segment(const glm::vec3& from, const glm::vec3& to, float epsilon = 1e-4f) {
+        return Ray(from, to - from, epsilon, 1.f - epsilon);
+    }
+};
+
+struct RayHit {
+    float m_fDistance = std::numeric_limits<float>::infinity();
+    unsigned int m_nTriangleIndex = ~0u; // Index of the triangle in the Geometry index buffer (first index / 3)
+    glm::vec2 m_Barycentrics; // Weights of the second and third vertices of the triangle
+
+    bool hit() const {
+        return m_nTriangleIndex != ~0u;
+    }
+};
+
+// Coherent rays traced together, stored as structure of arrays. N must be a multiple of 4.
+template<unsigned int N>
+struct RayPacket {
+    static const unsigned int size = N;
+
+    float m_OriginX[N], m_OriginY[N], m_OriginZ[N];
+    float m_DirectionX[N], m_DirectionY[N], m_DirectionZ[N];
+    float m_TMin[N], m_TMax[N];
+
+    void set(unsigned int i, const Ray& ray) {
+        m_OriginX[i] = ray.m_Origin.x; m_OriginY[i] = ray.m_Origin.y; m_OriginZ[i] = ray.m_Origin.z;
+        m_DirectionX[i] = ray.m_Direction.x; m_DirectionY[i] = ray.m_Direction.y; m_DirectionZ[i] = ray.m_Direction.z;
+        m_TMin[i] = ray.m_fTMin;
+        m_TMax[i] = ray.m_fTMax;
+    }
+
+    Ray get(unsigned int i) const {
+        return Ray(glm::vec3(m_OriginX[i], m_OriginY[i], m_OriginZ[i]),
+                   glm::vec3(m_DirectionX[i], m_DirectionY[i], m_DirectionZ[i]), m_TMin[i], m_TMax[i]);
+    }
+};
+
+typedef RayPacket<4> RayPacket4;
+typedef RayPacket<8> RayPacket8;
+
+// Bounding volume hierarchy over the triangles of a Geometry, built with a binned SAH.
+// Nodes are stored depth first in a flat array: the left child of an inner node follows it.
+class BVH {
+public:
+    struct Node {
+        float m_Lower[3];
+        unsigned int m_nOffset; // Inner node: index of the right child. Leaf: first triangle.
+        float m_Upper[3];
+        unsigned int m_nCount; // Inner node: INNER_FLAG | split axis. Leaf: number of triangles.
+
+        static const unsigned int INNER_FLAG = 0x80000000u;
+
+        bool isLeaf() const {
+            return !(m_nCount & INNER_FLAG);
+        }
+
+        unsigned int getAxis() const {
+            return m_nCount & 3u;
+        }
+    };
+
+    BVH() = default;
+
+    explicit BVH(const Geometry& geometry) {
+        build(geometry);
+    }
+
+    void build(const Geometry& geometry);
+
+    // Closest hit along the ray, returns false if nothing is hit
+    bool intersect(const Ray& ray, RayHit& hit) const;
+
+    // Returns true as soon as any triangle is hit in [tMin, tMax]
+    bool occluded(const Ray& ray) const;
+
+    // Closest hits of a packet of rays. The box tests are done for all rays at once (SSE when available).
+    template<unsigned int N>
+    void intersect(const RayPacket<N>& packet, RayHit hits[N]) const;
+
+    template<unsigned int N>
+    void occluded(const RayPacket<N>& packet, bool occluded[N]) const;
+
+    const std::vector<Node>& getNodes() const {
+        return m_Nodes;
+    }
+
+    size_t getTriangleCount() const {
+        return m_Triangles.size();
+    }
+
+    BBox3f getBoundingBox() const {
+        if (m_Nodes.empty()) {
+            return BBox3f(glm::vec3(0.f));
+        }
+        return BBox3f(glm::vec3(m_Nodes[0].m_Lower[0], m_Nodes[0].m_Lower[1], m_Nodes[0].m_Lower[2]),
+                      glm::vec3(m_Nodes[0].m_Upper[0], m_Nodes[0].m_Upper[1], m_Nodes[0].m_Upper[2]));
+    }
+
+private:
+    // Triangles are copied in leaf order
+    struct Triangle {
+        glm::vec3 m_V0, m_E1, m_E2; // First vertex and edges
+        unsigned int m_nIndex;
+    };
+
+    std::vector<Node> m_Nodes;
+    std::vector<Triangle> m_Triangles;
+
+    bool intersectTriangle(const Triangle& triangle, const Ray& ray, float tMax, float& t, glm::vec2& uv) const;
+
+    template<unsigned int N>
+    void traverse(const RayPacket<N>& packet, RayHit hits[N], bool anyHit) const;
+};
+
+// Ray going from the camera through the pixel at windowPosition (origin at the top left of the window,
+// as given by SDLWindowManager::getMousePosition())
+Ray getPickingRay(const glm::mat4& projMatrix, const glm::mat4& viewMatrix,
+                  const glm::ivec2& windowPosition, const glm::ivec2& windowSize);
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "Image.hpp"
+
+namespace glimac {
+
+// Formats of 4x4 pixels blocks
+enum class CompressedFormat {
+    BC1,     // RGB, 8 bytes per block (DXT1, opaque)
+    BC3,     // RGBA, 16 bytes per block (DXT5): BC1 colors and a BC4 alpha block
+    BC5,     // RG, 16 bytes per block (RGTC2): two BC4 blocks, for normal maps
+    BC7,     // RGBA, 16 bytes per block, mode 6 only (one subset, 7777.1 endpoints, 4 bits indices)
+    ETC2_RGB // RGB, 8 bytes per block, ETC1 individual and differential modes only
+};
+
+enum class CompressionQuality {
+    Fast,   // endpoints on the principal axis of the block
+    High    // plus least squares refinement and wider searches, 1.5 to 5 times slower
+};
+
+const char* getName(CompressedFormat format);
+
+// Bytes per 4x4 block
+size_t getBlockSize(CompressedFormat format);
+
+// BC1, BC3, BC7 and ETC2_RGB have an sRGB variant, BC5 has none
+GLenum getGLInternalFormat(CompressedFormat format, bool sRGB);
+
+class CompressedImage {
+public:
+    CompressedImage(unsigned int width, unsigned int height, CompressedFormat format, bool sRGB);
+
+    unsigned int getWidth() const {
+        return m_nWidth;
+    }
+
+    unsigned int getHeight() const {
+        return m_nHeight;
+    }
+
+    CompressedFormat getFormat() const {
+        return m_Format;
+    }
+
+    bool isSRGB() const {
+        return m_bSRGB;
+    }
+
+    unsigned int getBlockCountX() const {
+        return (m_nWidth + 3) / 4;
+    }
+
+    unsigned int getBlockCountY() const {
+        return (m_nHeight + 3) / 4;
+    }
+
+    const uint8_t* getData() const {
+        return m_Data.data();
+    }
+
+    uint8_t* getData() {
+        return m_Data.data();
+    }
+
+    size_t getDataSize() const {
+        return m_Data.size();
+    }
+
+private:
+    unsigned int m_nWidth;
+    unsigned int m_nHeight;
+    CompressedFormat m_Format;
+    bool m_bSRGB;
+    std::vector<uint8_t> m_Data; // Blocks row by row, from the first row of the image
+};
+
+// Encodes the RGBA8 pixels of the image, converted first if needed (float images are clamped):
+// SRGB8_A8 images give an sRGB texture, compressed in their encoded space.
+// Rows of blocks are split between threads. Edge blocks of sizes that are not multiples of 4
+// repeat the last row and column.
+std::unique_ptr<CompressedImage> compressImage(const Image& image, CompressedFormat format,
+                                               CompressionQuality quality = CompressionQuality::Fast);
+
+// glCompressedTexImage2D on the bound texture
+void uploadCompressedImage(GLenum target, const CompressedImage& image, GLint level = 0);
+
+// The file records a hash of the source image and the settings: loadCompressedImage() fails
+// if one of them changed since saveCompressedImage()
+bool saveCompressedImage(const FilePath& filepath, const Image& source, CompressionQuality quality,
+                         const CompressedImage& image);
+
+std::unique_ptr<CompressedImage> loadCompressedImage(const FilePath& filepath, const Image& source,
+                                                     CompressedFormat format, CompressionQuality quality);
+
+// Cache file of the blocks of the image loaded from imagePath, next to it, one per format
+FilePath getCompressedCachePath(const FilePath& imagePath, CompressedFormat format);
+
+// Blocks from the cache file of the image, compressed and saved there when missing or out of date
+std::unique_ptr<CompressedImage> loadOrCompressImage(const FilePath& imagePath, const Image& image,
+                                                     CompressedFormat format,
+                                                     CompressionQuality quality = CompressionQuality::Fast);
+
+}
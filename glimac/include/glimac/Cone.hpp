@@ -2,6 +2,7 @@
 
 #include <vector>
 #include "common.hpp"
+#include "IndexedShape.hpp"
 
 namespace glimac {
     
@@ -18,6 +19,9 @@ public:
         build(height, radius, discLat, discHeight); // Construction (voir le .cpp)
     }
 
+    // Sommets partagés et indices des triangles, à dessiner avec glDrawElements (voir uploadShape())
+    static IndexedShape buildIndexed(GLfloat height, GLfloat radius, GLsizei discLat, GLsizei discHeight);
+
     // Renvoit le pointeur vers les données
     const ShapeVertex* getDataPointer() const {
         return &m_Vertices[0];
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+
+#include "Image.hpp"
+
+namespace glimac {
+
+// Faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + face: right, left, top, bottom, front, back
+typedef std::array<FilePath, 6> CubemapPaths;
+typedef std::array<ImageHandle, 6> CubemapFaces;
+
+// Decodes the 6 faces at the same time, on the library thread pool and on the calling thread, through
+// ImageManager which keeps them cached. Fails with a message if a face can't be loaded, or if the faces
+// are not square images of a same size and format.
+bool loadCubemapFaces(const CubemapPaths& filepaths, CubemapFaces& faces);
+
+// Allocates immutable storage (glTexStorage2D) on the bound GL_TEXTURE_CUBE_MAP and uploads the faces.
+// Faces read from texture containers give every level of their containers, else the other levels are
+// filled by glGenerateMipmap if generateMipmaps is set. Returns the number of levels.
+unsigned int uploadCubemap(const CubemapFaces& faces, bool generateMipmaps = false);
+
+// New cube map texture of the faces, filtered linearly (and between levels if it has several) and clamped
+// to its edges. Returns 0 if the faces can't be loaded.
+GLuint loadCubemap(const CubemapPaths& filepaths, bool generateMipmaps = false);
+
+}
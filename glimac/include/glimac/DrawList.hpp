@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <array>
+#include <cstdint>
+#include "Geometry.hpp"
+
+namespace glimac {
+
+struct DrawCommand {
+    uint64_t m_nStateKey; // See DrawList::makeStateKey()
+    unsigned int m_nVertexArray; // VAO of the geometry, which identifies its index buffer
+    unsigned int m_nIndexOffset; // Offset in the index buffer of the VAO
+    unsigned int m_nIndexCount;
+};
+
+struct DrawListStatistics {
+    unsigned int m_nCommandCount; // After merging
+    unsigned int m_nProgramChanges;
+    unsigned int m_nTextureChanges;
+    unsigned int m_nVertexArrayChanges;
+    unsigned int m_nMaterialChanges;
+    unsigned int m_nSavedStateChanges; // State changes of the submission order minus those of the sorted order
+};
+
+// Draw commands of a frame, sorted by state so that a render loop binds each program, texture set, VAO
+// and material as few times as possible: by state key, the VAO coming between the texture set and the
+// material. Commands with the same state and VAO and adjacent index ranges are merged.
+class DrawList {
+public:
+    // Bits of the state changes passed to the function given to execute()
+    static const unsigned int PROGRAM_CHANGED = 1u;
+    static const unsigned int TEXTURES_CHANGED = 2u;
+    static const unsigned int MATERIAL_CHANGED = 4u;
+    static const unsigned int VERTEX_ARRAY_CHANGED = 8u;
+
+    // Packs the state of a draw, most expensive state changes in the high bits:
+    // program (16 bits), texture set (24 bits), material (24 bits, -1 for none)
+    static uint64_t makeStateKey(unsigned int program, unsigned int textureSet, int materialIndex) {
+        return (uint64_t(program & 0xFFFFu) << 48) | (uint64_t(textureSet & 0xFFFFFFu) << 24)
+            | uint64_t(unsigned(materialIndex + 1) & 0xFFFFFFu);
+    }
+
+    static unsigned int getProgram(uint64_t key) {
+        return unsigned(key >> 48);
+    }
+
+    static unsigned int getTextureSet(uint64_t key) {
+        return unsigned(key >> 24) & 0xFFFFFFu;
+    }
+
+    static int getMaterialIndex(uint64_t key) {
+        return int(key & 0xFFFFFFu) - 1;
+    }
+
+    void clear() {
+        m_Commands.clear();
+    }
+
+    void add(uint64_t stateKey, unsigned int vertexArray, unsigned int indexOffset, unsigned int indexCount);
+
+    // Adds every mesh of a geometry drawn with program from vertexArray, its VAO. The texture set of each
+    // material is numbered after its maps, so that materials sharing the same images share the same
+    // texture set, whatever their geometry.
+    void add(const Geometry& geometry, unsigned int program, unsigned int vertexArray);
+
+    // Sorts the commands by state key and merges them, updates the statistics
+    void sort();
+
+    const std::vector<DrawCommand>& getCommands() const {
+        return m_Commands;
+    }
+
+    const DrawListStatistics& getStatistics() const {
+        return m_Statistics;
+    }
+
+    // Calls f(command, changes) for each command, changes being a combination of the *_CHANGED bits:
+    // bind command.m_nVertexArray on VERTEX_ARRAY_CHANGED
+    template<typename Function>
+    void execute(const Function& f) const {
+        for (auto i = 0u; i < m_Commands.size(); ++i) {
+            f(m_Commands[i], i == 0u ? PROGRAM_CHANGED | TEXTURES_CHANGED | VERTEX_ARRAY_CHANGED | MATERIAL_CHANGED :
+                                       stateChanges(m_Commands[i - 1], m_Commands[i]));
+        }
+    }
+
+    // Material indices belong to their geometry: a new VAO is a new material too
+    static unsigned int stateChanges(const DrawCommand& previous, const DrawCommand& command) {
+        auto vertexArrayChanged = previous.m_nVertexArray != command.m_nVertexArray;
+        return (getProgram(previous.m_nStateKey) != getProgram(command.m_nStateKey) ? PROGRAM_CHANGED : 0u)
+            | (getTextureSet(previous.m_nStateKey) != getTextureSet(command.m_nStateKey) ? TEXTURES_CHANGED : 0u)
+            | (vertexArrayChanged ? VERTEX_ARRAY_CHANGED : 0u)
+            | (vertexArrayChanged || getMaterialIndex(previous.m_nStateKey) != getMaterialIndex(command.m_nStateKey) ? MATERIAL_CHANGED : 0u);
+    }
+
+private:
+    std::vector<DrawCommand> m_Commands;
+    DrawListStatistics m_Statistics = { 0u, 0u, 0u, 0u, 0u, 0u };
+    std::map<std::array<const Image*, 4>, unsigned int> m_TextureSets;
+};
+
+}
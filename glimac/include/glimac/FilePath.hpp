@@ -1,6 +1,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <cstdlib>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 namespace glimac {
 
@@ -63,6 +68,58 @@ public:
         return FilePath(m_FilePath + ext);
     }
 
+    /*! returns the absolute path with symbolic links resolved if the file exists, else the absolute
+        path (its directory resolved if it exists) without its "." and "dir/.." components: spellings of
+        a same file give a same key, whether it exists or not */
+    FilePath canonical() const {
+        if (m_FilePath.empty()) { return FilePath(); }
+#ifdef _WIN32
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, m_FilePath.c_str(), _MAX_PATH)) { return FilePath(resolved); }
+        std::string path = m_FilePath;
+#else
+        if (char* resolved = realpath(m_FilePath.c_str(), nullptr)) {
+            FilePath result(resolved);
+            free(resolved);
+            return result;
+        }
+        std::string path = m_FilePath;
+        if (path.front() != PATH_SEPARATOR) {
+            if (char* cwd = getcwd(nullptr, 0)) {
+                path = std::string(cwd) + PATH_SEPARATOR + path;
+                free(cwd);
+            }
+        }
+        FilePath absolute(path);
+        std::string file = absolute.file();
+        if (file != "." && file != "..") {
+            if (char* resolved = realpath(absolute.dirPath().c_str(), nullptr)) {
+                path = std::string(resolved) + PATH_SEPARATOR + file;
+                free(resolved);
+            }
+        }
+#endif
+        std::vector<std::string> components;
+        size_t begin = 0;
+        while (begin <= path.size()) {
+            size_t end = path.find(PATH_SEPARATOR, begin);
+            if (end == std::string::npos) { end = path.size(); }
+            std::string component = path.substr(begin, end - begin);
+            if (component == ".." && !components.empty() && components.back() != ".." && !components.back().empty()) {
+                components.pop_back();
+            } else if (component != "." && (!component.empty() || components.empty())) {
+                components.push_back(component); // An empty first component is the root
+            }
+            begin = end + 1;
+        }
+        std::string result;
+        for (size_t i = 0; i < components.size(); ++i) {
+            if (i) { result += PATH_SEPARATOR; }
+            result += components[i];
+        }
+        return FilePath(result);
+    }
+
     /*! concatenates two filepaths to this/other */
     FilePath operator +(const FilePath& other) const {
         if (m_FilePath.empty()) {
@@ -3,12 +3,18 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include <future>
 #include "Image.hpp"
 #include "FilePath.hpp"
 #include "BBox.hpp"
+#include "VertexPacking.hpp"
+#include "Meshlet.hpp"
+#include "VertexStreams.hpp"
 
 namespace glimac {
 
+class TextureAtlas;
+
 class Geometry {
 public:
     struct Vertex {
@@ -22,6 +28,10 @@ public:
         unsigned int m_nIndexOffset; // Offset in the index buffer
         unsigned int m_nIndexCount; // Number of indices
         int m_nMaterialIndex; // -1 if no material assigned
+        unsigned int m_nMeshletOffset = 0; // Offset in the meshlet buffer
+        unsigned int m_nMeshletCount = 0; // Number of meshlets, 0 until buildMeshlets() is called
+        unsigned int m_nLodOffset = 0; // Offset in the LOD buffer
+        unsigned int m_nLodCount = 0; // Number of simplified levels, the mesh itself excluded
 
         Mesh(std::string name, unsigned int indexOffset, unsigned int indexCount, int materialIndex):
             m_sName(move(name)), m_nIndexOffset(indexOffset), m_nIndexCount(indexCount), m_nMaterialIndex(materialIndex) {
@@ -41,19 +51,58 @@ public:
         const Image* m_pKdMap;
         const Image* m_pKsMap;
         const Image* m_pNormalMap;
+        int m_nKdLayer = -1; // Layer of m_pKdMap in the atlas of packDiffuseMaps(), -1 if none
+    };
+
+    // Simplified version of a mesh, indexing the same vertices
+    struct Lod {
+        unsigned int m_nIndexOffset; // Offset in the LOD index buffer
+        unsigned int m_nIndexCount; // Number of indices
+        float m_fError; // Largest distance to the original surface, in object units
+    };
+
+    // Levels of detail of every mesh, computed by computeLods() and applied by setLods().
+    // Offsets of m_Lods are relative to m_Indices, m_Indices are global vertex indices.
+    struct LodChain {
+        std::vector<unsigned int> m_Indices;
+        std::vector<Lod> m_Lods;
+        std::vector<unsigned int> m_LodCounts; // Number of levels of each mesh
+    };
+
+    enum class NormalWeighting {
+        Area, // Faces contribute proportionally to their area
+        Angle // Faces contribute proportionally to their angle at the vertex
     };
 
 private:
-    std::vector<Vertex> m_VertexBuffer;
+    // The vertex buffer is out of date while the streams are edited, and rebuilt when it is read
+    mutable std::vector<Vertex> m_VertexBuffer;
+    mutable bool m_bVertexBufferValid = true;
+    mutable VertexStreams m_VertexStreams;
+    mutable bool m_bVertexStreamsValid = false;
     std::vector<unsigned int> m_IndexBuffer;
     std::vector<Mesh> m_MeshBuffer;
     std::vector<Material> m_Materials;
+    std::vector<ImageHandle> m_Textures; // Keep the texture maps of the materials loaded
+    std::vector<Meshlet> m_Meshlets;
+    std::vector<Lod> m_Lods;
+    std::vector<unsigned int> m_LodIndexBuffer; // Indices of m_Lods, apart so that the index buffer only holds the meshes
     BBox3f m_BBox;
 
-    void generateNormals(unsigned int meshIndex);
+    void updateVertexBuffer() const;
+    void updateVertexStreams() const;
+
+    // Called before modifying the vertex buffer directly
+    std::vector<Vertex>& editVertexBuffer() {
+        updateVertexBuffer();
+        m_bVertexStreamsValid = false;
+        return m_VertexBuffer;
+    }
 
 public:
+    // Rebuilt from the streams if they were edited since the last call
     const Vertex* getVertexBuffer() const {
+        updateVertexBuffer();
         return m_VertexBuffer.data();
     }
 
@@ -69,6 +118,31 @@ public:
         return m_IndexBuffer.size();
     }
 
+    // Indices of the levels of detail, indexing the vertex buffer too
+    const unsigned int* getLodIndexBuffer() const {
+        return m_LodIndexBuffer.data();
+    }
+
+    size_t getLodIndexCount() const {
+        return m_LodIndexBuffer.size();
+    }
+
+    // Structure of arrays copy of the positions and normals, built on first use, for SIMD passes
+    // (see VertexStreams.hpp). Editing it defers the vertex buffer update to the next getVertexBuffer().
+    const VertexStreams& getVertexStreams() const {
+        updateVertexStreams();
+        return m_VertexStreams;
+    }
+
+    VertexStreams& editVertexStreams() {
+        updateVertexStreams();
+        m_bVertexBufferValid = false;
+        return m_VertexStreams;
+    }
+
+    // Recomputes the bounding box from the vertex positions (after editing the streams)
+    void updateBoundingBox();
+
     const Mesh* getMeshBuffer() const {
         return m_MeshBuffer.data();
     }
@@ -77,11 +151,109 @@ public:
         return m_MeshBuffer.size();
     }
 
-    bool loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bool loadTextures = true);
+    const Material& getMaterial(unsigned int materialIndex) const {
+        return m_Materials[materialIndex];
+    }
+
+    size_t getMaterialCount() const {
+        return m_Materials.size();
+    }
+
+    // Meshes without normals get them from generateNormals() with creaseAngle: the default keeps the edges
+    // of boxes hard
+    bool loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bool loadTextures = true,
+                 float creaseAngle = glm::radians(60.f));
+
+    // Gathers the diffuse maps of the materials in the layers of atlas (see TextureAtlas) and sets their
+    // m_nKdLayer: the whole geometry then draws with the single texture of atlas.upload(). When the maps
+    // are packed in pages, the texture coordinates of the meshes using them are remapped to their region,
+    // clamped to [0, 1] first (repeated maps can't be packed).
+    bool packDiffuseMaps(TextureAtlas& atlas, unsigned int maxPageSize = 2048);
+
+    // Computes smooth vertex normals for a mesh, across vertices sharing the same position.
+    // Faces are only smoothed together when their angle is below creaseAngle (radians), vertices
+    // on creases are duplicated.
+    void generateNormals(unsigned int meshIndex, NormalWeighting weighting = NormalWeighting::Angle,
+                         float creaseAngle = glm::pi<float>());
+
+    // Reorders the triangles of a mesh for the post-transform vertex cache and for overdraw,
+    // then its vertices in order of first use. The vertices of the mesh must not be shared
+    // with other meshes (always true for meshes built by loadOBJ).
+    void optimizeMesh(unsigned int meshIndex);
+
+    // Stable sorts the meshes [firstMesh, getMeshCount()) by material and moves their indices so that
+    // meshes sharing a material have contiguous index ranges (called by loadOBJ on the meshes it adds).
+    // Their index ranges must be contiguous in the index buffer, mesh indices change.
+    void sortMeshesByMaterial(unsigned int firstMesh = 0);
+
+    // Splits the index range of a mesh in meshlets (called by loadOBJ after optimizeMesh())
+    void buildMeshlets(unsigned int meshIndex, unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+
+    const Meshlet* getMeshletBuffer() const {
+        return m_Meshlets.data();
+    }
+
+    size_t getMeshletCount() const {
+        return m_Meshlets.size();
+    }
+
+    // Appends to indices the triangles of the meshlets of a mesh which are inside the frustum and not back facing.
+    // mvpMatrix maps object space to clip space, cameraPosition is in object space (inverse(MV) * (0, 0, 0, 1)).
+    // Returns the number of triangles appended. Meshes without meshlets are appended entirely.
+    size_t cullMeshlets(unsigned int meshIndex, const glm::mat4& mvpMatrix, const glm::vec3& cameraPosition,
+                        std::vector<unsigned int>& indices) const;
+
+    // Simplifies every mesh to each ratio of its triangle count, each level from the previous one.
+    // Only reads the geometry: it can run on any thread, as long as the geometry is not modified.
+    LodChain computeLods(const std::vector<float>& ratios = { 0.5f, 0.25f, 0.125f }) const;
+
+    // computeLods() on a background thread, the geometry must outlive the future
+    std::future<LodChain> computeLodsAsync(std::vector<float> ratios = { 0.5f, 0.25f, 0.125f }) const;
+
+    // Replaces the levels of detail of every mesh and the LOD index buffer, which has to be uploaded
+    // again. Must be called after optimizeMesh(), which moves vertices.
+    void setLods(LodChain chain);
+
+    // Binary cache of the levels of detail, checked against the vertex positions and mesh indices
+    bool saveLods(const FilePath& filepath) const;
+    bool loadLods(const FilePath& filepath);
+
+    unsigned int getLodCount(unsigned int meshIndex) const {
+        return m_MeshBuffer[meshIndex].m_nLodCount;
+    }
+
+    // Coarsest level whose error projects to at most maxPixelError pixels on screen, 0 being the mesh
+    // itself and getLodCount() the coarsest LOD. The distance is the one of the bounding sphere of the geometry.
+    unsigned int selectLod(unsigned int meshIndex, const glm::mat4& projMatrix, const glm::mat4& mvMatrix,
+                           float viewportHeight, float maxPixelError = 1.f) const;
+
+    // Index range of a level returned by selectLod(): in the index buffer for level 0, in the LOD index
+    // buffer for the others
+    void getLodRange(unsigned int meshIndex, unsigned int level, unsigned int& indexOffset, unsigned int& indexCount) const {
+        const auto& mesh = m_MeshBuffer[meshIndex];
+        if (level == 0u) {
+            indexOffset = mesh.m_nIndexOffset;
+            indexCount = mesh.m_nIndexCount;
+        } else {
+            const auto& lod = m_Lods[mesh.m_nLodOffset + level - 1];
+            indexOffset = lod.m_nIndexOffset;
+            indexCount = lod.m_nIndexCount;
+        }
+    }
 
     const BBox3f& getBoundingBox() const {
         return m_BBox;
     }
+
+    // Compressed copies of the vertex buffer (16 or 12 bytes per vertex instead of 32), with positions
+    // quantized in the bounding box. Draw them with the attribute setup of VertexAttributes.hpp.
+    std::vector<PackedVertex> getPackedVertexBuffer() const;
+    std::vector<CompactVertex> getCompactVertexBuffer() const;
+
+    // Maps the normalized quantized positions back to object space, to multiply the model matrix with
+    glm::mat4 getPackedPositionMatrix() const {
+        return dequantizationMatrix(m_BBox);
+    }
 };
 
 }
@@ -3,22 +3,68 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <cstdint>
 
+#include <GL/glew.h>
 #include "glm.hpp"
 #include "FilePath.hpp"
 
 namespace glimac {
 
+// Layout of the pixels of an Image, each one matching a GL texture format
+enum class PixelFormat {
+    R8,       // 1 byte, normalized
+    RG8,      // 2 bytes, normalized
+    RGBA8,    // 4 bytes, normalized
+    SRGB8_A8, // 4 bytes, sRGB encoded color and linear alpha
+    RGBA16F,  // 4 half floats
+    RGBA32F   // glm::vec4
+};
+
+unsigned int getChannelCount(PixelFormat format);
+
+// Bytes per pixel
+size_t getPixelSize(PixelFormat format);
+
+// Arguments of glTexImage2D for the format
+GLint getGLInternalFormat(PixelFormat format);
+GLenum getGLFormat(PixelFormat format);
+GLenum getGLType(PixelFormat format);
+
+class TextureContainer;
+
+// Pixels stored row by row in their native width (4 bytes per RGBA8 pixel instead of a glm::vec4)
 class Image {
 private:
     unsigned int m_nWidth = 0u;
     unsigned int m_nHeight = 0u;
-    std::unique_ptr<glm::vec4[]> m_Pixels;
+    PixelFormat m_Format = PixelFormat::RGBA32F;
+    std::shared_ptr<unsigned char> m_Data;
+    std::shared_ptr<const TextureContainer> m_pContainer;
+    unsigned int m_nContainerFace = 0u;
+
+    friend class TextureContainer;
+
+    // Level 0 of a face of the container, pixels read in its mapping
+    Image(std::shared_ptr<const TextureContainer> pContainer, unsigned int face);
 public:
     Image(unsigned int width, unsigned int height):
-        m_nWidth(width), m_nHeight(height), m_Pixels(new glm::vec4[width * height]) {
+        Image(width, height, PixelFormat::RGBA32F) {
+    }
+
+    Image(unsigned int width, unsigned int height, PixelFormat format):
+        m_nWidth(width), m_nHeight(height), m_Format(format),
+        m_Data(new unsigned char[size_t(width) * height * getPixelSize(format)], std::default_delete<unsigned char[]>()) {
     }
 
+    Image(const Image&) = delete;
+    Image& operator =(const Image&) = delete;
+    Image(Image&&) = default;
+    Image& operator =(Image&&) = default;
+
     unsigned int getWidth() const {
         return m_nWidth;
     }
@@ -27,22 +73,146 @@ public:
         return m_nHeight;
     }
 
+    PixelFormat getFormat() const {
+        return m_Format;
+    }
+
+    size_t getDataSize() const {
+        return size_t(m_nWidth) * m_nHeight * getPixelSize(m_Format);
+    }
+
+    const unsigned char* getData() const {
+        return m_Data.get();
+    }
+
+    // Non const accesses detach the image from its texture container, whose other levels would no
+    // longer match the pixels
+    unsigned char* getData() {
+        m_pContainer.reset();
+        return m_Data.get();
+    }
+
+    // Pixels of a RGBA32F image, nullptr for the other formats (see convert())
     const glm::vec4* getPixels() const {
-        return m_Pixels.get();
+        return m_Format == PixelFormat::RGBA32F ? reinterpret_cast<const glm::vec4*>(m_Data.get()) : nullptr;
     }
 
     glm::vec4* getPixels() {
-        return m_Pixels.get();
+        m_pContainer.reset();
+        return m_Format == PixelFormat::RGBA32F ? reinterpret_cast<glm::vec4*>(m_Data.get()) : nullptr;
+    }
+
+    // Decoded pixel: missing channels read as (0, 0, 1) like GL sampling, sRGB colors are linearized
+    glm::vec4 getPixel(unsigned int x, unsigned int y) const;
+
+    // Encodes color (clamped for the normalized formats), extra channels are dropped
+    void setPixel(unsigned int x, unsigned int y, const glm::vec4& color);
+
+    // Copy of the image in another format, converting each pixel through getPixel() / setPixel()
+    std::unique_ptr<Image> convert(PixelFormat format) const;
+
+    // Texture container the image was loaded from (its pixels are those of level 0), nullptr if none or
+    // if the pixels were accessed for writing since
+    const TextureContainer* getContainer() const {
+        return m_pContainer.get();
+    }
+
+    unsigned int getContainerFace() const {
+        return m_nContainerFace;
     }
 };
 
-std::unique_ptr<Image> loadImage(const FilePath& filepath);
+// FNV-1a of the size, format and pixels: key of the data derived from an image in caches
+uint64_t computeImageHash(const Image& image);
+
+// Uploads the image to the bound texture with the GL format and type of its pixel format.
+// At level 0, an image of a texture container uploads every level of the container.
+void uploadImage(GLenum target, const Image& image, GLint level = 0);
+
+// 8 bits files are decoded straight into the 8 bits formats: R8 keeps the first channel (gray level),
+// RG8 the first two (gray level and alpha). HDR files are read as floats. Other combinations are converted.
+// An uncompressed texture container of the file in format (see loadTextureContainerImage()) is read instead.
+std::unique_ptr<Image> loadImage(const FilePath& filepath, PixelFormat format = PixelFormat::RGBA8);
+
+// Shared ownership of a cached image: the cache may evict it once no handle refers to it
+typedef std::shared_ptr<const Image> ImageHandle;
 
+struct ImageManagerStatistics {
+    size_t m_nResidentBytes;
+    size_t m_nImageCount;
+    size_t m_nHitCount; // Requests served by the cache or by a decode already in flight
+    size_t m_nMissCount; // Requests starting a decode
+    size_t m_nEvictionCount;
+};
+
+// Cache of the images loaded from files, safe to use from any thread. Files are identified by
+// their canonical path. Images not referenced by any handle are evicted, least recently used first,
+// when the resident images exceed the memory budget. The functions returning raw pointers pin
+// their image: it stays loaded until the end of the program.
 class ImageManager {
 private:
-    static std::unordered_map<FilePath, std::unique_ptr<Image>> m_ImageMap;
+    struct Entry {
+        std::shared_ptr<const Image> m_pImage;
+        size_t m_nSize;
+        uint64_t m_nLastUse;
+        bool m_bPinned;
+    };
+
+    // Decode shared by the concurrent requests of a file, done by the first thread claiming it
+    struct PendingLoad {
+        std::atomic<bool> m_bClaimed { false };
+        std::promise<ImageHandle> m_Promise;
+        std::shared_future<ImageHandle> m_Future = m_Promise.get_future().share();
+    };
+
+    static std::unordered_map<FilePath, Entry> m_ImageMap;
+    static std::unordered_map<FilePath, std::shared_ptr<PendingLoad>> m_PendingLoads;
+    static std::mutex m_Mutex;
+    static size_t m_nMemoryBudget;
+    static uint64_t m_nUseCounter;
+    static ImageManagerStatistics m_Statistics;
+
+    // Cached image in pImage, or the pending load of filepath, created if needed (then bCreated is set)
+    static std::shared_ptr<PendingLoad> findOrCreatePendingLoad(const FilePath& filepath, ImageHandle& pImage, bool& bCreated);
+
+    // Decodes filepath unless another thread already claimed the load, and waits for its result
+    static ImageHandle complete(const FilePath& filepath, const std::shared_ptr<PendingLoad>& pLoad);
+
+    // Adds pImage to the cache (keeping the image already there if any) and evicts over the budget.
+    // m_Mutex must be locked.
+    static ImageHandle insert(const FilePath& filepath, std::shared_ptr<const Image> pImage, bool bPinned);
+
+    // Evicts unreferenced images until the resident size fits in budget. m_Mutex must be locked.
+    static void evict(size_t budget);
+
+    static const Image* pin(const FilePath& filepath, const ImageHandle& pImage);
 public:
+    // Decodes on the calling thread, or waits for the decode already in flight
+    static ImageHandle acquireImage(const FilePath& filepath);
+
+    // Decodes on the library thread pool. Requests of a file already in flight share its decode.
+    // The future gives a null handle if the file can't be loaded.
+    static std::shared_future<ImageHandle> acquireImageAsync(const FilePath& filepath);
+
+    // acquireImage() of a pinned image
     static const Image* loadImage(const FilePath& filepath);
+
+    // Image already loaded from filepath (then pinned), nullptr if none
+    static const Image* findImage(const FilePath& filepath);
+
+    // Takes ownership of an image decoded elsewhere and pins it. If filepath is already loaded
+    // the existing image is kept and returned. Returns nullptr for a null image.
+    static const Image* insertImage(const FilePath& filepath, std::unique_ptr<Image> pImage);
+
+    // Maximum size of the resident images, exceeded only by referenced or pinned ones. Unlimited by default.
+    static void setMemoryBudget(size_t bytes);
+
+    static size_t getMemoryBudget();
+
+    // Evicts every image without handle nor pin
+    static void evictUnusedImages();
+
+    static ImageManagerStatistics getStatistics();
 };
 
 }
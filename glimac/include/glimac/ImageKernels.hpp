@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "glm.hpp"
+
+namespace glimac {
+
+class Image;
+
+// Conversion kernels on raw pixel data, 16 bytes per SSE instruction when available.
+// Counts are in values (channels) for the per value kernels and in pixels for the others.
+// Outputs must not overlap the inputs unless stated otherwise.
+
+// value / 255
+void unorm8ToFloat(const uint8_t* src, float* dst, size_t count);
+
+// round(clamp(value, 0, 1) * 255)
+void floatToUnorm8(const float* src, uint8_t* dst, size_t count);
+
+// RGBA pixels, color channels decoded with a 256 entries table, alpha as unorm8ToFloat()
+void srgb8ToLinear(const uint8_t* src, float* dst, size_t pixelCount);
+
+// RGBA pixels, color channels encoded with a table on the clamped linear value (off by one step at most)
+void linearToSrgb8(const float* src, uint8_t* dst, size_t pixelCount);
+
+// color *= alpha on RGBA pixels, in place
+void premultiplyAlpha(uint8_t* pixels, size_t pixelCount);
+void premultiplyAlpha(glm::vec4* pixels, size_t pixelCount);
+
+// Reverses the order of rowCount rows of rowSize bytes, in place (GL textures start with the bottom row)
+void flipVertically(uint8_t* data, size_t rowSize, size_t rowCount);
+
+// dst channel c = src channel order[c] on RGBA8 pixels (BGRA -> RGBA is { 2, 1, 0, 3 }), src can be dst
+void swizzle(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<unsigned int, 4>& order);
+
+// 1 to 4 channels to RGBA8, missing channels set to (0, 0, 255) as GL samples them
+void expandToRGBA8(const uint8_t* src, unsigned int channelCount, uint8_t* dst, size_t pixelCount);
+
+void flipVertically(Image& image);
+
+}
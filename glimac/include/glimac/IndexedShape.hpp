@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include "common.hpp"
+
+namespace glimac {
+
+// Vertices shared by the triangles of a shape and the triangle list indexing them.
+// Indices are stored on 16 bits whenever the vertices fit, to halve the index buffer.
+class IndexedShape {
+public:
+    IndexedShape() = default;
+
+    IndexedShape(std::vector<ShapeVertex> vertices, const std::vector<GLuint>& indices);
+
+    // Grid of (columnCount + 1) x (rowCount + 1) vertices stored row by row, two triangles per cell.
+    // The indices are written directly with the smallest type.
+    static IndexedShape makeGrid(std::vector<ShapeVertex> vertices, GLsizei columnCount, GLsizei rowCount);
+
+    const ShapeVertex* getVertexPointer() const {
+        return m_Vertices.data();
+    }
+
+    GLsizei getVertexCount() const {
+        return m_Vertices.size();
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for glDrawElements
+    GLenum getIndexType() const {
+        return m_Indices.empty() ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    const GLvoid* getIndexPointer() const {
+        return m_Indices.empty() ? (const GLvoid*) m_ShortIndices.data() : (const GLvoid*) m_Indices.data();
+    }
+
+    GLsizei getIndexCount() const {
+        return m_Indices.empty() ? m_ShortIndices.size() : m_Indices.size();
+    }
+
+    // Size of an index in bytes
+    size_t getIndexSize() const {
+        return m_Indices.empty() ? sizeof(GLushort) : sizeof(GLuint);
+    }
+
+    GLuint getIndex(size_t i) const {
+        return m_Indices.empty() ? m_ShortIndices[i] : m_Indices[i];
+    }
+
+    // Non indexed triangle list (one vertex per triangle corner)
+    std::vector<ShapeVertex> expand() const;
+
+private:
+    std::vector<ShapeVertex> m_Vertices;
+    std::vector<GLushort> m_ShortIndices;
+    std::vector<GLuint> m_Indices; // Empty when the indices fit in m_ShortIndices
+};
+
+// Building blocks of the parametric shapes (surfaces of revolution around the y axis)
+
+// sin and cos of i * 2PI / count for i in [0, count], the last entry being exactly the first one
+// so that the duplicated seam column of a shape matches its first column
+void computeSinCosTable(GLsizei count, GLfloat* sinTable, GLfloat* cosTable);
+
+// Writes count vertices of a ring from the tables of computeSinCosTable():
+// position = (positionScale * sin, positionY, positionScale * cos),
+// normal = (normalScale * sin, normalY, normalScale * cos), texCoords = (i * rcpCount, texCoordY)
+void buildRing(ShapeVertex* vertices, const GLfloat* sinTable, const GLfloat* cosTable, GLsizei count, GLfloat rcpCount,
+               GLfloat positionScale, GLfloat positionY, GLfloat normalScale, GLfloat normalY, GLfloat texCoordY);
+
+// GPU buffers of an indexed shape
+struct ShapeBuffers {
+    GLuint m_nVBO = 0;
+    GLuint m_nIBO = 0;
+    GLuint m_nVAO = 0;
+    GLenum m_IndexType = GL_UNSIGNED_SHORT;
+    GLsizei m_nIndexCount = 0;
+};
+
+// Uploads the vertices and indices in a VBO and an IBO, and records them in a VAO with the
+// ShapeVertex attributes at the given locations
+ShapeBuffers uploadShape(const IndexedShape& shape, GLuint positionLocation = 0, GLuint normalLocation = 1,
+                         GLuint texCoordsLocation = 2);
+
+void drawShape(const ShapeBuffers& buffers);
+
+void deleteShapeBuffers(ShapeBuffers& buffers);
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include "glm.hpp"
+
+namespace glimac {
+
+// Index buffer reordering passes. All functions work on triangle lists whose
+// indices are in [0, vertexCount).
+
+struct VertexCacheStatistics {
+    float m_fACMR; // Average cache miss ratio: transformed vertices per triangle (0.5 is ideal on large grids, 3 is the worst)
+    float m_fATVR; // Average transformed vertex ratio: transformed vertices per referenced vertex (1 is ideal)
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries
+VertexCacheStatistics analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                         unsigned int cacheSize = 16);
+
+// Reorders triangles for post-transform cache hits (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// Splits a cache optimized index buffer into clusters and sorts them so that outer, outward facing
+// clusters are drawn first, whatever the point of view. Clusters are only cut where it keeps the
+// ACMR under threshold * the ACMR of the input.
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                      float threshold = 1.05f);
+
+// Fills remap (vertexCount entries) with the new index of each vertex in order of first use,
+// ~0u for unreferenced vertices. Returns the number of referenced vertices.
+size_t optimizeVertexFetchRemap(unsigned int* remap, const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include "glm.hpp"
+
+namespace glimac {
+
+// Reduces a triangle list to about targetIndexCount indices by collapsing edges in order of
+// quadric error (Garland & Heckbert), without creating vertices: the result indexes the same
+// vertex buffer. Vertices on a border or on a seam (several vertices at the same position, ie.
+// UV or normal discontinuities) never move. Collapses which flip a triangle are rejected.
+// destination must have room for indexCount indices (it can be indices itself). Returns the
+// number of indices written, error receives the largest collapse error (distance in object units).
+size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+                    const glm::vec3* positions, size_t vertexCount, size_t targetIndexCount, float& error);
+
+}
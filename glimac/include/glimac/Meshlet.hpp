@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "glm.hpp"
+#include "BBox.hpp"
+
+namespace glimac {
+
+// Small cluster of triangles, contiguous in an index buffer, with the bounds used to cull it
+struct Meshlet {
+    unsigned int m_nIndexOffset; // Offset in the index buffer
+    unsigned int m_nIndexCount; // Number of indices (3 per triangle)
+    unsigned int m_nVertexCount; // Number of unique vertices
+
+    // Bounding sphere
+    glm::vec3 m_Center;
+    float m_fRadius;
+
+    // Cone containing the normals of the triangles: the meshlet is back facing when
+    // dot(center - camera, axis) >= cutoff * |center - camera| + radius.
+    // The cutoff is 1 when the normals are too spread out to cull anything.
+    glm::vec3 m_ConeAxis;
+    float m_fConeCutoff;
+};
+
+// Groups consecutive triangles of an index buffer (which should be vertex cache optimized) into
+// meshlets of at most maxVertices unique vertices and maxTriangles triangles. Positions are read
+// with a stride in bytes, to use the vertex buffer directly. Index offsets start at indexOffset.
+void buildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t indexCount,
+                   unsigned int indexOffset, const glm::vec3* positions, size_t positionStride, size_t vertexCount,
+                   unsigned int maxVertices = 64, unsigned int maxTriangles = 124);
+
+// Frustum planes extracted from a projection (or model view projection) matrix, pointing inside
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& matrix);
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+
+private:
+    glm::vec4 m_Planes[6];
+};
+
+// The camera position and the frustum must be in the same space as the meshlet (object space)
+inline bool isBackFacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    auto d = meshlet.m_Center - cameraPosition;
+    return glm::dot(d, meshlet.m_ConeAxis) >= meshlet.m_fConeCutoff * glm::length(d) + meshlet.m_fRadius;
+}
+
+inline bool isVisible(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& cameraPosition) {
+    return frustum.intersectsSphere(meshlet.m_Center, meshlet.m_fRadius) && !isBackFacing(meshlet, cameraPosition);
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Image.hpp"
+
+namespace glimac {
+
+enum class MipFilter {
+    Box,     // 2x2 average: fastest, blurriest
+    Kaiser,  // Kaiser windowed sinc (alpha = 4) of radius 3
+    Lanczos  // Lanczos 3: sharpest, rings a little on hard edges
+};
+
+// Levels 1 to n of an image, each one half the size of the previous one (rounded down, at least 1),
+// down to 1x1, in the format of the image
+typedef std::vector<std::unique_ptr<Image>> MipChain;
+
+// Number of levels of a complete chain, level 0 included
+unsigned int getMipLevelCount(unsigned int width, unsigned int height);
+
+// Each level is filtered from the previous one in linear space and in floats: SRGB8_A8 images are
+// decoded, the other formats are taken as linear. The rows of each level are split between threads.
+MipChain generateMipChain(const Image& image, MipFilter filter = MipFilter::Kaiser);
+
+// Uploads image at level 0 and the chain at the next levels of the bound texture
+void uploadMipChain(GLenum target, const Image& image, const MipChain& mips);
+
+// The file records a hash of the image: loadMipChain() fails if the image changed since saveMipChain()
+bool saveMipChain(const FilePath& filepath, const Image& image, MipFilter filter, const MipChain& mips);
+
+bool loadMipChain(const FilePath& filepath, const Image& image, MipFilter filter, MipChain& mips);
+
+// Cache file of the chain of the image loaded from imagePath, next to it
+FilePath getMipCachePath(const FilePath& imagePath);
+
+// Chain from the cache file of the image, generated and saved there when missing or out of date
+MipChain loadOrGenerateMipChain(const FilePath& imagePath, const Image& image, MipFilter filter = MipFilter::Kaiser);
+
+}
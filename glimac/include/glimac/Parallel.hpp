@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+#include "ThreadPool.hpp"
+
+namespace glimac {
+
+// Splits [0, count) in contiguous ranges and calls f(begin, end) on each of them from the threads of
+// ThreadPool::getInstance() and the calling thread. Ranges are at least minRangeSize long so small loops
+// stay on the calling thread.
+//
+// Ranges are claimed from a counter: the calling thread runs them until none is left, then only waits
+// for those already running on the pool. It never waits for a task still queued, so parallelFor() can
+// be called from a task of the pool. The first exception thrown by f is rethrown once every range ran.
+template<typename Function>
+void parallelFor(size_t count, const Function& f, size_t minRangeSize = 1024) {
+    auto& pool = ThreadPool::getInstance();
+    size_t rangeCount = pool.getThreadCount() + 1;
+    rangeCount = std::min(rangeCount, std::max<size_t>(1, count / std::max<size_t>(1, minRangeSize)));
+
+    if (rangeCount <= 1) {
+        if (count) {
+            f(size_t(0), count);
+        }
+        return;
+    }
+
+    // Shared with the tasks, which may start after parallelFor() returned: they then claim nothing
+    // and never touch f
+    struct State {
+        std::atomic<size_t> m_nNextRange { 0u };
+        size_t m_nDoneCount = 0u; // Guarded by m_Mutex
+        std::exception_ptr m_pException; // Guarded by m_Mutex
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+    };
+    auto pState = std::make_shared<State>();
+
+    auto pFunction = &f;
+    auto runRanges = [pState, pFunction, count, rangeCount]() {
+        for (;;) {
+            auto range = pState->m_nNextRange++;
+            if (range >= rangeCount) {
+                return;
+            }
+            // A range that throws is still done: the caller waits for every claimed range, so f stays alive
+            std::exception_ptr pException;
+            try {
+                (*pFunction)(count * range / rangeCount, count * (range + 1) / rangeCount);
+            } catch (...) {
+                pException = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(pState->m_Mutex);
+                if (pException && !pState->m_pException) {
+                    pState->m_pException = pException;
+                }
+                ++pState->m_nDoneCount;
+            }
+            pState->m_Condition.notify_one();
+        }
+    };
+
+    for (size_t i = 1; i < rangeCount; ++i) {
+        pool.submit(runRanges);
+    }
+    runRanges();
+
+    std::unique_lock<std::mutex> lock(pState->m_Mutex);
+    pState->m_Condition.wait(lock, [&pState, rangeCount]() {
+        return pState->m_nDoneCount == rangeCount;
+    });
+    if (pState->m_pException) {
+        std::rethrow_exception(pState->m_pException);
+    }
+}
+
+}
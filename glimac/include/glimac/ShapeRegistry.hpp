@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include "common.hpp"
+#include "IndexedShape.hpp"
+
+namespace glimac {
+
+// Builds each parametric shape once per parameter set, with several tessellation levels, and
+// stores all of them in one vertex buffer and one index buffer. Levels are drawn with
+// glDrawElementsBaseVertex (OpenGL 3.2): indices are local to their level, so they stay 16 bits.
+class ShapeRegistry {
+public:
+    typedef unsigned int ShapeId;
+
+    explicit ShapeRegistry(GLuint positionLocation = 0, GLuint normalLocation = 1, GLuint texCoordsLocation = 2):
+        m_nPositionLocation(positionLocation), m_nNormalLocation(normalLocation), m_nTexCoordsLocation(texCoordsLocation) {
+    }
+
+    ~ShapeRegistry();
+
+    ShapeRegistry(const ShapeRegistry&) = delete;
+    ShapeRegistry& operator =(const ShapeRegistry&) = delete;
+
+    // Level 0 is the given tessellation, each next level halves it (down to 4 x 2 for a sphere)
+    ShapeId getSphere(GLfloat radius, GLsizei discLat, GLsizei discLong, unsigned int levelCount = 3);
+    ShapeId getCone(GLfloat height, GLfloat radius, GLsizei discLat, GLsizei discHeight, unsigned int levelCount = 3);
+
+    unsigned int getLevelCount(ShapeId shape) const {
+        return m_Shapes[shape].m_nLevelCount;
+    }
+
+    // Coarsest level whose edges project to at most maxEdgeLength pixels (around the silhouette)
+    unsigned int selectLevel(ShapeId shape, const glm::mat4& projMatrix, const glm::mat4& mvMatrix,
+                             float viewportHeight, float maxEdgeLength = 8.f) const;
+
+    // Binds the shared VAO, uploading the buffers again if shapes were added. Call it before draw().
+    void bind();
+
+    void draw(ShapeId shape, unsigned int level) const;
+
+    void draw(ShapeId shape, const glm::mat4& projMatrix, const glm::mat4& mvMatrix, float viewportHeight) const {
+        draw(shape, selectLevel(shape, projMatrix, mvMatrix, viewportHeight));
+    }
+
+private:
+    struct Level {
+        GLint m_nBaseVertex;
+        GLuint m_nFirstIndex;
+        GLsizei m_nIndexCount;
+        GLsizei m_nSegmentCount; // Around the axis, for the level selection
+    };
+
+    struct Shape {
+        unsigned int m_nFirstLevel;
+        unsigned int m_nLevelCount;
+        GLfloat m_fRadius; // Of the bounding sphere, centered on the origin
+    };
+
+    typedef std::tuple<int, GLfloat, GLfloat, GLsizei, GLsizei, unsigned int> ShapeKey;
+
+    void addLevel(const IndexedShape& shape, GLsizei segmentCount);
+    void upload();
+
+    std::vector<Shape> m_Shapes;
+    std::vector<Level> m_Levels;
+    std::map<ShapeKey, ShapeId> m_ShapeMap;
+
+    std::vector<ShapeVertex> m_Vertices;
+    std::vector<GLuint> m_Indices;
+    GLsizei m_nMaxLevelVertexCount = 0;
+
+    GLuint m_nPositionLocation, m_nNormalLocation, m_nTexCoordsLocation;
+    GLuint m_nVBO = 0, m_nIBO = 0, m_nVAO = 0;
+    GLenum m_IndexType = GL_UNSIGNED_SHORT;
+    bool m_bDirty = false;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "common.hpp"
+#include "IndexedShape.hpp"
 
 namespace glimac {
 
@@ -19,6 +20,9 @@ public:
         build(radius, discLat, discLong); // Construction (voir le .cpp)
     }
 
+    // Sommets partagés et indices des triangles, à dessiner avec glDrawElements (voir uploadShape())
+    static IndexedShape buildIndexed(GLfloat radius, GLsizei discLat, GLsizei discLong);
+
     // Renvoit le pointeur vers les données
     const ShapeVertex* getDataPointer() const {
         return &m_Vertices[0];
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "glm.hpp"
+#include "Image.hpp"
+
+namespace glimac {
+
+// Skyline bottom-left allocator of rectangles in a page: the top of the occupied area is kept as a list
+// of horizontal segments and each rectangle goes where its top is the lowest
+class SkylinePacker {
+public:
+    SkylinePacker(unsigned int width, unsigned int height);
+
+    // Position of a new width x height rectangle, false if it does not fit
+    bool insert(unsigned int width, unsigned int height, glm::uvec2& position);
+
+    // Allocated area over page area
+    float getOccupancy() const;
+
+private:
+    struct Segment {
+        unsigned int m_nX;
+        unsigned int m_nY;
+        unsigned int m_nWidth;
+    };
+
+    unsigned int m_nWidth;
+    unsigned int m_nHeight;
+    size_t m_nUsedArea = 0u;
+    std::vector<Segment> m_Skyline; // Sorted by x, covering the page width
+};
+
+// Where an image went in a TextureAtlas: its texture coordinates uv become m_Offset + uv * m_Scale in layer m_nLayer
+struct AtlasRegion {
+    unsigned int m_nLayer;
+    glm::vec2 m_Offset;
+    glm::vec2 m_Scale;
+};
+
+// Images gathered in the layers of a single GL_TEXTURE_2D_ARRAY. Images of a same size and format are
+// one layer each (texture coordinates unchanged). Other images are packed in square pages, each one
+// surrounded by a gutter repeating its edges and aligned so that the first mipLevelCount levels never
+// mix two images.
+class TextureAtlas {
+public:
+    // Fails with a message if an image does not fit in a page of maxPageSize. Pages are the smallest
+    // power of two holding the images in one page, up to maxPageSize, in the format of the images if
+    // they all share it, else in RGBA8. The gutter is max(padding, 2^(mipLevelCount - 1)) pixels.
+    bool build(const std::vector<const Image*>& images, unsigned int maxPageSize = 2048,
+               unsigned int padding = 2, unsigned int mipLevelCount = 4);
+
+    // False when the layers are the images themselves (then they must outlive the atlas)
+    bool isPacked() const {
+        return m_bPacked;
+    }
+
+    const AtlasRegion& getRegion(size_t imageIndex) const {
+        return m_Regions[imageIndex];
+    }
+
+    size_t getLayerCount() const {
+        return m_Layers.size();
+    }
+
+    const Image& getLayer(size_t layer) const {
+        return *m_Layers[layer];
+    }
+
+    // Levels allocated by upload()
+    unsigned int getLevelCount() const {
+        return m_nLevelCount;
+    }
+
+    // Immutable storage on the bound GL_TEXTURE_2D_ARRAY, the layers at level 0 and the other levels
+    // generated by glGenerateMipmap, GL_TEXTURE_MAX_LEVEL limited to them
+    void upload() const;
+
+private:
+    bool m_bPacked = false;
+    unsigned int m_nLevelCount = 1u;
+    std::vector<AtlasRegion> m_Regions;
+    std::vector<std::unique_ptr<Image>> m_Pages;
+    std::vector<const Image*> m_Layers;
+};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "Image.hpp"
+#include "MipChain.hpp"
+#include "BlockCompression.hpp"
+
+namespace glimac {
+
+// Preprocessed texture file: every level of one image or of the 6 faces of a cube map, in a pixel
+// format or a block format, stored as GL takes them. The file is mapped in memory and its levels
+// are uploaded from the mapping without decoding nor copying.
+//
+// Layout (little endian): a 40 bytes header, a table of (offset, size) uint64 pairs for each level
+// and each face of the level, then the data of each entry aligned on 16 bytes.
+class TextureContainer: public std::enable_shared_from_this<TextureContainer> {
+public:
+    // nullptr if the file does not exist, with a message if it is not a valid container
+    static std::shared_ptr<const TextureContainer> open(const FilePath& filepath);
+
+    ~TextureContainer();
+
+    TextureContainer(const TextureContainer&) = delete;
+    TextureContainer& operator =(const TextureContainer&) = delete;
+
+    unsigned int getWidth(unsigned int level = 0u) const;
+
+    unsigned int getHeight(unsigned int level = 0u) const;
+
+    unsigned int getLevelCount() const;
+
+    // 1, or 6 for a cube map
+    unsigned int getFaceCount() const;
+
+    bool isCompressed() const;
+
+    // Format of the levels of an uncompressed container
+    PixelFormat getPixelFormat() const;
+
+    // Format of the levels of a compressed container
+    CompressedFormat getCompressedFormat() const;
+
+    bool isSRGB() const;
+
+    // Pointer in the mapping of the file
+    const uint8_t* getData(unsigned int level, unsigned int face = 0u) const;
+
+    size_t getDataSize(unsigned int level, unsigned int face = 0u) const;
+
+    // Every level of a face to target of the bound texture
+    void uploadFace(GLenum target, unsigned int face = 0u) const;
+
+    // Every level of the bound texture: the single face to target, or the 6 faces of a cube map
+    // to GL_TEXTURE_CUBE_MAP_POSITIVE_X + face (target is ignored then)
+    void upload(GLenum target) const;
+
+    // Image of level 0 of a face of an uncompressed container, reading its pixels in the mapping
+    // (nullptr for a compressed container). The image keeps the container open.
+    std::unique_ptr<Image> getImage(unsigned int face = 0u) const;
+
+private:
+    struct Header;
+    struct Entry;
+
+    TextureContainer() = default;
+
+    const Entry& getEntry(unsigned int level, unsigned int face) const;
+
+    const uint8_t* m_pMapping = nullptr;
+    size_t m_nMappingSize = 0u;
+#ifdef _WIN32
+    void* m_hFile = nullptr;
+    void* m_hMapping = nullptr;
+#endif
+};
+
+// Levels sorted by level, then by face for cube maps (faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + face).
+// Each level must be half the size of the previous one (rounded down, at least 1) in the same format.
+bool saveTextureContainer(const FilePath& filepath, const std::vector<const Image*>& levels, unsigned int faceCount = 1u);
+
+bool saveTextureContainer(const FilePath& filepath, const std::vector<const CompressedImage*>& levels,
+                          unsigned int faceCount = 1u);
+
+// Container of the faces (one image or the 6 faces of a cube map) and of their complete mip chains
+bool bakeTextureContainer(const FilePath& filepath, const std::vector<const Image*>& faces,
+                          MipFilter filter = MipFilter::Kaiser);
+
+// Same with every level compressed
+bool bakeTextureContainer(const FilePath& filepath, const std::vector<const Image*>& faces, CompressedFormat format,
+                          CompressionQuality quality = CompressionQuality::Fast, MipFilter filter = MipFilter::Kaiser);
+
+// Container read by loadImage() in place of the image file imagePath, next to it
+FilePath getTextureContainerPath(const FilePath& imagePath);
+
+// Image of level 0 of the container of imagePath, nullptr if there is none, if it is compressed or in
+// another format, or if the image file is more recent
+std::unique_ptr<Image> loadTextureContainerImage(const FilePath& imagePath, PixelFormat format);
+
+}
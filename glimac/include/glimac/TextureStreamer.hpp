@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "Image.hpp"
+#include "BlockCompression.hpp"
+
+namespace glimac {
+
+// Uploads textures over several frames: each frame, update() copies bands of rows into a ring of pixel
+// unpack buffers and issues glTexSubImage2D (or glCompressedTexSubImage2D) from them, until its time
+// budget is spent. A fence per buffer tells when the GPU is done reading it: a buffer still in use is
+// never waited for, update() stops instead.
+class TextureStreamer {
+public:
+    // slotCount buffers of slotSize bytes, to create on the GL thread. A band is at most one slot.
+    explicit TextureStreamer(unsigned int slotCount = 4u, size_t slotSize = 4u << 20);
+
+    // Uploads still queued are dropped
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator =(const TextureStreamer&) = delete;
+
+    // Queues the upload of a whole image to a level of texture, which must already have storage for it
+    // (glTexStorage2D, or glTexImage2D with null data). target is the texture target or a cube map face.
+    // The handle keeps the pixels alive until the upload is issued, then onComplete runs on the GL thread.
+    // Can be called from any thread.
+    void enqueue(GLuint texture, GLenum target, GLint level, ImageHandle pImage,
+                 std::function<void()> onComplete = std::function<void()>());
+
+    // Same with blocks, uploaded by rows of blocks
+    void enqueue(GLuint texture, GLenum target, GLint level, std::shared_ptr<const CompressedImage> pImage,
+                 std::function<void()> onComplete = std::function<void()>());
+
+    // To call once per frame on the GL thread: issues bands of the queued uploads, in order, until
+    // timeBudget milliseconds are spent (at least one band if a slot is free, the last band may overrun
+    // the budget) or no slot is free.
+    // Changes the texture binding of the active unit. Returns the number of bytes issued.
+    size_t update(float timeBudget = 2.f);
+
+    // Uploads not completely issued yet
+    size_t getPendingUploadCount() const;
+
+private:
+    struct Upload {
+        GLuint m_nTexture;
+        GLenum m_Target;
+        GLint m_nLevel;
+        std::shared_ptr<const void> m_pOwner; // Keeps m_pData alive
+        const uint8_t* m_pData;
+        unsigned int m_nWidth;
+        unsigned int m_nHeight;
+        unsigned int m_nRowHeight; // Pixels per row of data: 1, or 4 for rows of blocks
+        size_t m_nRowSize; // Bytes
+        bool m_bCompressed;
+        GLenum m_Format; // Internal format of blocks, or format of pixels
+        GLenum m_Type; // Type of pixels
+        unsigned int m_nNextRow; // First row of data not issued yet
+        std::function<void()> m_OnComplete;
+    };
+
+    struct Slot {
+        GLuint m_nBuffer = 0u;
+        GLsync m_Fence = nullptr; // Signaled once the GPU read the last band copied in the buffer
+    };
+
+    void enqueue(Upload upload);
+
+    // Issues the next band of upload from slot, returns its size
+    size_t issueBand(Upload& upload, Slot& slot);
+
+    size_t m_nSlotSize;
+    std::vector<Slot> m_Slots;
+    unsigned int m_nNextSlot = 0u;
+    std::deque<Upload> m_Queue;
+    mutable std::mutex m_Mutex; // Guards m_Queue
+};
+
+}
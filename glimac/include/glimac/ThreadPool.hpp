@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace glimac {
+
+// Fixed set of worker threads executing tasks in submission order
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    // Waits for the pending tasks
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator =(const ThreadPool&) = delete;
+
+    template<typename Function>
+    auto submit(Function f) -> std::future<decltype(f())> {
+        // std::function needs a copyable target
+        auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+        auto future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.emplace_back([task]() {
+                (*task)();
+            });
+        }
+        m_Condition.notify_one();
+        return future;
+    }
+
+    size_t getThreadCount() const {
+        return m_Threads.size();
+    }
+
+    // Pool shared by the library (texture loading...), created on first use
+    static ThreadPool& getInstance();
+
+private:
+    std::vector<std::thread> m_Threads;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_bStop = false;
+};
+
+}
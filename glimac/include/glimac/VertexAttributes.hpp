@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+#include "VertexPacking.hpp"
+#include "common.hpp"
+
+namespace glimac {
+
+// Vertex attribute setup for the GL_ARRAY_BUFFER currently bound, to call with the VAO bound.
+//
+// Positions are read as normalized values in [0, 1]^3: multiply the model matrix by
+// dequantizationMatrix(box) (Geometry::getPackedPositionMatrix()) and compute the normal
+// matrix without it. Normals are read as the octahedral vec2 in [-1, 1]^2 and must be
+// decoded in the vertex shader:
+//
+//   vec3 octDecode(vec2 p) {
+//       vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+//       float t = max(-n.z, 0.0);
+//       n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+//       return normalize(n);
+//   }
+
+// Float attributes of ShapeVertex (Sphere, Cone, IndexedShape)
+void setShapeVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation);
+
+void setPackedVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation);
+
+void setCompactVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation);
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include "glm.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include "BBox.hpp"
+
+namespace glimac {
+
+// 16 bytes vertex: position quantized on 16 bits inside a bounding box,
+// octahedral normal on 2x16 bits, half float texture coordinates
+struct PackedVertex {
+    glm::u16vec4 m_Position; // w is unused (alignment)
+    glm::i16vec2 m_Normal;
+    glm::u16vec2 m_TexCoords;
+};
+
+// 12 bytes vertex: same as PackedVertex with the normal on 2x8 bits
+struct CompactVertex {
+    glm::u16vec3 m_Position;
+    glm::i8vec2 m_Normal;
+    glm::u16vec2 m_TexCoords;
+};
+
+/*! maps a unit vector to the [-1, 1]^2 square (octahedral projection) */
+inline glm::vec2 octEncode(const glm::vec3& n) {
+    auto l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.f) {
+        return glm::vec2(0.f);
+    }
+    glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+    if (n.z < 0.f) {
+        // Fold the lower hemisphere over the diagonals
+        p = glm::vec2((1.f - std::abs(p.y)) * (p.x >= 0.f ? 1.f : -1.f),
+                      (1.f - std::abs(p.x)) * (p.y >= 0.f ? 1.f : -1.f));
+    }
+    return p;
+}
+
+/*! inverse of octEncode (the GLSL version is the same code) */
+inline glm::vec3 octDecode(const glm::vec2& p) {
+    glm::vec3 n(p.x, p.y, 1.f - std::abs(p.x) - std::abs(p.y));
+    auto t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+/*! quantizes a position to 16 bits per axis, relatively to the box */
+inline glm::u16vec3 quantizePosition(const glm::vec3& p, const BBox3f& box) {
+    auto extent = glm::max(box.size(), glm::vec3(1e-20f));
+    auto t = glm::clamp((p - box.lower) / extent, 0.f, 1.f);
+    return glm::u16vec3(glm::round(t * 65535.f));
+}
+
+/*! matrix mapping normalized quantized positions ([0, 1]^3) back to the box */
+inline glm::mat4 dequantizationMatrix(const BBox3f& box) {
+    return glm::scale(glm::translate(glm::mat4(1.f), box.lower), box.size());
+}
+
+inline PackedVertex packVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords, const BBox3f& box) {
+    PackedVertex v;
+    v.m_Position = glm::u16vec4(quantizePosition(position, box), 0);
+    auto oct = glm::clamp(octEncode(normal), -1.f, 1.f);
+    v.m_Normal = glm::i16vec2(glm::round(oct * 32767.f));
+    v.m_TexCoords = glm::u16vec2(glm::packHalf1x16(texCoords.x), glm::packHalf1x16(texCoords.y));
+    return v;
+}
+
+inline CompactVertex packCompactVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords, const BBox3f& box) {
+    CompactVertex v;
+    v.m_Position = quantizePosition(position, box);
+    auto oct = glm::clamp(octEncode(normal), -1.f, 1.f);
+    v.m_Normal = glm::i8vec2(glm::round(oct * 127.f));
+    v.m_TexCoords = glm::u16vec2(glm::packHalf1x16(texCoords.x), glm::packHalf1x16(texCoords.y));
+    return v;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "glm.hpp"
+#include "BBox.hpp"
+
+namespace glimac {
+
+// Structure of arrays copy of vertex positions and normals: CPU passes over it (transforms,
+// deformations, bounds) process 4 vertices per SSE instruction instead of one attribute at a time.
+struct VertexStreams {
+    std::vector<float> m_PositionX, m_PositionY, m_PositionZ;
+    std::vector<float> m_NormalX, m_NormalY, m_NormalZ;
+
+    size_t size() const {
+        return m_PositionX.size();
+    }
+
+    void resize(size_t count) {
+        for (auto pStream: { &m_PositionX, &m_PositionY, &m_PositionZ, &m_NormalX, &m_NormalY, &m_NormalZ }) {
+            pStream->resize(count);
+        }
+    }
+
+    // Copies count vertices from an array of structures, positions and normals being glm::vec3
+    // found at the given byte offsets of each vertex
+    void gather(const void* vertices, size_t stride, size_t positionOffset, size_t normalOffset, size_t count);
+
+    // Inverse of gather(), the other attributes of the vertices are left untouched
+    void scatter(void* vertices, size_t stride, size_t positionOffset, size_t normalOffset) const;
+};
+
+// Kernels on float streams. Output streams can be the input streams.
+
+// (x, y, z, 1) * matrix, without perspective division
+void transformPoints(const glm::mat4& matrix, const float* x, const float* y, const float* z,
+                     float* outX, float* outY, float* outZ, size_t count);
+
+void transformVectors(const glm::mat3& matrix, const float* x, const float* y, const float* z,
+                      float* outX, float* outY, float* outZ, size_t count);
+
+void normalizeVectors(float* x, float* y, float* z, size_t count);
+
+BBox3f computeBounds(const float* x, const float* y, const float* z, size_t count);
+
+// Bounds of count points read with a stride in bytes, from an array of structures
+BBox3f computeBounds(const glm::vec3* positions, size_t stride, size_t count);
+
+// Positions by matrix, normals by its inverse transpose, renormalized
+void transform(VertexStreams& streams, const glm::mat4& matrix);
+
+inline BBox3f computeBounds(const VertexStreams& streams) {
+    return computeBounds(streams.m_PositionX.data(), streams.m_PositionY.data(), streams.m_PositionZ.data(), streams.size());
+}
+
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+
+#include "Image.hpp"
+
+namespace glimac {
+
+// A tile of a virtual texture: square of the level, at (m_nX, m_nY) in tiles
+struct TileId {
+    unsigned int m_nLevel;
+    unsigned int m_nX;
+    unsigned int m_nY;
+};
+
+// How an image is split into tiles: each level of its mip chain is cut in tileSize x tileSize squares,
+// stored with a border of the neighbouring pixels (repeating the edges of the level) so that tiles can
+// be filtered linearly side by side. There is a level per level of the page table, the last one of
+// a single tile.
+class VirtualTextureLayout {
+public:
+    VirtualTextureLayout() = default;
+
+    VirtualTextureLayout(unsigned int width, unsigned int height, unsigned int tileSize, unsigned int border);
+
+    unsigned int getWidth() const {
+        return m_nWidth;
+    }
+
+    unsigned int getHeight() const {
+        return m_nHeight;
+    }
+
+    unsigned int getTileSize() const {
+        return m_nTileSize;
+    }
+
+    unsigned int getBorder() const {
+        return m_nBorder;
+    }
+
+    // Pixels per side of a stored tile, borders included
+    unsigned int getPhysicalTileSize() const {
+        return m_nTileSize + 2 * m_nBorder;
+    }
+
+    unsigned int getLevelCount() const {
+        return unsigned(m_LevelOffsets.size()) - 1;
+    }
+
+    unsigned int getTileCountX(unsigned int level) const;
+
+    unsigned int getTileCountY(unsigned int level) const;
+
+    // Of all levels
+    size_t getTileCount() const {
+        return m_LevelOffsets.back();
+    }
+
+    // Tiles sorted level by level, row by row
+    size_t getTileIndex(const TileId& tile) const {
+        return m_LevelOffsets[tile.m_nLevel] + size_t(tile.m_nY) * getTileCountX(tile.m_nLevel) + tile.m_nX;
+    }
+
+    // Entries of each level of the page table: the tile counts of level 0 rounded up to powers of two,
+    // halved at each level as GL mip levels are
+    unsigned int getPageTableWidth(unsigned int level) const {
+        return std::max(1u, m_nPageTableWidth >> level);
+    }
+
+    unsigned int getPageTableHeight(unsigned int level) const {
+        return std::max(1u, m_nPageTableHeight >> level);
+    }
+
+private:
+    unsigned int m_nWidth = 0u;
+    unsigned int m_nHeight = 0u;
+    unsigned int m_nTileSize = 1u;
+    unsigned int m_nBorder = 0u;
+    unsigned int m_nPageTableWidth = 1u;
+    unsigned int m_nPageTableHeight = 1u;
+    std::vector<size_t> m_LevelOffsets { 0u, 1u }; // Index of the first tile of each level, then the tile count
+};
+
+// A missing tile to read in a slot of the physical cache
+struct TileLoad {
+    TileId m_Tile;
+    unsigned int m_nSlot;
+};
+
+// Which tiles of a virtual texture are in the slots of a fixed size physical cache, without any GL call.
+// Every frame, the tiles seen on screen are requested, then update() chooses the missing ones to load,
+// coarsest first, in the slots of the least recently requested tiles. Slot 0 always holds the tile of
+// the last level, so that every part of the texture has a resident ancestor.
+//
+// The page table has an RGBA8 entry per tile of each level, (slot x, slot y, level, 255), naming the
+// tile itself when resident, else its closest resident ancestor.
+class TileResidency {
+public:
+    // slotCountX x slotCountY slots, at most 256 per side
+    TileResidency(const VirtualTextureLayout& layout, unsigned int slotCountX, unsigned int slotCountY);
+
+    const VirtualTextureLayout& getLayout() const {
+        return m_Layout;
+    }
+
+    unsigned int getSlotCountX() const {
+        return m_nSlotCountX;
+    }
+
+    unsigned int getSlotCountY() const {
+        return m_nSlotCountY;
+    }
+
+    // Requests the tile and its ancestors for the next update()
+    void request(const TileId& tile);
+
+    // Requests the tiles written by the feedback shader in RGBA8 pixels: (x & 255, y & 255,
+    // (x >> 8) | (y >> 8) << 4, level + 1), or 0 where nothing was drawn: x and y below 4096. Invalid
+    // tiles are ignored.
+    void requestFeedback(const uint8_t* pPixels, size_t pixelCount);
+
+    // Chooses at most maxLoadCount tiles to load among the missing requested ones, and ends the frame
+    // of the requests. A tile requested in the frame is never evicted: when they all are, the remaining
+    // missing tiles wait (getMissingTileCount()). The page table already points to the returned slots.
+    std::vector<TileLoad> update(unsigned int maxLoadCount);
+
+    bool isResident(const TileId& tile) const {
+        return m_TileSlots[m_Layout.getTileIndex(tile)] >= 0;
+    }
+
+    // Requested tiles that did not get a slot at the last update()
+    size_t getMissingTileCount() const {
+        return m_nMissingTileCount;
+    }
+
+    const uint8_t* getPageTable(unsigned int level) const {
+        return m_PageTable[level].data();
+    }
+
+    // Rows [begin, end) of the level changed since clearDirtyRows(), false if none did
+    bool getDirtyRows(unsigned int level, unsigned int& begin, unsigned int& end) const;
+
+    void clearDirtyRows();
+
+private:
+    // Tile of the next level covering the tile: coordinates halved, clamped to the tiles of the level
+    // since level sizes are rounded down
+    TileId getParent(const TileId& tile) const;
+
+    // Entry of the tile set to entry, and of its descendants which are not resident
+    void setEntry(const TileId& tile, const uint8_t entry[4]);
+
+    uint8_t* getEntry(const TileId& tile) {
+        return &m_PageTable[tile.m_nLevel][4 * (size_t(tile.m_nY) * m_Layout.getPageTableWidth(tile.m_nLevel) + tile.m_nX)];
+    }
+
+    VirtualTextureLayout m_Layout;
+    unsigned int m_nSlotCountX;
+    unsigned int m_nSlotCountY;
+    uint32_t m_nFrame = 1u;
+    std::vector<int> m_TileSlots; // By tile index, -1 if not resident
+    std::vector<uint32_t> m_TileRequestFrames; // By tile index, frame of the last request
+    std::vector<TileId> m_SlotTiles; // Tile of each slot, of level ~0u if empty
+    std::list<unsigned int> m_LRUSlots; // Least recently requested first, slot 0 excepted
+    std::vector<std::list<unsigned int>::iterator> m_LRUPositions; // By slot
+    std::vector<TileId> m_MissingTiles; // Requested in the current frame
+    size_t m_nMissingTileCount = 0u;
+    std::vector<std::vector<uint8_t>> m_PageTable;
+    std::vector<std::pair<unsigned int, unsigned int>> m_DirtyRows; // By level, [begin, end)
+};
+
+// Tile file written by bakeVirtualTexture(), read a tile at a time
+class VirtualTextureFile {
+public:
+    // False with a message if the file can't be read or is not a tile file
+    bool open(const FilePath& filepath);
+
+    const VirtualTextureLayout& getLayout() const {
+        return m_Layout;
+    }
+
+    PixelFormat getFormat() const {
+        return m_Format;
+    }
+
+    // Bytes of a tile, borders included
+    size_t getTileDataSize() const;
+
+    bool readTile(const TileId& tile, uint8_t* pData);
+
+private:
+    VirtualTextureLayout m_Layout;
+    PixelFormat m_Format = PixelFormat::RGBA8;
+    std::ifstream m_File;
+};
+
+// Splits the levels of the mip chain of image into tiles, in its format
+bool bakeVirtualTexture(const FilePath& filepath, const Image& image, unsigned int tileSize = 128u,
+                        unsigned int border = 4u);
+
+// Tile file of the image loaded from imagePath, next to it
+FilePath getVirtualTexturePath(const FilePath& imagePath);
+
+// Low resolution render target of the feedback pass. Its pixels are read back through two pixel pack
+// buffers: getPixels() gives those of the previous feedback pass, so that reading them never waits
+// for the GPU.
+class FeedbackBuffer {
+public:
+    FeedbackBuffer(unsigned int width, unsigned int height);
+
+    ~FeedbackBuffer();
+
+    FeedbackBuffer(const FeedbackBuffer&) = delete;
+    FeedbackBuffer& operator =(const FeedbackBuffer&) = delete;
+
+    unsigned int getWidth() const {
+        return m_nWidth;
+    }
+
+    unsigned int getHeight() const {
+        return m_nHeight;
+    }
+
+    // Binds the framebuffer and its viewport, cleared to 0
+    void begin();
+
+    // Queues the read back of the pixels, makes those of the previous pass available and restores the
+    // default framebuffer and the viewport
+    void end();
+
+    // RGBA8 pixels of the previous pass, empty before the second one
+    const std::vector<uint8_t>& getPixels() const {
+        return m_Pixels;
+    }
+
+private:
+    unsigned int m_nWidth;
+    unsigned int m_nHeight;
+    GLuint m_nFramebuffer = 0u;
+    GLuint m_Renderbuffers[2] = { 0u, 0u }; // Color, depth
+    GLuint m_PackBuffers[2] = { 0u, 0u };
+    unsigned int m_nPassCount = 0u;
+    GLint m_Viewport[4];
+    std::vector<uint8_t> m_Pixels;
+};
+
+// Image of any size drawn from a physical cache texture of a fixed size, whose tiles are read from the
+// tile file of the image as the feedback pass requests them.
+//
+// The shaders get the uniforms set by setUniforms(): uVTPhysical and uVTPageTable (samplers),
+// uVTVirtualSize (ivec2), uVTTileSize, uVTBorder, uVTLevelCount (int) and uVTSlotCount (ivec2).
+class VirtualTexture {
+public:
+    // Tile file of the image, baked when missing or older than the image. Returns nullptr with a message
+    // if the image can't be loaded.
+    static std::unique_ptr<VirtualTexture> load(const FilePath& imagePath, unsigned int slotCountX = 16u,
+                                                unsigned int slotCountY = 16u, unsigned int tileSize = 128u,
+                                                unsigned int border = 4u);
+
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator =(const VirtualTexture&) = delete;
+
+    TileResidency& getResidency() {
+        return m_Residency;
+    }
+
+    const TileResidency& getResidency() const {
+        return m_Residency;
+    }
+
+    void processFeedback(const FeedbackBuffer& feedback) {
+        m_Residency.requestFeedback(feedback.getPixels().data(), feedback.getPixels().size() / 4);
+    }
+
+    // Reads and uploads at most maxLoadCount missing tiles, then the changed rows of the page table.
+    // Changes the texture binding of the active unit. Returns the number of tiles loaded.
+    unsigned int update(unsigned int maxLoadCount = 16u);
+
+    // Binds the physical cache and the page table on these units and sets their uniforms on the program
+    // in use
+    void setUniforms(GLuint program, GLuint physicalUnit, GLuint pageTableUnit) const;
+
+private:
+    VirtualTexture(VirtualTextureFile file, unsigned int slotCountX, unsigned int slotCountY);
+
+    // Changed rows of the page table
+    void uploadPageTable();
+
+    VirtualTextureFile m_File;
+    TileResidency m_Residency;
+    GLuint m_nPhysicalTexture = 0u;
+    GLuint m_nPageTableTexture = 0u;
+    std::vector<uint8_t> m_TileData;
+};
+
+}
@@ -0,0 +1,495 @@
+#include "glimac/BVH.hpp"
+#include "glimac/Parallel.hpp"
+#include <algorithm>
+#include <future>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace glimac {
+
+namespace {
+
+const unsigned int kBinCount = 16;
+const unsigned int kMaxLeafSize = 8;
+const unsigned int kParallelBuildThreshold = 4096; // Smaller subtrees are built on the current thread
+const unsigned int kMaxSAHDepth = 64; // Deeper nodes are split at the median, to bound the depth
+const unsigned int kStackSize = 128;
+
+struct BuildContext {
+    std::vector<BBox3f> m_Bounds;
+    std::vector<glm::vec3> m_Centroids;
+    std::vector<unsigned int> m_References; // Triangles, partitioned in place during the build
+    unsigned int m_nMaxParallelDepth;
+};
+
+BBox3f emptyBox() {
+    return BBox3f(glm::vec3(std::numeric_limits<float>::infinity()), glm::vec3(-std::numeric_limits<float>::infinity()));
+}
+
+// Half of the surface area
+float halfArea(const BBox3f& box) {
+    auto d = box.size();
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void setNodeBounds(BVH::Node& node, const BBox3f& box) {
+    for (auto i = 0u; i < 3; ++i) {
+        node.m_Lower[i] = box.lower[i];
+        node.m_Upper[i] = box.upper[i];
+    }
+}
+
+void buildRecursive(BuildContext& context, std::vector<BVH::Node>& nodes, unsigned int begin, unsigned int end, unsigned int depth) {
+    auto& refs = context.m_References;
+
+    auto box = emptyBox();
+    auto centroidBox = emptyBox();
+    for (auto i = begin; i < end; ++i) {
+        box.grow(context.m_Bounds[refs[i]]);
+        centroidBox.grow(context.m_Centroids[refs[i]]);
+    }
+
+    auto nodeIndex = nodes.size();
+    nodes.emplace_back();
+    setNodeBounds(nodes[nodeIndex], box);
+
+    auto count = end - begin;
+    auto makeLeaf = [&]() {
+        nodes[nodeIndex].m_nOffset = begin;
+        nodes[nodeIndex].m_nCount = count;
+    };
+    if (count <= 2u) {
+        makeLeaf();
+        return;
+    }
+
+    // Binned SAH: find the best plane between bins along each axis
+    auto bestCost = std::numeric_limits<float>::infinity();
+    auto bestAxis = -1;
+    auto bestBin = 0u;
+    auto extent = centroidBox.size();
+
+    for (auto axis = 0; axis < 3 && depth < kMaxSAHDepth; ++axis) {
+        if (extent[axis] <= 0.f) {
+            continue;
+        }
+        auto scale = kBinCount * (1.f - 1e-6f) / extent[axis];
+
+        unsigned int binCount[kBinCount] = { 0u };
+        BBox3f binBox[kBinCount];
+        std::fill(binBox, binBox + kBinCount, emptyBox());
+        for (auto i = begin; i < end; ++i) {
+            auto b = std::min(kBinCount - 1, unsigned((context.m_Centroids[refs[i]][axis] - centroidBox.lower[axis]) * scale));
+            ++binCount[b];
+            binBox[b].grow(context.m_Bounds[refs[i]]);
+        }
+
+        // Right side sweep, then left side sweep evaluating the planes
+        float rightCost[kBinCount];
+        auto rightBox = emptyBox();
+        auto rightCount = 0u;
+        for (auto b = kBinCount - 1; b > 0; --b) {
+            rightBox.grow(binBox[b]);
+            rightCount += binCount[b];
+            rightCost[b] = rightCount ? rightCount * halfArea(rightBox) : 0.f;
+        }
+
+        auto leftBox = emptyBox();
+        auto leftCount = 0u;
+        for (auto b = 0u; b + 1 < kBinCount; ++b) {
+            leftBox.grow(binBox[b]);
+            leftCount += binCount[b];
+            if (leftCount == 0u || leftCount == count) {
+                continue;
+            }
+            auto cost = leftCount * halfArea(leftBox) + rightCost[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    // Traversal cost = 1, intersection cost = 1
+    auto splitCost = 1.f + bestCost / std::max(halfArea(box), 1e-30f);
+    if (bestAxis < 0 || splitCost >= count) {
+        if (count <= kMaxLeafSize) {
+            makeLeaf();
+            return;
+        }
+    }
+
+    unsigned int mid;
+    if (bestAxis >= 0) {
+        auto scale = kBinCount * (1.f - 1e-6f) / extent[bestAxis];
+        auto lower = centroidBox.lower[bestAxis];
+        mid = std::partition(refs.begin() + begin, refs.begin() + end, [&](unsigned int ref) {
+            return std::min(kBinCount - 1, unsigned((context.m_Centroids[ref][bestAxis] - lower) * scale)) <= bestBin;
+        }) - refs.begin();
+    } else {
+        // Median split along the largest extent (arbitrary if all centroids are equal)
+        bestAxis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        mid = begin + count / 2;
+        std::nth_element(refs.begin() + begin, refs.begin() + mid, refs.begin() + end, [&](unsigned int a, unsigned int b) {
+            return context.m_Centroids[a][bestAxis] < context.m_Centroids[b][bestAxis];
+        });
+    }
+
+    nodes[nodeIndex].m_nCount = BVH::Node::INNER_FLAG | unsigned(bestAxis);
+
+    if (count >= kParallelBuildThreshold && depth < context.m_nMaxParallelDepth) {
+        // Build the left subtree on another thread, then append both subtrees after the node
+        std::vector<BVH::Node> leftNodes, rightNodes;
+        auto left = std::async(std::launch::async, [&]() {
+            buildRecursive(context, leftNodes, begin, mid, depth + 1);
+        });
+        buildRecursive(context, rightNodes, mid, end, depth + 1);
+        left.get();
+
+        auto append = [&](const std::vector<BVH::Node>& subtree) {
+            auto base = unsigned(nodes.size());
+            for (auto node: subtree) {
+                if (!node.isLeaf()) {
+                    node.m_nOffset += base;
+                }
+                nodes.push_back(node);
+            }
+        };
+        append(leftNodes);
+        nodes[nodeIndex].m_nOffset = nodes.size();
+        append(rightNodes);
+    } else {
+        buildRecursive(context, nodes, begin, mid, depth + 1);
+        nodes[nodeIndex].m_nOffset = nodes.size();
+        buildRecursive(context, nodes, mid, end, depth + 1);
+    }
+}
+
+inline bool intersectBox(const BVH::Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float tMin, float tMax) {
+    for (auto i = 0u; i < 3; ++i) {
+        auto t0 = (node.m_Lower[i] - origin[i]) * invDirection[i];
+        auto t1 = (node.m_Upper[i] - origin[i]) * invDirection[i];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax;
+}
+
+}
+
+void BVH::build(const Geometry& geometry) {
+    m_Nodes.clear();
+    m_Triangles.clear();
+
+    auto triangleCount = unsigned(geometry.getIndexCount() / 3);
+    if (triangleCount == 0u) {
+        return;
+    }
+    auto pIndex = geometry.getIndexBuffer();
+    auto pVertex = geometry.getVertexBuffer();
+
+    BuildContext context;
+    context.m_Bounds.resize(triangleCount);
+    context.m_Centroids.resize(triangleCount);
+    context.m_References.resize(triangleCount);
+    context.m_nMaxParallelDepth = unsigned(std::ceil(std::log2(float(std::max(1u, std::thread::hardware_concurrency()))))) + 1;
+
+    parallelFor(triangleCount, [&](size_t begin, size_t end) {
+        for (auto t = begin; t < end; ++t) {
+            BBox3f box(pVertex[pIndex[3 * t]].m_Position);
+            box.grow(pVertex[pIndex[3 * t + 1]].m_Position);
+            box.grow(pVertex[pIndex[3 * t + 2]].m_Position);
+            context.m_Bounds[t] = box;
+            context.m_Centroids[t] = center(box);
+            context.m_References[t] = unsigned(t);
+        }
+    });
+
+    m_Nodes.reserve(triangleCount);
+    buildRecursive(context, m_Nodes, 0u, triangleCount, 0u);
+
+    m_Triangles.resize(triangleCount);
+    parallelFor(triangleCount, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            auto t = context.m_References[i];
+            const auto& v0 = pVertex[pIndex[3 * t]].m_Position;
+            m_Triangles[i].m_V0 = v0;
+            m_Triangles[i].m_E1 = pVertex[pIndex[3 * t + 1]].m_Position - v0;
+            m_Triangles[i].m_E2 = pVertex[pIndex[3 * t + 2]].m_Position - v0;
+            m_Triangles[i].m_nIndex = t;
+        }
+    });
+}
+
+// Möller-Trumbore
+bool BVH::intersectTriangle(const Triangle& triangle, const Ray& ray, float tMax, float& t, glm::vec2& uv) const {
+    auto p = glm::cross(ray.m_Direction, triangle.m_E2);
+    auto det = glm::dot(triangle.m_E1, p);
+    if (det == 0.f) {
+        return false;
+    }
+    auto invDet = 1.f / det;
+    auto s = ray.m_Origin - triangle.m_V0;
+    auto u = glm::dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+    auto q = glm::cross(s, triangle.m_E1);
+    auto v = glm::dot(ray.m_Direction, q) * invDet;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+    t = glm::dot(triangle.m_E2, q) * invDet;
+    if (t < ray.m_fTMin || t > tMax) {
+        return false;
+    }
+    uv = glm::vec2(u, v);
+    return true;
+}
+
+bool BVH::intersect(const Ray& ray, RayHit& hit) const {
+    if (m_Nodes.empty()) {
+        return false;
+    }
+
+    auto invDirection = 1.f / ray.m_Direction;
+    auto tMax = ray.m_fTMax;
+    auto found = false;
+
+    unsigned int stack[kStackSize];
+    auto stackSize = 0u;
+    auto nodeIndex = 0u;
+
+    while (true) {
+        const auto& node = m_Nodes[nodeIndex];
+        if (intersectBox(node, ray.m_Origin, invDirection, ray.m_fTMin, tMax)) {
+            if (!node.isLeaf()) {
+                // Visit the child on the side of the ray origin first
+                auto nearChild = nodeIndex + 1, farChild = node.m_nOffset;
+                if (ray.m_Direction[node.getAxis()] < 0.f) {
+                    std::swap(nearChild, farChild);
+                }
+                stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+                continue;
+            }
+
+            for (auto i = node.m_nOffset; i < node.m_nOffset + node.m_nCount; ++i) {
+                float t;
+                glm::vec2 uv;
+                if (intersectTriangle(m_Triangles[i], ray, tMax, t, uv)) {
+                    tMax = t;
+                    hit.m_fDistance = t;
+                    hit.m_nTriangleIndex = m_Triangles[i].m_nIndex;
+                    hit.m_Barycentrics = uv;
+                    found = true;
+                }
+            }
+        }
+        if (stackSize == 0u) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return found;
+}
+
+bool BVH::occluded(const Ray& ray) const {
+    if (m_Nodes.empty()) {
+        return false;
+    }
+
+    auto invDirection = 1.f / ray.m_Direction;
+
+    unsigned int stack[kStackSize];
+    auto stackSize = 0u;
+    auto nodeIndex = 0u;
+
+    while (true) {
+        const auto& node = m_Nodes[nodeIndex];
+        if (intersectBox(node, ray.m_Origin, invDirection, ray.m_fTMin, ray.m_fTMax)) {
+            if (!node.isLeaf()) {
+                stack[stackSize++] = node.m_nOffset;
+                nodeIndex = nodeIndex + 1;
+                continue;
+            }
+
+            for (auto i = node.m_nOffset; i < node.m_nOffset + node.m_nCount; ++i) {
+                float t;
+                glm::vec2 uv;
+                if (intersectTriangle(m_Triangles[i], ray, ray.m_fTMax, t, uv)) {
+                    return true;
+                }
+            }
+        }
+        if (stackSize == 0u) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return false;
+}
+
+namespace {
+
+// Inverse directions and current ranges of a packet, padded for aligned SIMD loads
+template<unsigned int N>
+struct PacketState {
+    alignas(16) float m_InvDirectionX[N];
+    alignas(16) float m_InvDirectionY[N];
+    alignas(16) float m_InvDirectionZ[N];
+    alignas(16) float m_OriginX[N];
+    alignas(16) float m_OriginY[N];
+    alignas(16) float m_OriginZ[N];
+    alignas(16) float m_TMin[N];
+    alignas(16) float m_TMax[N];
+};
+
+// Bit i of the result is set if ray i of the packet intersects the node in [tMin, tMax]
+template<unsigned int N>
+unsigned int intersectBox(const BVH::Node& node, const PacketState<N>& state) {
+    auto mask = 0u;
+#ifdef __SSE2__
+    auto lowerX = _mm_set1_ps(node.m_Lower[0]), upperX = _mm_set1_ps(node.m_Upper[0]);
+    auto lowerY = _mm_set1_ps(node.m_Lower[1]), upperY = _mm_set1_ps(node.m_Upper[1]);
+    auto lowerZ = _mm_set1_ps(node.m_Lower[2]), upperZ = _mm_set1_ps(node.m_Upper[2]);
+    for (auto i = 0u; i < N; i += 4) {
+        auto ox = _mm_load_ps(state.m_OriginX + i), idx = _mm_load_ps(state.m_InvDirectionX + i);
+        auto oy = _mm_load_ps(state.m_OriginY + i), idy = _mm_load_ps(state.m_InvDirectionY + i);
+        auto oz = _mm_load_ps(state.m_OriginZ + i), idz = _mm_load_ps(state.m_InvDirectionZ + i);
+
+        auto t0x = _mm_mul_ps(_mm_sub_ps(lowerX, ox), idx), t1x = _mm_mul_ps(_mm_sub_ps(upperX, ox), idx);
+        auto t0y = _mm_mul_ps(_mm_sub_ps(lowerY, oy), idy), t1y = _mm_mul_ps(_mm_sub_ps(upperY, oy), idy);
+        auto t0z = _mm_mul_ps(_mm_sub_ps(lowerZ, oz), idz), t1z = _mm_mul_ps(_mm_sub_ps(upperZ, oz), idz);
+
+        auto tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                                _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_load_ps(state.m_TMin + i)));
+        auto tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                               _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_load_ps(state.m_TMax + i)));
+        mask |= unsigned(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar))) << i;
+    }
+#else
+    for (auto i = 0u; i < N; ++i) {
+        if (intersectBox(node, glm::vec3(state.m_OriginX[i], state.m_OriginY[i], state.m_OriginZ[i]),
+                         glm::vec3(state.m_InvDirectionX[i], state.m_InvDirectionY[i], state.m_InvDirectionZ[i]),
+                         state.m_TMin[i], state.m_TMax[i])) {
+            mask |= 1u << i;
+        }
+    }
+#endif
+    return mask;
+}
+
+}
+
+template<unsigned int N>
+void BVH::traverse(const RayPacket<N>& packet, RayHit hits[N], bool anyHit) const {
+    static_assert(N % 4 == 0 && N <= 32, "Ray packets are processed by groups of 4 rays");
+
+    if (m_Nodes.empty()) {
+        return;
+    }
+
+    PacketState<N> state;
+    for (auto i = 0u; i < N; ++i) {
+        state.m_OriginX[i] = packet.m_OriginX[i];
+        state.m_OriginY[i] = packet.m_OriginY[i];
+        state.m_OriginZ[i] = packet.m_OriginZ[i];
+        state.m_InvDirectionX[i] = 1.f / packet.m_DirectionX[i];
+        state.m_InvDirectionY[i] = 1.f / packet.m_DirectionY[i];
+        state.m_InvDirectionZ[i] = 1.f / packet.m_DirectionZ[i];
+        state.m_TMin[i] = packet.m_TMin[i];
+        state.m_TMax[i] = packet.m_TMax[i];
+    }
+
+    // Packets are expected to be coherent: the first ray gives the traversal order
+    glm::vec3 direction(packet.m_DirectionX[0], packet.m_DirectionY[0], packet.m_DirectionZ[0]);
+
+    unsigned int stack[kStackSize];
+    auto stackSize = 0u;
+    auto nodeIndex = 0u;
+
+    while (true) {
+        const auto& node = m_Nodes[nodeIndex];
+        auto mask = intersectBox(node, state);
+        if (mask) {
+            if (!node.isLeaf()) {
+                auto nearChild = nodeIndex + 1, farChild = node.m_nOffset;
+                if (direction[node.getAxis()] < 0.f) {
+                    std::swap(nearChild, farChild);
+                }
+                stack[stackSize++] = farChild;
+                nodeIndex = nearChild;
+                continue;
+            }
+
+            for (auto r = 0u; r < N; ++r) {
+                if (!(mask & (1u << r))) {
+                    continue;
+                }
+                auto ray = packet.get(r);
+                for (auto i = node.m_nOffset; i < node.m_nOffset + node.m_nCount; ++i) {
+                    float t;
+                    glm::vec2 uv;
+                    if (intersectTriangle(m_Triangles[i], ray, state.m_TMax[r], t, uv)) {
+                        hits[r].m_fDistance = t;
+                        hits[r].m_nTriangleIndex = m_Triangles[i].m_nIndex;
+                        hits[r].m_Barycentrics = uv;
+                        if (anyHit) {
+                            // Terminated: its box tests fail from now on
+                            state.m_TMax[r] = -std::numeric_limits<float>::infinity();
+                            break;
+                        }
+                        state.m_TMax[r] = t;
+                    }
+                }
+            }
+        }
+        if (stackSize == 0u) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+}
+
+template<unsigned int N>
+void BVH::intersect(const RayPacket<N>& packet, RayHit hits[N]) const {
+    for (auto i = 0u; i < N; ++i) {
+        hits[i] = RayHit();
+    }
+    traverse(packet, hits, false);
+}
+
+template<unsigned int N>
+void BVH::occluded(const RayPacket<N>& packet, bool occluded[N]) const {
+    RayHit hits[N];
+    traverse(packet, hits, true);
+    for (auto i = 0u; i < N; ++i) {
+        occluded[i] = hits[i].hit();
+    }
+}
+
+template void BVH::intersect<4>(const RayPacket<4>&, RayHit[4]) const;
+template void BVH::intersect<8>(const RayPacket<8>&, RayHit[8]) const;
+template void BVH::occluded<4>(const RayPacket<4>&, bool[4]) const;
+template void BVH::occluded<8>(const RayPacket<8>&, bool[8]) const;
+
+Ray getPickingRay(const glm::mat4& projMatrix, const glm::mat4& viewMatrix,
+                  const glm::ivec2& windowPosition, const glm::ivec2& windowSize) {
+    glm::vec2 ndc(2.f * (windowPosition.x + 0.5f) / windowSize.x - 1.f,
+                  1.f - 2.f * (windowPosition.y + 0.5f) / windowSize.y);
+    auto inverseMatrix = glm::inverse(projMatrix * viewMatrix);
+    auto nearPoint = inverseMatrix * glm::vec4(ndc, -1.f, 1.f);
+    auto farPoint = inverseMatrix * glm::vec4(ndc, 1.f, 1.f);
+    auto origin = glm::vec3(nearPoint) / nearPoint.w;
+    auto direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    return Ray(origin, direction);
+}
+
+}
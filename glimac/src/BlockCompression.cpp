@@ -0,0 +1,856 @@
+#include "glimac/BlockCompression.hpp"
+#include "glimac/Parallel.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace glimac {
+
+namespace {
+
+const char COMPRESSED_FILE_MAGIC[4] = { 'G', 'C', 'T', 'X' };
+
+// Recorded in the cache files: to be incremented when an encoder changes its output
+const uint32_t ENCODER_VERSION = 1;
+
+// Rows of blocks per thread: below, the image is compressed on the calling thread
+const size_t MIN_BLOCK_ROWS_PER_THREAD = 4;
+
+// RGBA pixels of a 4x4 block, row by row
+typedef uint8_t Block[16][4];
+
+void loadBlock(const uint8_t* pixels, unsigned int width, unsigned int height,
+               unsigned int blockX, unsigned int blockY, Block block) {
+    for (auto y = 0u; y < 4; ++y) {
+        auto row = pixels + size_t(std::min(blockY * 4 + y, height - 1)) * width * 4;
+        for (auto x = 0u; x < 4; ++x) {
+            auto pixel = row + std::min(blockX * 4 + x, width - 1) * 4;
+            std::copy(pixel, pixel + 4, block[y * 4 + x]);
+        }
+    }
+}
+
+int clampByte(int value) {
+    return std::min(255, std::max(0, value));
+}
+
+int square(int value) {
+    return value * value;
+}
+
+// Mean of the first N channels of the block and direction of largest variance, by power iteration
+// on the covariance matrix. The axis is null for uniform blocks.
+template<unsigned int N>
+void computePrincipalAxis(const Block block, float mean[N], float axis[N]) {
+    for (auto c = 0u; c < N; ++c) {
+        auto sum = 0;
+        for (auto i = 0u; i < 16; ++i) {
+            sum += block[i][c];
+        }
+        mean[c] = sum / 16.f;
+    }
+
+    float covariance[N][N] = {};
+    for (auto i = 0u; i < 16; ++i) {
+        float d[N];
+        for (auto c = 0u; c < N; ++c) {
+            d[c] = block[i][c] - mean[c];
+        }
+        for (auto a = 0u; a < N; ++a) {
+            for (auto b = a; b < N; ++b) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+    auto largest = 0u;
+    for (auto a = 0u; a < N; ++a) {
+        for (auto b = 0u; b < a; ++b) {
+            covariance[a][b] = covariance[b][a];
+        }
+        if (covariance[a][a] > covariance[largest][largest]) {
+            largest = a;
+        }
+    }
+
+    // Starting from the channel of largest variance
+    for (auto c = 0u; c < N; ++c) {
+        axis[c] = c == largest ? 1.f : 0.f;
+    }
+    for (auto iteration = 0u; iteration < 8; ++iteration) {
+        float product[N] = {};
+        auto norm = 0.f;
+        for (auto a = 0u; a < N; ++a) {
+            for (auto b = 0u; b < N; ++b) {
+                product[a] += covariance[a][b] * axis[b];
+            }
+            norm = std::max(norm, std::abs(product[a]));
+        }
+        if (norm <= 0.f) {
+            std::fill(axis, axis + N, 0.f);
+            return;
+        }
+        for (auto c = 0u; c < N; ++c) {
+            axis[c] = product[c] / norm;
+        }
+    }
+    auto length = 0.f;
+    for (auto c = 0u; c < N; ++c) {
+        length += axis[c] * axis[c];
+    }
+    length = std::sqrt(length);
+    for (auto c = 0u; c < N; ++c) {
+        axis[c] /= length;
+    }
+}
+
+// Extremities of the projection of the block on its principal axis
+template<unsigned int N>
+void computeAxisEndpoints(const Block block, float endpoint0[N], float endpoint1[N]) {
+    float mean[N], axis[N];
+    computePrincipalAxis<N>(block, mean, axis);
+    auto lower = 0.f, upper = 0.f;
+    for (auto i = 0u; i < 16; ++i) {
+        auto t = 0.f;
+        for (auto c = 0u; c < N; ++c) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        lower = std::min(lower, t);
+        upper = std::max(upper, t);
+    }
+    for (auto c = 0u; c < N; ++c) {
+        endpoint0[c] = std::min(255.f, std::max(0.f, mean[c] + upper * axis[c]));
+        endpoint1[c] = std::min(255.f, std::max(0.f, mean[c] + lower * axis[c]));
+    }
+}
+
+// Endpoints minimizing the squared error of the N channels of the block when pixel i is
+// weights[indices[i]] * endpoint0 + (1 - weights[indices[i]]) * endpoint1.
+// Returns false when all the pixels have the same weight.
+template<unsigned int N>
+bool computeLeastSquaresEndpoints(const Block block, const uint8_t indices[16], const float* weights,
+                                  float endpoint0[N], float endpoint1[N]) {
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ap[N] = {}, bp[N] = {};
+    for (auto i = 0u; i < 16; ++i) {
+        auto a = weights[indices[i]], b = 1.f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (auto c = 0u; c < N; ++c) {
+            ap[c] += a * block[i][c];
+            bp[c] += b * block[i][c];
+        }
+    }
+    auto determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-4f) {
+        return false;
+    }
+    for (auto c = 0u; c < N; ++c) {
+        endpoint0[c] = std::min(255.f, std::max(0.f, (ap[c] * bb - bp[c] * ab) / determinant));
+        endpoint1[c] = std::min(255.f, std::max(0.f, (bp[c] * aa - ap[c] * ab) / determinant));
+    }
+    return true;
+}
+
+void writeLittleEndian(uint8_t* out, uint64_t value, unsigned int byteCount) {
+    for (auto i = 0u; i < byteCount; ++i) {
+        out[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+// BC1: two RGB565 endpoints and 2 bits per pixel. c0 > c1 selects the 4 colors mode, the only
+// one used here (BC3 always decodes its colors in this mode).
+
+// Weight of endpoint 0 for each index
+const float BC1_WEIGHTS[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+uint16_t packRGB565(const float color[3]) {
+    auto r = std::min(31, int(color[0] * 31.f / 255.f + 0.5f));
+    auto g = std::min(63, int(color[1] * 63.f / 255.f + 0.5f));
+    auto b = std::min(31, int(color[2] * 31.f / 255.f + 0.5f));
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t packed, int color[3]) {
+    auto r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Quantizes the endpoints and selects the nearest palette color of each pixel, returns the squared error
+int fitBC1Endpoints(const Block block, const float endpoint0[3], const float endpoint1[3],
+                    uint16_t& color0, uint16_t& color1, uint8_t indices[16]) {
+    color0 = packRGB565(endpoint0);
+    color1 = packRGB565(endpoint1);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    int palette[4][3];
+    unpackRGB565(color0, palette[0]);
+    unpackRGB565(color1, palette[1]);
+    for (auto c = 0u; c < 3; ++c) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    // A single color: index 0 everywhere keeps the block valid in the 3 colors mode too
+    auto paletteSize = color0 == color1 ? 1u : 4u;
+
+    auto error = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        auto best = INT_MAX;
+        for (auto j = 0u; j < paletteSize; ++j) {
+            auto distance = square(block[i][0] - palette[j][0]) + square(block[i][1] - palette[j][1])
+                    + square(block[i][2] - palette[j][2]);
+            if (distance < best) {
+                best = distance;
+                indices[i] = uint8_t(j);
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+void encodeBC1(const Block block, CompressionQuality quality, uint8_t* out) {
+    float endpoint0[3], endpoint1[3];
+    computeAxisEndpoints<3>(block, endpoint0, endpoint1);
+
+    uint16_t color0, color1;
+    uint8_t indices[16];
+    auto error = fitBC1Endpoints(block, endpoint0, endpoint1, color0, color1, indices);
+
+    for (auto iteration = 0u; quality == CompressionQuality::High && iteration < 2; ++iteration) {
+        uint16_t refinedColor0, refinedColor1;
+        uint8_t refinedIndices[16];
+        if (!computeLeastSquaresEndpoints<3>(block, indices, BC1_WEIGHTS, endpoint0, endpoint1)) {
+            break;
+        }
+        auto refinedError = fitBC1Endpoints(block, endpoint0, endpoint1, refinedColor0, refinedColor1, refinedIndices);
+        if (refinedError >= error) {
+            break;
+        }
+        error = refinedError;
+        color0 = refinedColor0;
+        color1 = refinedColor1;
+        std::copy(refinedIndices, refinedIndices + 16, indices);
+    }
+
+    uint32_t bits = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        bits |= uint32_t(indices[i]) << (2 * i);
+    }
+    writeLittleEndian(out, color0, 2);
+    writeLittleEndian(out + 2, color1, 2);
+    writeLittleEndian(out + 4, bits, 4);
+}
+
+// BC4: one channel, two 8 bits endpoints and 3 bits per pixel. v0 > v1 interpolates 6 values
+// between them, v0 <= v1 interpolates 4 and adds 0 and 255.
+
+// Weight of endpoint 0 for each index in the 8 values mode
+const float BC4_WEIGHTS[8] = { 1.f, 0.f, 6.f / 7.f, 5.f / 7.f, 4.f / 7.f, 3.f / 7.f, 2.f / 7.f, 1.f / 7.f };
+
+int fitBC4Endpoints(const uint8_t values[16], int value0, int value1, uint8_t indices[16]) {
+    int palette[8] = { value0, value1 };
+    if (value0 > value1) {
+        for (auto i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+        }
+    } else {
+        for (auto i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    auto error = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        auto best = INT_MAX;
+        for (auto j = 0u; j < 8; ++j) {
+            auto distance = square(values[i] - palette[j]);
+            if (distance < best) {
+                best = distance;
+                indices[i] = uint8_t(j);
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+void encodeBC4(const uint8_t values[16], CompressionQuality quality, uint8_t* out) {
+    auto bounds = std::minmax_element(values, values + 16);
+    int value0 = *bounds.second, value1 = *bounds.first;
+    uint8_t indices[16] = {};
+    auto error = 0;
+    if (value0 != value1) {
+        error = fitBC4Endpoints(values, value0, value1, indices);
+    }
+
+    if (quality == CompressionQuality::High && error > 0) {
+        uint8_t candidateIndices[16];
+
+        // Least squares endpoints of the 8 values mode
+        Block block;
+        for (auto i = 0u; i < 16; ++i) {
+            block[i][0] = values[i];
+        }
+        float endpoint0, endpoint1;
+        if (computeLeastSquaresEndpoints<1>(block, indices, BC4_WEIGHTS, &endpoint0, &endpoint1)) {
+            auto candidate0 = int(endpoint0 + 0.5f), candidate1 = int(endpoint1 + 0.5f);
+            if (candidate0 > candidate1) {
+                auto candidateError = fitBC4Endpoints(values, candidate0, candidate1, candidateIndices);
+                if (candidateError < error) {
+                    error = candidateError;
+                    value0 = candidate0;
+                    value1 = candidate1;
+                    std::copy(candidateIndices, candidateIndices + 16, indices);
+                }
+            }
+        }
+
+        // 6 values mode on the values other than 0 and 255
+        auto lower = 255, upper = 0;
+        for (auto i = 0u; i < 16; ++i) {
+            if (values[i] != 0 && values[i] != 255) {
+                lower = std::min(lower, int(values[i]));
+                upper = std::max(upper, int(values[i]));
+            }
+        }
+        if (lower <= upper) {
+            auto candidateError = fitBC4Endpoints(values, lower, upper, candidateIndices);
+            if (candidateError < error) {
+                error = candidateError;
+                value0 = lower;
+                value1 = upper;
+                std::copy(candidateIndices, candidateIndices + 16, indices);
+            }
+        }
+    }
+
+    uint64_t bits = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        bits |= uint64_t(indices[i]) << (3 * i);
+    }
+    out[0] = uint8_t(value0);
+    out[1] = uint8_t(value1);
+    writeLittleEndian(out + 2, bits, 6);
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared lowest bit (p bit) each,
+// 4 bits per pixel. The index of the first pixel has an implicit highest bit of 0.
+
+const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Weight of endpoint 0 for each index
+const float BC7_ENDPOINT0_WEIGHTS[16] = {
+    1.f, 60.f / 64, 55.f / 64, 51.f / 64, 47.f / 64, 43.f / 64, 38.f / 64, 34.f / 64,
+    30.f / 64, 26.f / 64, 21.f / 64, 17.f / 64, 13.f / 64, 9.f / 64, 4.f / 64, 0.f
+};
+
+struct BC7Endpoints {
+    int m_Values[2][4]; // 7 bits
+    int m_PBits[2];
+};
+
+void quantizeBC7Endpoint(const float endpoint[4], int pBit, int values[4]) {
+    for (auto c = 0u; c < 4; ++c) {
+        values[c] = std::min(127, std::max(0, int((endpoint[c] - pBit) * 0.5f + 0.5f)));
+    }
+}
+
+// P bit with the smallest quantization error of the endpoint alone
+int selectBC7PBit(const float endpoint[4]) {
+    float errors[2] = {};
+    for (auto pBit = 0; pBit < 2; ++pBit) {
+        int values[4];
+        quantizeBC7Endpoint(endpoint, pBit, values);
+        for (auto c = 0u; c < 4; ++c) {
+            auto difference = ((values[c] << 1) | pBit) - endpoint[c];
+            errors[pBit] += difference * difference;
+        }
+    }
+    return errors[1] < errors[0] ? 1 : 0;
+}
+
+// Index of each pixel by projection on the endpoint segment, checked against its two neighbors
+// since the weights are not evenly spaced. Returns the squared error.
+int selectBC7Indices(const Block block, const BC7Endpoints& endpoints, uint8_t indices[16]) {
+    int palette[16][4];
+    for (auto c = 0u; c < 4; ++c) {
+        auto value0 = (endpoints.m_Values[0][c] << 1) | endpoints.m_PBits[0];
+        auto value1 = (endpoints.m_Values[1][c] << 1) | endpoints.m_PBits[1];
+        for (auto j = 0u; j < 16; ++j) {
+            palette[j][c] = ((64 - BC7_WEIGHTS[j]) * value0 + BC7_WEIGHTS[j] * value1 + 32) >> 6;
+        }
+    }
+    int direction[4], lengthSquared = 0;
+    for (auto c = 0u; c < 4; ++c) {
+        direction[c] = palette[15][c] - palette[0][c];
+        lengthSquared += direction[c] * direction[c];
+    }
+
+    auto error = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        auto guess = 0;
+        if (lengthSquared > 0) {
+            auto dot = 0;
+            for (auto c = 0u; c < 4; ++c) {
+                dot += (block[i][c] - palette[0][c]) * direction[c];
+            }
+            guess = std::min(15, std::max(0, int(15.f * dot / lengthSquared + 0.5f)));
+        }
+        auto best = INT_MAX;
+        for (auto j = std::max(0, guess - 1); j <= std::min(15, guess + 1); ++j) {
+            auto distance = 0;
+            for (auto c = 0u; c < 4; ++c) {
+                distance += square(block[i][c] - palette[j][c]);
+            }
+            if (distance < best) {
+                best = distance;
+                indices[i] = uint8_t(j);
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+// Quantizes the endpoints with the p bits that fit them best, or with the best of the 4 combinations
+int fitBC7Endpoints(const Block block, const float endpoint0[4], const float endpoint1[4], bool searchPBits,
+                    BC7Endpoints& endpoints, uint8_t indices[16]) {
+    auto best = INT_MAX;
+    int pBits[2] = { selectBC7PBit(endpoint0), selectBC7PBit(endpoint1) };
+    for (auto combination = 0; combination < 4; ++combination) {
+        BC7Endpoints candidate;
+        candidate.m_PBits[0] = combination & 1;
+        candidate.m_PBits[1] = combination >> 1;
+        if (!searchPBits && (candidate.m_PBits[0] != pBits[0] || candidate.m_PBits[1] != pBits[1])) {
+            continue;
+        }
+        quantizeBC7Endpoint(endpoint0, candidate.m_PBits[0], candidate.m_Values[0]);
+        quantizeBC7Endpoint(endpoint1, candidate.m_PBits[1], candidate.m_Values[1]);
+        uint8_t candidateIndices[16];
+        auto error = selectBC7Indices(block, candidate, candidateIndices);
+        if (error < best) {
+            best = error;
+            endpoints = candidate;
+            std::copy(candidateIndices, candidateIndices + 16, indices);
+        }
+    }
+    return best;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out): m_pData(out) {
+    }
+
+    void write(uint32_t value, unsigned int bitCount) {
+        for (auto i = 0u; i < bitCount; ++i, ++m_nPosition) {
+            if ((value >> i) & 1u) {
+                m_pData[m_nPosition >> 3] |= uint8_t(1u << (m_nPosition & 7));
+            }
+        }
+    }
+
+private:
+    uint8_t* m_pData;
+    unsigned int m_nPosition = 0u;
+};
+
+void encodeBC7(const Block block, CompressionQuality quality, uint8_t* out) {
+    float endpoint0[4], endpoint1[4];
+    computeAxisEndpoints<4>(block, endpoint0, endpoint1);
+
+    auto high = quality == CompressionQuality::High;
+    BC7Endpoints endpoints;
+    uint8_t indices[16];
+    auto error = fitBC7Endpoints(block, endpoint0, endpoint1, high, endpoints, indices);
+
+    for (auto iteration = 0u; high && iteration < 2; ++iteration) {
+        BC7Endpoints refinedEndpoints;
+        uint8_t refinedIndices[16];
+        if (!computeLeastSquaresEndpoints<4>(block, indices, BC7_ENDPOINT0_WEIGHTS, endpoint0, endpoint1)) {
+            break;
+        }
+        auto refinedError = fitBC7Endpoints(block, endpoint0, endpoint1, true, refinedEndpoints, refinedIndices);
+        if (refinedError >= error) {
+            break;
+        }
+        error = refinedError;
+        endpoints = refinedEndpoints;
+        std::copy(refinedIndices, refinedIndices + 16, indices);
+    }
+
+    // The highest bit of the first index is implicit
+    if (indices[0] >= 8) {
+        std::swap(endpoints.m_Values[0], endpoints.m_Values[1]);
+        std::swap(endpoints.m_PBits[0], endpoints.m_PBits[1]);
+        for (auto i = 0u; i < 16; ++i) {
+            indices[i] = uint8_t(15 - indices[i]);
+        }
+    }
+
+    std::fill(out, out + 16, 0);
+    BitWriter writer(out);
+    writer.write(1u << 6, 7);
+    for (auto c = 0u; c < 4; ++c) {
+        writer.write(endpoints.m_Values[0][c], 7);
+        writer.write(endpoints.m_Values[1][c], 7);
+    }
+    writer.write(endpoints.m_PBits[0], 1);
+    writer.write(endpoints.m_PBits[1], 1);
+    writer.write(indices[0], 3);
+    for (auto i = 1u; i < 16; ++i) {
+        writer.write(indices[i], 4);
+    }
+}
+
+// ETC1 blocks, which ETC2 decoders read unchanged: two subblocks of 2x4 (flip = 0) or 4x2
+// (flip = 1) pixels, each with a base color and a table of 4 offsets added to its 3 channels.
+// The base colors are 4 bits each (individual mode) or 5 bits plus a 3 bits signed difference
+// for the second one (differential mode). Differences that overflow select the ETC2 modes, so
+// they are never written.
+
+const int ETC_MODIFIERS[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// Selectors in the order of the block bits: +small, +large, -small, -large
+int getEtcModifier(int table, int selector) {
+    auto modifier = ETC_MODIFIERS[table][selector & 1];
+    return selector & 2 ? -modifier : modifier;
+}
+
+struct EtcSubblock {
+    int m_Color[3];  // Quantized base color
+    int m_nTable;
+    int m_nError;
+};
+
+// Best table and selectors of the pixels of a subblock for an expanded base color. In fast mode the
+// selector of a pixel is the offset nearest to its mean difference to the base color, which is
+// exact until channels clamp.
+int fitEtcSubblock(const Block block, const unsigned int pixels[8], const int base[3],
+                   CompressionQuality quality, int& table, uint8_t selectors[16]) {
+    auto best = INT_MAX;
+    for (auto t = 0; t < 8; ++t) {
+        auto error = 0;
+        uint8_t tableSelectors[8];
+        for (auto k = 0u; k < 8 && error < best; ++k) {
+            const auto& pixel = block[pixels[k]];
+            if (quality == CompressionQuality::Fast) {
+                auto difference = (pixel[0] - base[0] + pixel[1] - base[1] + pixel[2] - base[2]) / 3.f;
+                auto small = ETC_MODIFIERS[t][0], large = ETC_MODIFIERS[t][1];
+                auto magnitude = std::abs(difference) > (small + large) * 0.5f ? 1 : 0;
+                tableSelectors[k] = uint8_t((difference < 0.f ? 2 : 0) | magnitude);
+                auto modifier = getEtcModifier(t, tableSelectors[k]);
+                for (auto c = 0u; c < 3; ++c) {
+                    error += square(clampByte(base[c] + modifier) - pixel[c]);
+                }
+            } else {
+                auto pixelBest = INT_MAX;
+                for (auto s = 0; s < 4; ++s) {
+                    auto modifier = getEtcModifier(t, s);
+                    auto distance = 0;
+                    for (auto c = 0u; c < 3; ++c) {
+                        distance += square(clampByte(base[c] + modifier) - pixel[c]);
+                    }
+                    if (distance < pixelBest) {
+                        pixelBest = distance;
+                        tableSelectors[k] = uint8_t(s);
+                    }
+                }
+                error += pixelBest;
+            }
+        }
+        if (error < best) {
+            best = error;
+            table = t;
+            for (auto k = 0u; k < 8; ++k) {
+                selectors[pixels[k]] = tableSelectors[k];
+            }
+        }
+    }
+    return best;
+}
+
+int expandEtcColor(int value, int bitCount) {
+    return bitCount == 4 ? value * 17 : (value << 3) | (value >> 2);
+}
+
+EtcSubblock encodeEtcSubblock(const Block block, const unsigned int pixels[8], const int quantized[3], int bitCount,
+                           CompressionQuality quality, uint8_t selectors[16]) {
+    EtcSubblock subblock;
+    int base[3];
+    for (auto c = 0u; c < 3; ++c) {
+        subblock.m_Color[c] = quantized[c];
+        base[c] = expandEtcColor(quantized[c], bitCount);
+    }
+    subblock.m_nError = fitEtcSubblock(block, pixels, base, quality, subblock.m_nTable, selectors);
+    return subblock;
+}
+
+void encodeETC1(const Block block, CompressionQuality quality, uint8_t* out) {
+    auto bestError = INT_MAX;
+    auto bestFlip = 0, bestDifferential = 0;
+    EtcSubblock bestSubblocks[2] = {};
+    uint8_t bestSelectors[16];
+
+    for (auto flip = 0; flip < 2; ++flip) {
+        unsigned int pixels[2][8];
+        float means[2][3] = {};
+        unsigned int counts[2] = {};
+        for (auto i = 0u; i < 16; ++i) {
+            auto x = i % 4, y = i / 4;
+            auto s = (flip ? y : x) >= 2 ? 1 : 0;
+            pixels[s][counts[s]++] = i;
+            for (auto c = 0u; c < 3; ++c) {
+                means[s][c] += block[i][c] / 8.f;
+            }
+        }
+
+        int colors5[2][3], colors4[2][3];
+        auto differenceFits = true;
+        for (auto s = 0u; s < 2; ++s) {
+            for (auto c = 0u; c < 3; ++c) {
+                colors5[s][c] = int(means[s][c] * 31.f / 255.f + 0.5f);
+                colors4[s][c] = int(means[s][c] * 15.f / 255.f + 0.5f);
+            }
+        }
+        for (auto c = 0u; c < 3; ++c) {
+            auto difference = colors5[1][c] - colors5[0][c];
+            differenceFits = differenceFits && difference >= -4 && difference <= 3;
+        }
+
+        // The differential mode is finer when it fits: fast mode does not try the other one then
+        for (auto differential = 0; differential < 2; ++differential) {
+            if ((differential && !differenceFits)
+                    || (!differential && differenceFits && quality == CompressionQuality::Fast)) {
+                continue;
+            }
+            auto colors = differential ? colors5 : colors4;
+            auto bitCount = differential ? 5 : 4;
+            uint8_t selectors[16];
+            EtcSubblock subblocks[2] = {
+                encodeEtcSubblock(block, pixels[0], colors[0], bitCount, quality, selectors),
+                encodeEtcSubblock(block, pixels[1], colors[1], bitCount, quality, selectors)
+            };
+            auto error = subblocks[0].m_nError + subblocks[1].m_nError;
+            if (error < bestError) {
+                bestError = error;
+                bestFlip = flip;
+                bestDifferential = differential;
+                bestSubblocks[0] = subblocks[0];
+                bestSubblocks[1] = subblocks[1];
+                std::copy(selectors, selectors + 16, bestSelectors);
+            }
+        }
+    }
+
+    for (auto c = 0u; c < 3; ++c) {
+        const auto& color0 = bestSubblocks[0].m_Color[c];
+        const auto& color1 = bestSubblocks[1].m_Color[c];
+        out[c] = uint8_t(bestDifferential ? (color0 << 3) | ((color1 - color0) & 7) : (color0 << 4) | color1);
+    }
+    out[3] = uint8_t((bestSubblocks[0].m_nTable << 5) | (bestSubblocks[1].m_nTable << 2)
+                     | (bestDifferential << 1) | bestFlip);
+
+    // Pixels column by column: highest selector bits in the upper half, lowest ones in the lower half
+    uint32_t bits = 0;
+    for (auto i = 0u; i < 16; ++i) {
+        auto x = i % 4, y = i / 4;
+        auto bit = x * 4 + y;
+        bits |= uint32_t(bestSelectors[i] >> 1) << (bit + 16);
+        bits |= uint32_t(bestSelectors[i] & 1) << bit;
+    }
+    for (auto i = 0u; i < 4; ++i) {
+        out[4 + i] = uint8_t(bits >> (24 - 8 * i));
+    }
+}
+
+void encodeBlock(const Block block, CompressedFormat format, CompressionQuality quality, uint8_t* out) {
+    uint8_t channels[2][16];
+    switch (format) {
+    case CompressedFormat::BC1:
+        encodeBC1(block, quality, out);
+        break;
+    case CompressedFormat::BC3:
+        for (auto i = 0u; i < 16; ++i) {
+            channels[0][i] = block[i][3];
+        }
+        encodeBC4(channels[0], quality, out);
+        encodeBC1(block, quality, out + 8);
+        break;
+    case CompressedFormat::BC5:
+        for (auto i = 0u; i < 16; ++i) {
+            channels[0][i] = block[i][0];
+            channels[1][i] = block[i][1];
+        }
+        encodeBC4(channels[0], quality, out);
+        encodeBC4(channels[1], quality, out + 8);
+        break;
+    case CompressedFormat::BC7:
+        encodeBC7(block, quality, out);
+        break;
+    case CompressedFormat::ETC2_RGB:
+        encodeETC1(block, quality, out);
+        break;
+    }
+}
+
+}
+
+const char* getName(CompressedFormat format) {
+    switch (format) {
+    case CompressedFormat::BC1:
+        return "bc1";
+    case CompressedFormat::BC3:
+        return "bc3";
+    case CompressedFormat::BC5:
+        return "bc5";
+    case CompressedFormat::BC7:
+        return "bc7";
+    default:
+        return "etc2";
+    }
+}
+
+size_t getBlockSize(CompressedFormat format) {
+    switch (format) {
+    case CompressedFormat::BC1:
+    case CompressedFormat::ETC2_RGB:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+GLenum getGLInternalFormat(CompressedFormat format, bool sRGB) {
+    switch (format) {
+    case CompressedFormat::BC1:
+        return sRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case CompressedFormat::BC3:
+        return sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case CompressedFormat::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case CompressedFormat::BC7:
+        return sRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+        return sRGB ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2;
+    }
+}
+
+CompressedImage::CompressedImage(unsigned int width, unsigned int height, CompressedFormat format, bool sRGB):
+    m_nWidth(width), m_nHeight(height), m_Format(format), m_bSRGB(sRGB && format != CompressedFormat::BC5),
+    m_Data(size_t(getBlockCountX()) * getBlockCountY() * getBlockSize(format)) {
+}
+
+std::unique_ptr<CompressedImage> compressImage(const Image& image, CompressedFormat format, CompressionQuality quality) {
+    std::unique_ptr<Image> pConverted;
+    if (image.getFormat() != PixelFormat::RGBA8 && image.getFormat() != PixelFormat::SRGB8_A8) {
+        pConverted = image.convert(PixelFormat::RGBA8);
+    }
+    auto pixels = pConverted ? pConverted->getData() : image.getData();
+    auto width = image.getWidth(), height = image.getHeight();
+
+    std::unique_ptr<CompressedImage> pCompressed(
+        new CompressedImage(width, height, format, image.getFormat() == PixelFormat::SRGB8_A8));
+    if (!width || !height) {
+        return pCompressed;
+    }
+    auto blockCountX = pCompressed->getBlockCountX();
+    auto blockSize = getBlockSize(format);
+    auto pOut = pCompressed->getData();
+
+    parallelFor(pCompressed->getBlockCountY(), [&](size_t begin, size_t end) {
+        Block block;
+        for (auto blockY = begin; blockY < end; ++blockY) {
+            for (auto blockX = 0u; blockX < blockCountX; ++blockX) {
+                loadBlock(pixels, width, height, blockX, unsigned(blockY), block);
+                encodeBlock(block, format, quality, pOut + (blockY * blockCountX + blockX) * blockSize);
+            }
+        }
+    }, MIN_BLOCK_ROWS_PER_THREAD);
+
+    return pCompressed;
+}
+
+void uploadCompressedImage(GLenum target, const CompressedImage& image, GLint level) {
+    glCompressedTexImage2D(target, level, getGLInternalFormat(image.getFormat(), image.isSRGB()),
+                           image.getWidth(), image.getHeight(), 0, GLsizei(image.getDataSize()), image.getData());
+}
+
+bool saveCompressedImage(const FilePath& filepath, const Image& source, CompressionQuality quality,
+                         const CompressedImage& image) {
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open " << filepath << " for writing" << std::endl;
+        return false;
+    }
+
+    uint64_t hash = computeImageHash(source);
+    uint32_t header[6] = { ENCODER_VERSION, uint32_t(image.getFormat()), uint32_t(quality),
+                           uint32_t(image.isSRGB()), image.getWidth(), image.getHeight() };
+    file.write(COMPRESSED_FILE_MAGIC, sizeof(COMPRESSED_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(image.getData()), image.getDataSize());
+
+    return bool(file);
+}
+
+std::unique_ptr<CompressedImage> loadCompressedImage(const FilePath& filepath, const Image& source,
+                                                     CompressedFormat format, CompressionQuality quality) {
+    std::ifstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+
+    char magic[4];
+    uint64_t hash;
+    uint32_t header[6];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || !std::equal(magic, magic + 4, COMPRESSED_FILE_MAGIC)) {
+        std::cerr << filepath << " is not a compressed image file" << std::endl;
+        return nullptr;
+    }
+    if (header[0] != ENCODER_VERSION || header[1] != uint32_t(format) || header[2] != uint32_t(quality)
+            || header[4] != source.getWidth() || header[5] != source.getHeight() || hash != computeImageHash(source)) {
+        std::clog << filepath << " is out of date" << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<CompressedImage> pImage(new CompressedImage(header[4], header[5], format, header[3] != 0));
+    file.read(reinterpret_cast<char*>(pImage->getData()), pImage->getDataSize());
+    if (!file) {
+        std::cerr << filepath << " is truncated" << std::endl;
+        return nullptr;
+    }
+    return pImage;
+}
+
+FilePath getCompressedCachePath(const FilePath& imagePath, CompressedFormat format) {
+    return imagePath.addExt(std::string(".") + getName(format));
+}
+
+std::unique_ptr<CompressedImage> loadOrCompressImage(const FilePath& imagePath, const Image& image,
+                                                     CompressedFormat format, CompressionQuality quality) {
+    auto cachePath = getCompressedCachePath(imagePath, format);
+    auto pCompressed = loadCompressedImage(cachePath, image, format, quality);
+    if (!pCompressed) {
+        pCompressed = compressImage(image, format, quality);
+        saveCompressedImage(cachePath, image, quality, *pCompressed);
+    }
+    return pCompressed;
+}
+
+}
@@ -6,7 +6,7 @@
 
 namespace glimac {
 
-void Cone::build(GLfloat height, GLfloat r, GLsizei discLat, GLsizei discHeight) {
+IndexedShape Cone::buildIndexed(GLfloat height, GLfloat r, GLsizei discLat, GLsizei discHeight) {
     // Equation paramétrique en (r, phi, h) du cone
     // avec r >= 0, -PI / 2 <= theta <= PI / 2, 0 <= h <= height
     //
@@ -22,61 +22,38 @@ void Cone::build(GLfloat height, GLfloat r, GLsizei discLat, GLsizei discHeight)
     // z(r, i, j) = r * (height - j * dH) * cos(i * dPhi) / height
 
     GLfloat rcpLat = 1.f / discLat, rcpH = 1.f / discHeight;
-    GLfloat dPhi = 2 * glm::pi<float>() * rcpLat, dH = height * rcpH;
-    
-    std::vector<ShapeVertex> data;
-    
-    // Construit l'ensemble des vertex
+    GLfloat dH = height * rcpH;
+
+    // sin(phi) et cos(phi) ne dépendent que de la colonne: calculés une seule fois pour toutes les bandes
+    std::vector<GLfloat> sinPhi(discLat + 1), cosPhi(discLat + 1);
+    computeSinCosTable(discLat, sinPhi.data(), cosPhi.data());
+
+    /* la normale (x, r * r * (1 - y / height) / height, z) est mal définie au sommet (= (0, 0, 0)):
+    on utilise normalize(sin(phi), r / height, cos(phi)), la même pour toute la génératrice */
+    GLfloat normalScale = 1.f / std::sqrt(1.f + (r / height) * (r / height));
+    GLfloat normalY = r / height * normalScale;
+
+    // Construit l'ensemble des vertex, bande par bande, directement dans le tableau alloué.
+    // La couture est dupliquée (i = discLat) pour que texCoords.x aille jusqu'à 1 au lieu de
+    // repasser à 0, avec la position et la normale de i = 0 (la table reprend phi = 0)
+    std::vector<ShapeVertex> data((discLat + 1) * (discHeight + 1));
     for(GLsizei j = 0; j <= discHeight; ++j) {
-        for(GLsizei i = 0; i < discLat; ++i) {
-            ShapeVertex vertex;
-            
-            vertex.texCoords.x = i * rcpLat;
-            vertex.texCoords.y = j * rcpH;
-            
-            vertex.position.x = r * (height - j * dH) * sin(i * dPhi) / height;
-            vertex.position.y = j * dH;
-            vertex.position.z = r * (height - j * dH) * cos(i * dPhi) / height;
-            
-            /* avec cette formule la normale est mal définie au sommet (= (0, 0, 0))
-            vertex.normal.x = vertex.position.x;
-            vertex.normal.y = r * r * (1 - vertex.position.y / height) / height;
-            vertex.normal.z = vertex.position.z;
-            vertex.normal = glm::normalize(vertex.normal);
-            */
-            
-            vertex.normal.x = sin(i * dPhi);
-            vertex.normal.y = r / height;
-            vertex.normal.z = cos(i * dPhi);
-            vertex.normal = glm::normalize(vertex.normal);
-            
-            data.push_back(vertex);
-        }
+        buildRing(&data[j * (discLat + 1)], sinPhi.data(), cosPhi.data(), discLat + 1, rcpLat,
+                  r * (height - j * dH) / height, j * dH, normalScale, normalY, j * rcpH);
     }
 
-    m_nVertexCount = discLat * discHeight * 6;
-    
-    GLuint idx = 0;
-    // Construit les vertex finaux en regroupant les données en triangles:
-    // Pour une longitude donnée, les deux triangles formant une face sont de la forme:
-    // (i, i + 1, i + discLat + 1), (i, i + discLat + 1, i + discLat)
-    // avec i sur la bande correspondant à la longitude
-    for(GLsizei j = 0; j < discHeight; ++j) {
-        GLsizei offset = j * discLat;
-        for(GLsizei i = 0; i < discLat; ++i) {
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + (i + 1) % discLat]);
-            m_Vertices.push_back(data[offset + discLat + (i + 1) % discLat]);
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + discLat + (i + 1) % discLat]);
-            m_Vertices.push_back(data[offset + i + discLat]);
-        }
-    }
-    
-    // Attention ! dans cette implantation on duplique beaucoup de sommets. Une meilleur stratégie est de passer
-    // par un Index Buffer Object, que nous verrons dans les prochains TDs
+    // Regroupe les vertex en triangles:
+    // Pour une hauteur donnée, les deux triangles formant une face sont de la forme:
+    // (i, i + 1, i + discLat + 2), (i, i + discLat + 2, i + discLat + 1)
+    // avec i sur la bande correspondant à la hauteur
+    return IndexedShape::makeGrid(std::move(data), discLat, discHeight);
 }
 
+void Cone::build(GLfloat height, GLfloat r, GLsizei discLat, GLsizei discHeight) {
+    // Chaque sommet est dupliqué pour chacun des triangles qui l'utilisent (environ 6 fois):
+    // buildIndexed() donne les sommets partagés et un Index Buffer Object
+    m_Vertices = buildIndexed(height, r, discLat, discHeight).expand();
+    m_nVertexCount = m_Vertices.size();
 }
 
-
+}
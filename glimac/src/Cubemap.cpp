@@ -0,0 +1,101 @@
+#include "glimac/Cubemap.hpp"
+#include "glimac/MipChain.hpp"
+#include "glimac/TextureContainer.hpp"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace glimac {
+
+bool loadCubemapFaces(const CubemapPaths& filepaths, CubemapFaces& faces) {
+    std::array<std::shared_future<ImageHandle>, 6> futures;
+    for (auto face = 0u; face < 6; ++face) {
+        futures[face] = ImageManager::acquireImageAsync(filepaths[face]);
+    }
+    // The calling thread decodes the faces not started yet, the last queued first. Finished loads
+    // are read from their future: a failed one would be tried again by acquireImage().
+    CubemapFaces loaded;
+    for (auto face = 6u; face-- > 0;) {
+        auto ready = futures[face].wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        loaded[face] = ready ? futures[face].get() : ImageManager::acquireImage(filepaths[face]);
+    }
+
+    for (auto face = 0u; face < 6; ++face) {
+        if (!loaded[face]) {
+            std::cerr << "Cubemap face " << filepaths[face] << " can't be loaded" << std::endl;
+            return false;
+        }
+        if (loaded[face]->getWidth() != loaded[face]->getHeight()) {
+            std::cerr << "Cubemap face " << filepaths[face] << " is not square" << std::endl;
+            return false;
+        }
+        if (loaded[face]->getWidth() != loaded[0]->getWidth() || loaded[face]->getFormat() != loaded[0]->getFormat()) {
+            std::cerr << "Cubemap face " << filepaths[face] << " does not have the size or the format of "
+                      << filepaths[0] << std::endl;
+            return false;
+        }
+    }
+
+    faces = std::move(loaded);
+    return true;
+}
+
+unsigned int uploadCubemap(const CubemapFaces& faces, bool generateMipmaps) {
+    auto size = faces[0]->getWidth();
+    auto format = faces[0]->getFormat();
+
+    // Levels common to the containers of the faces, 0 if a face does not come from a container
+    auto containerLevelCount = ~0u;
+    for (const auto& pFace: faces) {
+        auto pContainer = pFace->getContainer();
+        containerLevelCount = pContainer ? std::min(containerLevelCount, pContainer->getLevelCount()) : 0u;
+    }
+    auto levelCount = containerLevelCount ? containerLevelCount : generateMipmaps ? getMipLevelCount(size, size) : 1u;
+
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, levelCount, getGLInternalFormat(format), size, size);
+
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (auto face = 0u; face < 6; ++face) {
+        auto target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+        if (containerLevelCount) {
+            auto pContainer = faces[face]->getContainer();
+            for (auto level = 0u; level < containerLevelCount; ++level) {
+                glTexSubImage2D(target, level, 0, 0, pContainer->getWidth(level), pContainer->getHeight(level),
+                                getGLFormat(format), getGLType(format),
+                                pContainer->getData(level, faces[face]->getContainerFace()));
+            }
+        } else {
+            glTexSubImage2D(target, 0, 0, 0, size, size, getGLFormat(format), getGLType(format), faces[face]->getData());
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    if (!containerLevelCount && levelCount > 1) {
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    }
+    return levelCount;
+}
+
+GLuint loadCubemap(const CubemapPaths& filepaths, bool generateMipmaps) {
+    CubemapFaces faces;
+    if (!loadCubemapFaces(filepaths, faces)) {
+        return 0;
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    auto levelCount = uploadCubemap(faces, generateMipmaps);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return texture;
+}
+
+}
@@ -0,0 +1,89 @@
+#include "glimac/DrawList.hpp"
+#include <algorithm>
+
+namespace glimac {
+
+namespace {
+
+// Total number of state changes (each program, texture set, VAO or material bind counts for one)
+unsigned int countStateChanges(const std::vector<DrawCommand>& commands) {
+    auto count = 0u;
+    for (auto i = 1u; i < commands.size(); ++i) {
+        auto changes = DrawList::stateChanges(commands[i - 1], commands[i]);
+        count += ((changes & DrawList::PROGRAM_CHANGED) != 0u) + ((changes & DrawList::TEXTURES_CHANGED) != 0u)
+            + ((changes & DrawList::VERTEX_ARRAY_CHANGED) != 0u) + ((changes & DrawList::MATERIAL_CHANGED) != 0u);
+    }
+    return count;
+}
+
+}
+
+void DrawList::add(uint64_t stateKey, unsigned int vertexArray, unsigned int indexOffset, unsigned int indexCount) {
+    if (indexCount) {
+        m_Commands.push_back({ stateKey, vertexArray, indexOffset, indexCount });
+    }
+}
+
+void DrawList::add(const Geometry& geometry, unsigned int program, unsigned int vertexArray) {
+    auto meshes = geometry.getMeshBuffer();
+    for (auto i = 0u; i < geometry.getMeshCount(); ++i) {
+        const auto& mesh = meshes[i];
+
+        auto textureSet = 0u;
+        if (mesh.m_nMaterialIndex >= 0) {
+            const auto& material = geometry.getMaterial(mesh.m_nMaterialIndex);
+            std::array<const Image*, 4> maps = {{ material.m_pKaMap, material.m_pKdMap, material.m_pKsMap, material.m_pNormalMap }};
+            if (maps[0] || maps[1] || maps[2] || maps[3]) {
+                // 0 is the set without textures
+                auto it = m_TextureSets.insert(std::make_pair(maps, unsigned(m_TextureSets.size() + 1))).first;
+                textureSet = it->second;
+            }
+        }
+
+        add(makeStateKey(program, textureSet, mesh.m_nMaterialIndex), vertexArray, mesh.m_nIndexOffset, mesh.m_nIndexCount);
+    }
+}
+
+void DrawList::sort() {
+    auto submittedChanges = countStateChanges(m_Commands);
+
+    // Program and texture set, then VAO, then material
+    std::stable_sort(begin(m_Commands), end(m_Commands), [](const DrawCommand& lhs, const DrawCommand& rhs) {
+        auto lhsTextures = lhs.m_nStateKey >> 24, rhsTextures = rhs.m_nStateKey >> 24;
+        if (lhsTextures != rhsTextures) {
+            return lhsTextures < rhsTextures;
+        }
+        if (lhs.m_nVertexArray != rhs.m_nVertexArray) {
+            return lhs.m_nVertexArray < rhs.m_nVertexArray;
+        }
+        return lhs.m_nStateKey < rhs.m_nStateKey;
+    });
+
+    // Same state, same index buffer and adjacent ranges: one draw call (ranges of a material are contiguous
+    // after Geometry::sortMeshesByMaterial())
+    auto count = 0u;
+    for (auto i = 0u; i < m_Commands.size(); ++i) {
+        if (count > 0u) {
+            auto& last = m_Commands[count - 1];
+            if (last.m_nStateKey == m_Commands[i].m_nStateKey && last.m_nVertexArray == m_Commands[i].m_nVertexArray
+                    && last.m_nIndexOffset + last.m_nIndexCount == m_Commands[i].m_nIndexOffset) {
+                last.m_nIndexCount += m_Commands[i].m_nIndexCount;
+                continue;
+            }
+        }
+        m_Commands[count++] = m_Commands[i];
+    }
+    m_Commands.resize(count);
+
+    m_Statistics = { count, 0u, 0u, 0u, 0u, 0u };
+    execute([&](const DrawCommand&, unsigned int changes) {
+        m_Statistics.m_nProgramChanges += (changes & PROGRAM_CHANGED) != 0u;
+        m_Statistics.m_nTextureChanges += (changes & TEXTURES_CHANGED) != 0u;
+        m_Statistics.m_nVertexArrayChanges += (changes & VERTEX_ARRAY_CHANGED) != 0u;
+        m_Statistics.m_nMaterialChanges += (changes & MATERIAL_CHANGED) != 0u;
+    });
+    auto sortedChanges = countStateChanges(m_Commands);
+    m_Statistics.m_nSavedStateChanges = submittedChanges > sortedChanges ? submittedChanges - sortedChanges : 0u;
+}
+
+}
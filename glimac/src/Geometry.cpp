@@ -1,33 +1,574 @@
 #include "glimac/Geometry.hpp"
+#include "glimac/MeshOptimizer.hpp"
+#include "glimac/MeshSimplifier.hpp"
+#include "glimac/Parallel.hpp"
+#include "glimac/TextureAtlas.hpp"
 #include "tiny_obj_loader.h"
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <cstdint>
+#include <cstddef>
 
 namespace glimac {
 
-void Geometry::generateNormals(unsigned int meshIndex) {
-    auto indexOffset = m_MeshBuffer[meshIndex].m_nIndexOffset;
-    for (auto j = 0u; j < m_MeshBuffer[meshIndex].m_nIndexCount; j += 3) {
-        auto i1 = m_IndexBuffer[indexOffset + j];
-        auto i2 = m_IndexBuffer[indexOffset + j + 1];
-        auto i3 = m_IndexBuffer[indexOffset + j + 2];
+namespace {
 
-        auto n = glm::cross(glm::normalize(m_VertexBuffer[i2].m_Position - m_VertexBuffer[i1].m_Position),
-                            glm::normalize(m_VertexBuffer[i3].m_Position - m_VertexBuffer[i1].m_Position));
+// Maps the indices of a mesh to [0, slots.size()): slots[i] is the global index of the local vertex i
+void localizeIndices(const unsigned int* pIndex, size_t indexCount,
+                     std::vector<unsigned int>& slots, std::vector<unsigned int>& indices) {
+    slots.assign(pIndex, pIndex + indexCount);
+    std::sort(begin(slots), end(slots));
+    slots.erase(std::unique(begin(slots), end(slots)), end(slots));
 
-        m_VertexBuffer[i1].m_Normal = n;
-        m_VertexBuffer[i2].m_Normal = n;
-        m_VertexBuffer[i3].m_Normal = n;
+    indices.resize(indexCount);
+    for (auto i = 0u; i < indexCount; ++i) {
+        indices[i] = std::lower_bound(begin(slots), end(slots), pIndex[i]) - begin(slots);
     }
 }
 
-bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bool loadTextures) {
+// Compressed adjacency lists: items[offsets[k]..offsets[k + 1]) are the i such that keys[i] == k, in increasing order
+void buildAdjacency(const unsigned int* keys, size_t count, size_t keyCount,
+                    std::vector<unsigned int>& offsets, std::vector<unsigned int>& items) {
+    offsets.assign(keyCount + 1, 0u);
+    for (auto i = 0u; i < count; ++i) {
+        ++offsets[keys[i] + 1];
+    }
+    for (auto k = 0u; k < keyCount; ++k) {
+        offsets[k + 1] += offsets[k];
+    }
+    items.resize(count);
+    std::vector<unsigned int> fill(begin(offsets), end(offsets) - 1);
+    for (auto i = 0u; i < count; ++i) {
+        items[fill[keys[i]]++] = i;
+    }
+}
+
+}
+
+void Geometry::generateNormals(unsigned int meshIndex, NormalWeighting weighting, float creaseAngle) {
+    editVertexBuffer();
+    const auto& mesh = m_MeshBuffer[meshIndex];
+    auto pIndex = m_IndexBuffer.data() + mesh.m_nIndexOffset;
+    auto indexCount = mesh.m_nIndexCount - mesh.m_nIndexCount % 3;
+    auto triangleCount = indexCount / 3;
+    if (triangleCount == 0u) {
+        return;
+    }
+
+    std::vector<unsigned int> slots, indices;
+    localizeIndices(pIndex, indexCount, slots, indices);
+    auto vertexCount = slots.size();
+
+    // Vertices sharing a position are smoothed together, so texture seams don't show
+    std::vector<unsigned int> sortedVertices(vertexCount);
+    for (auto i = 0u; i < vertexCount; ++i) {
+        sortedVertices[i] = i;
+    }
+    auto position = [&](unsigned int v) -> const glm::vec3& {
+        return m_VertexBuffer[slots[v]].m_Position;
+    };
+    std::sort(begin(sortedVertices), end(sortedVertices), [&](unsigned int a, unsigned int b) {
+        const auto& pa = position(a);
+        const auto& pb = position(b);
+        return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+    });
+    std::vector<unsigned int> positionGroup(vertexCount);
+    auto groupCount = 0u;
+    for (auto i = 0u; i < vertexCount; ++i) {
+        if (i > 0 && position(sortedVertices[i]) != position(sortedVertices[i - 1])) {
+            ++groupCount;
+        }
+        positionGroup[sortedVertices[i]] = groupCount;
+    }
+    ++groupCount;
+
+    // Unit face normals and weighted corner contributions, one writer per triangle
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    std::vector<glm::vec3> cornerNormals(indexCount);
+    parallelFor(triangleCount, [&](size_t begin, size_t end) {
+        for (auto t = begin; t < end; ++t) {
+            glm::vec3 p[3] = { position(indices[3 * t]), position(indices[3 * t + 1]), position(indices[3 * t + 2]) };
+            auto n = glm::cross(p[1] - p[0], p[2] - p[0]);
+            auto length = glm::length(n);
+            faceNormals[t] = length > 0.f ? n / length : glm::vec3(0.f);
+
+            for (auto k = 0u; k < 3; ++k) {
+                if (weighting == NormalWeighting::Area) {
+                    cornerNormals[3 * t + k] = n; // |n| is twice the area
+                } else {
+                    auto e1 = p[(k + 1) % 3] - p[k];
+                    auto e2 = p[(k + 2) % 3] - p[k];
+                    auto l = glm::length(e1) * glm::length(e2);
+                    auto angle = l > 0.f ? std::acos(glm::clamp(glm::dot(e1, e2) / l, -1.f, 1.f)) : 0.f;
+                    cornerNormals[3 * t + k] = angle * faceNormals[t];
+                }
+            }
+        }
+    });
+
+    // Position group -> corners
+    std::vector<unsigned int> cornerGroups(indexCount);
+    for (auto c = 0u; c < indexCount; ++c) {
+        cornerGroups[c] = positionGroup[indices[c]];
+    }
+    std::vector<unsigned int> groupOffsets, groupCorners;
+    buildAdjacency(cornerGroups.data(), indexCount, groupCount, groupOffsets, groupCorners);
+
+    // Each corner gathers the contributions of the corners at the same position whose face
+    // is within the crease angle of its own (no scattered writes)
+    auto smoothAll = creaseAngle >= glm::pi<float>();
+    auto cosCrease = std::cos(creaseAngle);
+    std::vector<glm::vec3> normals(indexCount);
+    parallelFor(indexCount, [&](size_t begin, size_t end) {
+        for (auto c = begin; c < end; ++c) {
+            auto g = cornerGroups[c];
+            const auto& faceNormal = faceNormals[c / 3];
+            glm::vec3 sum(0.f);
+            for (auto i = groupOffsets[g]; i < groupOffsets[g + 1]; ++i) {
+                auto other = groupCorners[i];
+                if (smoothAll || glm::dot(faceNormal, faceNormals[other / 3]) >= cosCrease) {
+                    sum += cornerNormals[other];
+                }
+            }
+            auto length = glm::length(sum);
+            if (length > 0.f) {
+                normals[c] = sum / length;
+            } else {
+                normals[c] = faceNormal != glm::vec3(0.f) ? faceNormal : glm::vec3(0.f, 0.f, 1.f);
+            }
+        }
+    });
+
+    // Write back. Corners of a vertex which ended with different normals (creases) get copies of it.
+    std::vector<unsigned int> vertexOffsets, vertexCorners;
+    buildAdjacency(indices.data(), indexCount, vertexCount, vertexOffsets, vertexCorners);
+
+    std::vector<std::pair<glm::vec3, unsigned int>> splits;
+    for (auto v = 0u; v < vertexCount; ++v) {
+        splits.clear();
+        for (auto i = vertexOffsets[v]; i < vertexOffsets[v + 1]; ++i) {
+            auto c = vertexCorners[i];
+            auto it = std::find_if(begin(splits), end(splits), [&](const std::pair<glm::vec3, unsigned int>& split) {
+                return split.first == normals[c];
+            });
+            if (it != end(splits)) {
+                pIndex[c] = it->second;
+                continue;
+            }
+
+            auto globalIndex = slots[v];
+            if (splits.empty()) {
+                m_VertexBuffer[globalIndex].m_Normal = normals[c];
+            } else {
+                auto vertex = m_VertexBuffer[globalIndex];
+                vertex.m_Normal = normals[c];
+                globalIndex = m_VertexBuffer.size();
+                m_VertexBuffer.push_back(vertex);
+            }
+            splits.emplace_back(normals[c], globalIndex);
+            pIndex[c] = globalIndex;
+        }
+    }
+}
+
+void Geometry::optimizeMesh(unsigned int meshIndex) {
+    editVertexBuffer();
+    const auto& mesh = m_MeshBuffer[meshIndex];
+    auto pIndex = m_IndexBuffer.data() + mesh.m_nIndexOffset;
+    auto indexCount = mesh.m_nIndexCount - mesh.m_nIndexCount % 3;
+    if (indexCount == 0u) {
+        return;
+    }
+
+    // Work on local indices: slots[i] is the global index of the local vertex i
+    std::vector<unsigned int> slots, indices;
+    localizeIndices(pIndex, indexCount, slots, indices);
+
+    std::vector<glm::vec3> positions(slots.size());
+    for (auto i = 0u; i < slots.size(); ++i) {
+        positions[i] = m_VertexBuffer[slots[i]].m_Position;
+    }
+
+    auto before = analyzeVertexCache(indices.data(), indexCount, slots.size());
+
+    optimizeVertexCache(indices.data(), indexCount, slots.size());
+    optimizeOverdraw(indices.data(), indexCount, positions.data(), slots.size());
+
+    // Vertices are moved into the same slots, in order of first use
+    std::vector<unsigned int> remap(slots.size());
+    optimizeVertexFetchRemap(remap.data(), indices.data(), indexCount, slots.size());
+
+    std::vector<Vertex> vertices(slots.size());
+    for (auto i = 0u; i < slots.size(); ++i) {
+        vertices[remap[i]] = m_VertexBuffer[slots[i]];
+    }
+    for (auto i = 0u; i < slots.size(); ++i) {
+        m_VertexBuffer[slots[i]] = vertices[i];
+    }
+    for (auto i = 0u; i < indexCount; ++i) {
+        indices[i] = remap[indices[i]];
+        pIndex[i] = slots[indices[i]];
+    }
+
+    auto after = analyzeVertexCache(indices.data(), indexCount, slots.size());
+
+    std::clog << "Optimize mesh " << mesh.m_sName << ": ACMR " << before.m_fACMR << " -> " << after.m_fACMR
+              << ", ATVR " << before.m_fATVR << " -> " << after.m_fATVR << std::endl;
+}
+
+void Geometry::sortMeshesByMaterial(unsigned int firstMesh) {
+    if (firstMesh + 1 >= m_MeshBuffer.size()) {
+        return;
+    }
+
+    auto first = begin(m_MeshBuffer) + firstMesh;
+    auto indexOffset = std::min_element(first, end(m_MeshBuffer), [](const Mesh& lhs, const Mesh& rhs) {
+        return lhs.m_nIndexOffset < rhs.m_nIndexOffset;
+    })->m_nIndexOffset;
+
+    auto materialChanges = 0u;
+    for (auto it = first + 1; it != end(m_MeshBuffer); ++it) {
+        materialChanges += (it - 1)->m_nMaterialIndex != it->m_nMaterialIndex;
+    }
+
+    // Meshes without material go last
+    std::stable_sort(first, end(m_MeshBuffer), [](const Mesh& lhs, const Mesh& rhs) {
+        return unsigned(lhs.m_nMaterialIndex) < unsigned(rhs.m_nMaterialIndex);
+    });
+
+    std::vector<unsigned int> indices;
+    for (auto it = first; it != end(m_MeshBuffer); ++it) {
+        auto& mesh = *it;
+        auto newOffset = indexOffset + unsigned(indices.size());
+        indices.insert(end(indices), begin(m_IndexBuffer) + mesh.m_nIndexOffset,
+                       begin(m_IndexBuffer) + mesh.m_nIndexOffset + mesh.m_nIndexCount);
+        for (auto i = mesh.m_nMeshletOffset; i < mesh.m_nMeshletOffset + mesh.m_nMeshletCount; ++i) {
+            m_Meshlets[i].m_nIndexOffset = m_Meshlets[i].m_nIndexOffset - mesh.m_nIndexOffset + newOffset;
+        }
+        mesh.m_nIndexOffset = newOffset;
+    }
+    std::copy(begin(indices), end(indices), begin(m_IndexBuffer) + indexOffset);
+
+    auto sortedMaterialChanges = 0u;
+    for (auto it = first + 1; it != end(m_MeshBuffer); ++it) {
+        sortedMaterialChanges += (it - 1)->m_nMaterialIndex != it->m_nMaterialIndex;
+    }
+    std::clog << "Sort meshes by material: " << materialChanges << " -> " << sortedMaterialChanges
+              << " material changes" << std::endl;
+}
+
+void Geometry::buildMeshlets(unsigned int meshIndex, unsigned int maxVertices, unsigned int maxTriangles) {
+    updateVertexBuffer();
+    auto& mesh = m_MeshBuffer[meshIndex];
+
+    // Meshlets of the other meshes keep their offsets: rebuilt meshlets go at the end
+    mesh.m_nMeshletOffset = m_Meshlets.size();
+    glimac::buildMeshlets(m_Meshlets, m_IndexBuffer.data() + mesh.m_nIndexOffset, mesh.m_nIndexCount, mesh.m_nIndexOffset,
+                          &m_VertexBuffer[0].m_Position, sizeof(Vertex), m_VertexBuffer.size(), maxVertices, maxTriangles);
+    mesh.m_nMeshletCount = m_Meshlets.size() - mesh.m_nMeshletOffset;
+}
+
+size_t Geometry::cullMeshlets(unsigned int meshIndex, const glm::mat4& mvpMatrix, const glm::vec3& cameraPosition,
+                              std::vector<unsigned int>& indices) const {
+    const auto& mesh = m_MeshBuffer[meshIndex];
+    auto first = m_IndexBuffer.begin();
+
+    if (!mesh.m_nMeshletCount) {
+        indices.insert(indices.end(), first + mesh.m_nIndexOffset, first + mesh.m_nIndexOffset + mesh.m_nIndexCount);
+        return mesh.m_nIndexCount / 3;
+    }
+
+    Frustum frustum(mvpMatrix);
+    auto size = indices.size();
+    for (auto i = mesh.m_nMeshletOffset; i < mesh.m_nMeshletOffset + mesh.m_nMeshletCount; ++i) {
+        const auto& meshlet = m_Meshlets[i];
+        if (isVisible(meshlet, frustum, cameraPosition)) {
+            indices.insert(indices.end(), first + meshlet.m_nIndexOffset, first + meshlet.m_nIndexOffset + meshlet.m_nIndexCount);
+        }
+    }
+    return (indices.size() - size) / 3;
+}
+
+Geometry::LodChain Geometry::computeLods(const std::vector<float>& ratios) const {
+    updateVertexBuffer();
+    std::vector<std::vector<unsigned int>> meshIndices(m_MeshBuffer.size());
+    std::vector<std::vector<Lod>> meshLods(m_MeshBuffer.size());
+
+    parallelFor(m_MeshBuffer.size(), [&](size_t begin, size_t end) {
+        for (auto m = begin; m < end; ++m) {
+            const auto& mesh = m_MeshBuffer[m];
+            auto indexCount = mesh.m_nIndexCount - mesh.m_nIndexCount % 3;
+            if (indexCount == 0u) {
+                continue;
+            }
+
+            std::vector<unsigned int> slots, indices;
+            localizeIndices(m_IndexBuffer.data() + mesh.m_nIndexOffset, indexCount, slots, indices);
+
+            std::vector<glm::vec3> positions(slots.size());
+            for (auto i = 0u; i < slots.size(); ++i) {
+                positions[i] = m_VertexBuffer[slots[i]].m_Position;
+            }
+
+            // Each level is simplified from the previous one, so errors add up
+            auto error = 0.f;
+            for (auto ratio: ratios) {
+                auto targetIndexCount = size_t(indexCount * ratio) / 3 * 3;
+                auto levelError = 0.f;
+                auto count = simplifyMesh(indices.data(), indices.data(), indices.size(), positions.data(), slots.size(),
+                                          targetIndexCount, levelError);
+                if (count == 0u || count == indices.size()) {
+                    break;
+                }
+                indices.resize(count);
+                error += levelError;
+                optimizeVertexCache(indices.data(), count, slots.size());
+
+                Lod lod = { unsigned(meshIndices[m].size()), unsigned(count), error };
+                meshLods[m].push_back(lod);
+                for (auto i: indices) {
+                    meshIndices[m].push_back(slots[i]);
+                }
+            }
+        }
+    }, 1);
+
+    LodChain chain;
+    for (auto m = 0u; m < m_MeshBuffer.size(); ++m) {
+        for (auto lod: meshLods[m]) {
+            lod.m_nIndexOffset += chain.m_Indices.size();
+            chain.m_Lods.push_back(lod);
+        }
+        chain.m_Indices.insert(end(chain.m_Indices), begin(meshIndices[m]), end(meshIndices[m]));
+        chain.m_LodCounts.push_back(meshLods[m].size());
+    }
+    return chain;
+}
+
+std::future<Geometry::LodChain> Geometry::computeLodsAsync(std::vector<float> ratios) const {
+    updateVertexBuffer(); // Not from the worker thread
+    return std::async(std::launch::async, [this, ratios]() {
+        return computeLods(ratios);
+    });
+}
+
+void Geometry::setLods(LodChain chain) {
+    m_Lods.clear();
+    m_LodIndexBuffer = std::move(chain.m_Indices);
+
+    for (auto m = 0u; m < m_MeshBuffer.size(); ++m) {
+        auto& mesh = m_MeshBuffer[m];
+        mesh.m_nLodOffset = m_Lods.size();
+        mesh.m_nLodCount = m < chain.m_LodCounts.size() ? chain.m_LodCounts[m] : 0u;
+        for (auto i = 0u; i < mesh.m_nLodCount; ++i) {
+            m_Lods.push_back(chain.m_Lods[mesh.m_nLodOffset + i]);
+        }
+    }
+
+    std::clog << "Set " << m_Lods.size() << " levels of detail (" << m_LodIndexBuffer.size() << " indices)" << std::endl;
+}
+
+namespace {
+
+const char LOD_FILE_MAGIC[4] = { 'G', 'L', 'O', 'D' };
+
+// FNV-1a
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (auto i = 0u; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashLodSource(const std::vector<Geometry::Vertex>& vertices, const std::vector<unsigned int>& indices,
+                       const std::vector<Geometry::Mesh>& meshes) {
+    auto hash = hashBytes(nullptr, 0);
+    for (const auto& vertex: vertices) {
+        hash = hashBytes(&vertex.m_Position, sizeof(vertex.m_Position), hash);
+    }
+    for (const auto& mesh: meshes) {
+        hash = hashBytes(indices.data() + mesh.m_nIndexOffset, mesh.m_nIndexCount * sizeof(unsigned int), hash);
+    }
+    return hash;
+}
+
+}
+
+bool Geometry::saveLods(const FilePath& filepath) const {
+    updateVertexBuffer();
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open " << filepath << " for writing" << std::endl;
+        return false;
+    }
+
+    uint64_t hash = hashLodSource(m_VertexBuffer, m_IndexBuffer, m_MeshBuffer);
+    uint32_t header[3] = { uint32_t(m_MeshBuffer.size()), uint32_t(m_Lods.size()), uint32_t(m_LodIndexBuffer.size()) };
+    file.write(LOD_FILE_MAGIC, sizeof(LOD_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (const auto& mesh: m_MeshBuffer) {
+        uint32_t count = mesh.m_nLodCount;
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+    file.write(reinterpret_cast<const char*>(m_Lods.data()), m_Lods.size() * sizeof(Lod));
+    file.write(reinterpret_cast<const char*>(m_LodIndexBuffer.data()), m_LodIndexBuffer.size() * sizeof(unsigned int));
+
+    return bool(file);
+}
+
+bool Geometry::loadLods(const FilePath& filepath) {
+    updateVertexBuffer();
+    std::ifstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    char magic[4];
+    uint64_t hash;
+    uint32_t header[3];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || !std::equal(magic, magic + 4, LOD_FILE_MAGIC) || header[0] != m_MeshBuffer.size()) {
+        std::cerr << filepath << " is not a LOD file of this geometry" << std::endl;
+        return false;
+    }
+    if (hash != hashLodSource(m_VertexBuffer, m_IndexBuffer, m_MeshBuffer)) {
+        std::clog << filepath << " is out of date" << std::endl;
+        return false;
+    }
+
+    // The hash only tells that the file was made for this geometry: its sizes are checked against the file
+    // before allocating, then its levels against the sizes and the vertex buffer
+    auto dataOffset = file.tellg();
+    file.seekg(0, std::ios::end);
+    auto dataSize = uint64_t(file.tellg() - dataOffset);
+    file.seekg(dataOffset);
+    if (dataSize != header[0] * uint64_t(sizeof(uint32_t)) + header[1] * uint64_t(sizeof(Lod))
+            + header[2] * uint64_t(sizeof(unsigned int))) {
+        std::cerr << filepath << " is truncated" << std::endl;
+        return false;
+    }
+
+    LodChain chain;
+    chain.m_LodCounts.resize(header[0]);
+    chain.m_Lods.resize(header[1]);
+    chain.m_Indices.resize(header[2]);
+    file.read(reinterpret_cast<char*>(chain.m_LodCounts.data()), chain.m_LodCounts.size() * sizeof(uint32_t));
+    file.read(reinterpret_cast<char*>(chain.m_Lods.data()), chain.m_Lods.size() * sizeof(Lod));
+    file.read(reinterpret_cast<char*>(chain.m_Indices.data()), chain.m_Indices.size() * sizeof(unsigned int));
+    if (!file) {
+        std::cerr << filepath << " is truncated" << std::endl;
+        return false;
+    }
+
+    uint64_t lodCount = 0u;
+    for (auto count: chain.m_LodCounts) {
+        lodCount += count;
+    }
+    auto isValid = lodCount == header[1];
+    for (const auto& lod: chain.m_Lods) {
+        isValid = isValid && uint64_t(lod.m_nIndexOffset) + lod.m_nIndexCount <= header[2];
+    }
+    for (auto index: chain.m_Indices) {
+        isValid = isValid && index < m_VertexBuffer.size();
+    }
+    if (!isValid) {
+        std::cerr << filepath << " is corrupted" << std::endl;
+        return false;
+    }
+
+    setLods(std::move(chain));
+    return true;
+}
+
+unsigned int Geometry::selectLod(unsigned int meshIndex, const glm::mat4& projMatrix, const glm::mat4& mvMatrix,
+                                 float viewportHeight, float maxPixelError) const {
+    const auto& mesh = m_MeshBuffer[meshIndex];
+    if (!mesh.m_nLodCount) {
+        return 0u;
+    }
+
+    glm::vec3 center;
+    float radius;
+    boundingSphere(m_BBox, center, radius);
+
+    auto scale = std::max(glm::length(glm::vec3(mvMatrix[0])), std::max(glm::length(glm::vec3(mvMatrix[1])), glm::length(glm::vec3(mvMatrix[2]))));
+    auto viewCenter = glm::vec3(mvMatrix * glm::vec4(center, 1.f));
+    auto distance = -viewCenter.z - radius * scale;
+    if (distance <= 0.f) {
+        return 0u; // Camera inside the bounding sphere
+    }
+
+    // Pixels covered by one object unit at this distance (perspective projection)
+    auto pixelsPerUnit = projMatrix[1][1] * 0.5f * viewportHeight * scale / distance;
+
+    auto level = 0u;
+    while (level < mesh.m_nLodCount && m_Lods[mesh.m_nLodOffset + level].m_fError * pixelsPerUnit <= maxPixelError) {
+        ++level;
+    }
+    return level;
+}
+
+void Geometry::updateVertexBuffer() const {
+    if (!m_bVertexBufferValid) {
+        m_VertexStreams.scatter(m_VertexBuffer.data(), sizeof(Vertex), offsetof(Vertex, m_Position), offsetof(Vertex, m_Normal));
+        m_bVertexBufferValid = true;
+    }
+}
+
+void Geometry::updateVertexStreams() const {
+    if (!m_bVertexStreamsValid) {
+        m_VertexStreams.gather(m_VertexBuffer.data(), sizeof(Vertex), offsetof(Vertex, m_Position), offsetof(Vertex, m_Normal),
+                               m_VertexBuffer.size());
+        m_bVertexStreamsValid = true;
+    }
+}
+
+void Geometry::updateBoundingBox() {
+    if (m_VertexBuffer.empty()) {
+        return;
+    }
+    if (m_bVertexStreamsValid) {
+        m_BBox = computeBounds(m_VertexStreams);
+    } else {
+        m_BBox = computeBounds(&m_VertexBuffer[0].m_Position, sizeof(Vertex), m_VertexBuffer.size());
+    }
+}
+
+std::vector<PackedVertex> Geometry::getPackedVertexBuffer() const {
+    updateVertexBuffer();
+    std::vector<PackedVertex> vertices(m_VertexBuffer.size());
+    for (auto i = 0u; i < m_VertexBuffer.size(); ++i) {
+        const auto& v = m_VertexBuffer[i];
+        vertices[i] = packVertex(v.m_Position, v.m_Normal, v.m_TexCoords, m_BBox);
+    }
+    return vertices;
+}
+
+std::vector<CompactVertex> Geometry::getCompactVertexBuffer() const {
+    updateVertexBuffer();
+    std::vector<CompactVertex> vertices(m_VertexBuffer.size());
+    for (auto i = 0u; i < m_VertexBuffer.size(); ++i) {
+        const auto& v = m_VertexBuffer[i];
+        vertices[i] = packCompactVertex(v.m_Position, v.m_Normal, v.m_TexCoords, m_BBox);
+    }
+    return vertices;
+}
+
+bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bool loadTextures, float creaseAngle) {
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
 
     std::clog << "Load OBJ " << filepath << std::endl;
+    // FilePath drops the trailing separator that tinyobj expects in front of the MTL file name
+    std::string mtlDirectory = mtlBasePath.empty() ? std::string() : mtlBasePath.str() + FilePath::PATH_SEPARATOR;
     std::string objErr = tinyobj::LoadObj(shapes, materials,
-        filepath.c_str(), mtlBasePath.c_str());
+        filepath.c_str(), mtlDirectory.c_str());
 
     std::clog << "done." << std::endl;
 
@@ -36,6 +577,21 @@ bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bo
         return false;
     }
 
+    // Textures are decoded on the thread pool while the vertices are processed, each file once
+    struct TextureRequest {
+        size_t m_nMaterialIndex;
+        const Image* Material::* m_pMap;
+        std::shared_future<ImageHandle> m_Image;
+    };
+    std::vector<TextureRequest> textureRequests;
+
+    auto requestTexture = [&](size_t materialIndex, const Image* Material::* pMap, const std::string& textureName) {
+        if(textureName.empty()) {
+            return;
+        }
+        textureRequests.push_back({ materialIndex, pMap, ImageManager::acquireImageAsync(mtlBasePath + textureName) });
+    };
+
     std::clog << "Load materials" << std::endl;
     m_Materials.reserve(m_Materials.size() + materials.size());
     for(auto& material: materials) {
@@ -52,44 +608,23 @@ bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bo
         m.m_Dissolve = material.dissolve;
 
         if(loadTextures) {
-            if(!material.ambient_texname.empty()) {
-                //std::replace(material.ambient_texname.begin(), material.ambient_texname.end(), '\\', '/');
-                FilePath texturePath = mtlBasePath + material.ambient_texname;
-                std::clog << "load " << texturePath << std::endl;
-                m.m_pKaMap = ImageManager::loadImage(texturePath);
-            }
-
-            if(!material.diffuse_texname.empty()) {
-                //std::replace(material.diffuse_texname.begin(), material.diffuse_texname.end(), '\\', '/');
-                FilePath texturePath = mtlBasePath + material.diffuse_texname;
-                std::clog << "load " << texturePath << std::endl;
-                m.m_pKdMap = ImageManager::loadImage(texturePath);
-            }
-
-            if(!material.specular_texname.empty()) {
-                //std::replace(material.specular_texname.begin(), material.specular_texname.end(), '\\', '/');
-                FilePath texturePath = mtlBasePath + material.specular_texname;
-                std::clog << "load " << texturePath << std::endl;
-                m.m_pKsMap = ImageManager::loadImage(texturePath);
-            }
-
-            if(!material.normal_texname.empty()) {
-                //std::replace(material.normal_texname.begin(), material.normal_texname.end(), '\\', '/');
-                FilePath texturePath = mtlBasePath + material.normal_texname;
-                std::clog << "load " << texturePath << std::endl;
-                m.m_pNormalMap = ImageManager::loadImage(texturePath);
-            }
+            auto materialIndex = m_Materials.size() - 1;
+            requestTexture(materialIndex, &Material::m_pKaMap, material.ambient_texname);
+            requestTexture(materialIndex, &Material::m_pKdMap, material.diffuse_texname);
+            requestTexture(materialIndex, &Material::m_pKsMap, material.specular_texname);
+            requestTexture(materialIndex, &Material::m_pNormalMap, material.normal_texname);
         }
     }
     std::clog << "done." << std::endl;
 
+    editVertexBuffer();
     auto globalVertexOffset = m_VertexBuffer.size();
     auto globalIndexOffset = m_IndexBuffer.size();
 
     auto nbVertex = 0u;
     auto nbIndex = 0u;
     for (const auto& shape: shapes) {
-        nbVertex += shape.mesh.positions.size();
+        nbVertex += shape.mesh.positions.size() / 3;
         nbIndex += shape.mesh.indices.size();
     }
 
@@ -97,7 +632,10 @@ bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bo
     std::clog << "Number of vertices: " << nbVertex << std::endl;
     std::clog << "Number of triangles: " << (nbIndex) / 3 << std::endl;
 
-    m_BBox = BBox3f(glm::vec3(shapes[0].mesh.positions[0], shapes[0].mesh.positions[1], shapes[0].mesh.positions[2]));
+    // The box grows over the vertices already loaded: packed positions are quantized against all of them
+    if (globalVertexOffset == 0u) {
+        m_BBox = BBox3f(glm::vec3(shapes[0].mesh.positions[0], shapes[0].mesh.positions[1], shapes[0].mesh.positions[2]));
+    }
 
     m_VertexBuffer.resize(m_VertexBuffer.size() + nbVertex);
     m_IndexBuffer.resize(m_IndexBuffer.size() + nbIndex);
@@ -115,11 +653,9 @@ bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bo
             pVertexTmp->m_Position.x = shapes[i].mesh.positions[j];
             pVertexTmp->m_Position.y = shapes[i].mesh.positions[j + 1];
             pVertexTmp->m_Position.z = shapes[i].mesh.positions[j + 2];
-
-            m_BBox.grow(pVertexTmp->m_Position);
-
             ++pVertexTmp;
         }
+        m_BBox.grow(computeBounds(&pVertex->m_Position, sizeof(Vertex), shapes[i].mesh.positions.size() / 3));
         pVertexTmp = pVertex;
         if(shapes[i].mesh.normals.size()) {
             for (auto j = 0u; j < shapes[i].mesh.normals.size(); j += 3) {
@@ -157,16 +693,87 @@ bool Geometry::loadOBJ(const FilePath& filepath, const FilePath& mtlBasePath, bo
 
         m_MeshBuffer.emplace_back(shapes[i].name, indexOffset, shapes[i].mesh.indices.size(), materialIndex);
 
+        pVertex += shapes[i].mesh.positions.size() / 3;
+        vertexOffset += shapes[i].mesh.positions.size() / 3;
+        pIndex += shapes[i].mesh.indices.size();
+        indexOffset += shapes[i].mesh.indices.size();
+    }
+
+    // Once every vertex is copied: generateNormals() may append vertices
+    auto firstMesh = m_MeshBuffer.size() - shapes.size();
+    for (size_t i = 0; i < shapes.size(); i++) {
         if(shapes[i].mesh.normals.size() == 0u) {
-            generateNormals(m_MeshBuffer.size() - 1);
+            generateNormals(firstMesh + i, NormalWeighting::Angle, creaseAngle);
         }
+        optimizeMesh(firstMesh + i);
+        buildMeshlets(firstMesh + i);
+    }
+    sortMeshesByMaterial(firstMesh);
 
-        pVertex += shapes[i].mesh.positions.size();
-        vertexOffset += shapes[i].mesh.positions.size();
-        pIndex += shapes[i].mesh.indices.size();
-        indexOffset += shapes[i].mesh.indices.size();
+    if(!textureRequests.empty()) {
+        std::clog << "Wait for " << textureRequests.size() << " textures" << std::endl;
+        for(const auto& request: textureRequests) {
+            const auto& pImage = request.m_Image.get();
+            m_Materials[request.m_nMaterialIndex].*request.m_pMap = pImage.get();
+            if(pImage) {
+                m_Textures.push_back(pImage);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Geometry::packDiffuseMaps(TextureAtlas& atlas, unsigned int maxPageSize) {
+    // Distinct maps, in order of first use
+    std::vector<const Image*> images;
+    std::vector<int> materialImages(m_Materials.size(), -1);
+    for (auto m = 0u; m < m_Materials.size(); ++m) {
+        auto pMap = m_Materials[m].m_pKdMap;
+        if (pMap) {
+            auto it = std::find(images.begin(), images.end(), pMap);
+            materialImages[m] = int(it - images.begin());
+            if (it == images.end()) {
+                images.push_back(pMap);
+            }
+        }
+    }
+    if (!atlas.build(images, maxPageSize)) {
+        return false;
+    }
+    for (auto m = 0u; m < m_Materials.size(); ++m) {
+        m_Materials[m].m_nKdLayer = materialImages[m] < 0 ? -1 : int(atlas.getRegion(materialImages[m]).m_nLayer);
+    }
+    if (!atlas.isPacked()) {
+        return true;
     }
 
+    // Vertices are not shared between meshes, LODs index the vertices of their mesh
+    auto& vertices = editVertexBuffer();
+    std::vector<bool> remapped(vertices.size(), false);
+    for (const auto& mesh: m_MeshBuffer) {
+        if (mesh.m_nMaterialIndex < 0 || materialImages[mesh.m_nMaterialIndex] < 0) {
+            continue;
+        }
+        const auto& region = atlas.getRegion(materialImages[mesh.m_nMaterialIndex]);
+        auto clamped = false;
+        for (auto i = mesh.m_nIndexOffset; i < mesh.m_nIndexOffset + mesh.m_nIndexCount; ++i) {
+            auto v = m_IndexBuffer[i];
+            if (remapped[v]) {
+                continue;
+            }
+            remapped[v] = true;
+            auto& texCoords = vertices[v].m_TexCoords;
+            const auto epsilon = 1e-3f;
+            clamped = clamped || glm::any(glm::lessThan(texCoords, glm::vec2(-epsilon)))
+                    || glm::any(glm::greaterThan(texCoords, glm::vec2(1.f + epsilon)));
+            texCoords = region.m_Offset + glm::clamp(texCoords, 0.f, 1.f) * region.m_Scale;
+        }
+        if (clamped) {
+            std::clog << "Mesh " << mesh.m_sName << " repeats its diffuse map: texture coordinates clamped in the atlas"
+                      << std::endl;
+        }
+    }
     return true;
 }
 
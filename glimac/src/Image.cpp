@@ -1,46 +1,431 @@
 #include "glimac/Image.hpp"
+#include "glimac/ImageKernels.hpp"
+#include "glimac/TextureContainer.hpp"
+#include "glimac/ThreadPool.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
 
 namespace glimac {
 
-std::unique_ptr<Image> loadImage(const FilePath& filepath) {
+unsigned int getChannelCount(PixelFormat format) {
+    switch(format) {
+    case PixelFormat::R8:
+        return 1u;
+    case PixelFormat::RG8:
+        return 2u;
+    default:
+        return 4u;
+    }
+}
+
+size_t getPixelSize(PixelFormat format) {
+    switch(format) {
+    case PixelFormat::RGBA16F:
+        return 4 * sizeof(GLushort);
+    case PixelFormat::RGBA32F:
+        return sizeof(glm::vec4);
+    default:
+        return getChannelCount(format);
+    }
+}
+
+GLint getGLInternalFormat(PixelFormat format) {
+    switch(format) {
+    case PixelFormat::R8:
+        return GL_R8;
+    case PixelFormat::RG8:
+        return GL_RG8;
+    case PixelFormat::RGBA8:
+        return GL_RGBA8;
+    case PixelFormat::SRGB8_A8:
+        return GL_SRGB8_ALPHA8;
+    case PixelFormat::RGBA16F:
+        return GL_RGBA16F;
+    case PixelFormat::RGBA32F:
+        return GL_RGBA32F;
+    }
+    return GL_RGBA8;
+}
+
+GLenum getGLFormat(PixelFormat format) {
+    switch(format) {
+    case PixelFormat::R8:
+        return GL_RED;
+    case PixelFormat::RG8:
+        return GL_RG;
+    default:
+        return GL_RGBA;
+    }
+}
+
+GLenum getGLType(PixelFormat format) {
+    switch(format) {
+    case PixelFormat::RGBA16F:
+        return GL_HALF_FLOAT;
+    case PixelFormat::RGBA32F:
+        return GL_FLOAT;
+    default:
+        return GL_UNSIGNED_BYTE;
+    }
+}
+
+glm::vec4 Image::getPixel(unsigned int x, unsigned int y) const {
+    auto i = size_t(y) * m_nWidth + x;
+    auto pPixel = m_Data.get() + i * getPixelSize(m_Format);
+    auto color = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    switch(m_Format) {
+    case PixelFormat::R8:
+    case PixelFormat::RG8:
+    case PixelFormat::RGBA8:
+        unorm8ToFloat(pPixel, &color.x, getChannelCount(m_Format));
+        break;
+    case PixelFormat::SRGB8_A8:
+        srgb8ToLinear(pPixel, &color.x, 1);
+        break;
+    case PixelFormat::RGBA16F: {
+        auto pHalf = reinterpret_cast<const GLushort*>(pPixel);
+        for(auto c = 0u; c < 4u; ++c) {
+            color[c] = glm::unpackHalf1x16(pHalf[c]);
+        }
+        break;
+    }
+    case PixelFormat::RGBA32F:
+        color = reinterpret_cast<const glm::vec4*>(m_Data.get())[i];
+        break;
+    }
+    return color;
+}
+
+void Image::setPixel(unsigned int x, unsigned int y, const glm::vec4& color) {
+    auto i = size_t(y) * m_nWidth + x;
+    auto pPixel = getData() + i * getPixelSize(m_Format);
+    switch(m_Format) {
+    case PixelFormat::R8:
+    case PixelFormat::RG8:
+    case PixelFormat::RGBA8:
+        floatToUnorm8(&color.x, pPixel, getChannelCount(m_Format));
+        break;
+    case PixelFormat::SRGB8_A8:
+        linearToSrgb8(&color.x, pPixel, 1);
+        break;
+    case PixelFormat::RGBA16F: {
+        auto pHalf = reinterpret_cast<GLushort*>(pPixel);
+        for(auto c = 0u; c < 4u; ++c) {
+            pHalf[c] = glm::packHalf1x16(color[c]);
+        }
+        break;
+    }
+    case PixelFormat::RGBA32F:
+        reinterpret_cast<glm::vec4*>(m_Data.get())[i] = color;
+        break;
+    }
+}
+
+std::unique_ptr<Image> Image::convert(PixelFormat format) const {
+    std::unique_ptr<Image> pImage(new Image(m_nWidth, m_nHeight, format));
+    auto pixelCount = size_t(m_nWidth) * m_nHeight;
+    auto pSrc = getData();
+    auto pDst = pImage->getData();
+    if(format == m_Format) {
+        std::copy(pSrc, pSrc + getDataSize(), pDst);
+        return pImage;
+    }
+
+    // Common conversions with the image kernels, the others pixel by pixel
+    if(format == PixelFormat::RGBA32F && m_Format == PixelFormat::RGBA8) {
+        unorm8ToFloat(pSrc, reinterpret_cast<float*>(pDst), 4 * pixelCount);
+        return pImage;
+    }
+    if(format == PixelFormat::RGBA32F && m_Format == PixelFormat::SRGB8_A8) {
+        srgb8ToLinear(pSrc, reinterpret_cast<float*>(pDst), pixelCount);
+        return pImage;
+    }
+    if(format == PixelFormat::RGBA8 && m_Format == PixelFormat::RGBA32F) {
+        floatToUnorm8(reinterpret_cast<const float*>(pSrc), pDst, 4 * pixelCount);
+        return pImage;
+    }
+    if(format == PixelFormat::SRGB8_A8 && m_Format == PixelFormat::RGBA32F) {
+        linearToSrgb8(reinterpret_cast<const float*>(pSrc), pDst, pixelCount);
+        return pImage;
+    }
+    if(format == PixelFormat::RGBA8 && (m_Format == PixelFormat::R8 || m_Format == PixelFormat::RG8)) {
+        expandToRGBA8(pSrc, getChannelCount(m_Format), pDst, pixelCount);
+        return pImage;
+    }
+
+    for(auto y = 0u; y < m_nHeight; ++y) {
+        for(auto x = 0u; x < m_nWidth; ++x) {
+            pImage->setPixel(x, y, getPixel(x, y));
+        }
+    }
+    return pImage;
+}
+
+Image::Image(std::shared_ptr<const TextureContainer> pContainer, unsigned int face):
+    m_nWidth(pContainer->getWidth()), m_nHeight(pContainer->getHeight()), m_Format(pContainer->getPixelFormat()),
+    // The mapping is private: writes to the pixels are copied on write
+    m_Data(pContainer, const_cast<unsigned char*>(pContainer->getData(0, face))),
+    m_pContainer(pContainer), m_nContainerFace(face) {
+}
+
+uint64_t computeImageHash(const Image& image) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    mix(image.getWidth());
+    mix(image.getHeight());
+    mix(uint64_t(image.getFormat()));
+    // 8 bytes at a time, then the remaining bytes
+    auto data = image.getData();
+    auto size = image.getDataSize();
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        mix(word);
+    }
+    for(; i < size; ++i) {
+        mix(data[i]);
+    }
+    return hash;
+}
+
+void uploadImage(GLenum target, const Image& image, GLint level) {
+    if(level == 0 && image.getContainer()) {
+        image.getContainer()->uploadFace(target, image.getContainerFace());
+        return;
+    }
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(target, level, getGLInternalFormat(image.getFormat()), image.getWidth(), image.getHeight(), 0,
+                 getGLFormat(image.getFormat()), getGLType(image.getFormat()), image.getData());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+std::unique_ptr<Image> loadImage(const FilePath& filepath, PixelFormat format) {
+    auto pImage = loadTextureContainerImage(filepath, format);
+    if(pImage) {
+        return pImage;
+    }
+
     int x, y, n;
-    unsigned char *data = stbi_load(filepath.c_str(), &x, &y, &n, 4);
-    if(!data) {
+    if(stbi_is_hdr(filepath.c_str())) {
+        float *data = stbi_loadf(filepath.c_str(), &x, &y, &n, 4);
+        if(data) {
+            pImage.reset(new Image(x, y, PixelFormat::RGBA32F));
+            std::copy(data, data + 4 * x * y, reinterpret_cast<float*>(pImage->getData()));
+            stbi_image_free(data);
+        }
+    } else {
+        // 8 bits files are decoded in the 8 bits format with the requested channel count
+        auto fileFormat = format == PixelFormat::R8 || format == PixelFormat::RG8 || format == PixelFormat::SRGB8_A8 ?
+            format : PixelFormat::RGBA8;
+        unsigned char *data = stbi_load(filepath.c_str(), &x, &y, &n, getChannelCount(fileFormat));
+        if(data) {
+            pImage.reset(new Image(x, y, fileFormat));
+            std::copy(data, data + pImage->getDataSize(), pImage->getData());
+            stbi_image_free(data);
+        }
+    }
+    if(!pImage) {
         std::cerr << "loading image " << filepath << " error: " << stbi_failure_reason() << std::endl;
-        return std::unique_ptr<Image>();
-    }
-    std::unique_ptr<Image> pImage(new Image(x, y));
-    unsigned int size = x * y;
-    auto scale = 1.f / 255;
-    auto ptr = pImage->getPixels();
-    for(auto i = 0u; i < size; ++i) {
-        auto offset = 4 * i;
-        ptr->r = data[offset] * scale;
-        ptr->g = data[offset + 1] * scale;
-        ptr->b = data[offset + 2] * scale;
-        ptr->a = data[offset + 3] * scale;
-        ++ptr;
-    }
-    stbi_image_free(data);
+        return pImage;
+    }
+    if(pImage->getFormat() != format) {
+        pImage = pImage->convert(format);
+    }
     return pImage;
 }
 
-std::unordered_map<FilePath, std::unique_ptr<Image>> ImageManager::m_ImageMap;
+std::unordered_map<FilePath, ImageManager::Entry> ImageManager::m_ImageMap;
+std::unordered_map<FilePath, std::shared_ptr<ImageManager::PendingLoad>> ImageManager::m_PendingLoads;
+std::mutex ImageManager::m_Mutex;
+size_t ImageManager::m_nMemoryBudget = std::numeric_limits<size_t>::max();
+uint64_t ImageManager::m_nUseCounter = 0u;
+ImageManagerStatistics ImageManager::m_Statistics = { 0u, 0u, 0u, 0u, 0u };
 
-const Image* ImageManager::loadImage(const FilePath& filepath) {
+std::shared_ptr<ImageManager::PendingLoad> ImageManager::findOrCreatePendingLoad(const FilePath& filepath,
+                                                                                ImageHandle& pImage, bool& bCreated) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    bCreated = false;
     auto it = m_ImageMap.find(filepath);
     if(it != std::end(m_ImageMap)) {
-        return (*it).second.get();
+        ++m_Statistics.m_nHitCount;
+        (*it).second.m_nLastUse = ++m_nUseCounter;
+        pImage = (*it).second.m_pImage;
+        return nullptr;
+    }
+    auto& pLoad = m_PendingLoads[filepath];
+    if(!pLoad) {
+        ++m_Statistics.m_nMissCount;
+        pLoad = std::make_shared<PendingLoad>();
+        bCreated = true;
+    } else {
+        ++m_Statistics.m_nHitCount;
+    }
+    return pLoad;
+}
+
+ImageHandle ImageManager::complete(const FilePath& filepath, const std::shared_ptr<PendingLoad>& pLoad) {
+    // A thread waiting for a decode queued behind it on the pool does it itself instead of blocking
+    if(!pLoad->m_bClaimed.exchange(true)) {
+        ImageHandle pResult;
+        try {
+            std::shared_ptr<const Image> pImage(glimac::loadImage(filepath));
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if(pImage) {
+                pResult = insert(filepath, std::move(pImage), false);
+            }
+            // Failed loads are not cached: the next request tries again
+            m_PendingLoads.erase(filepath);
+        } catch(...) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_PendingLoads.erase(filepath);
+            }
+            pLoad->m_Promise.set_exception(std::current_exception());
+            throw;
+        }
+        pLoad->m_Promise.set_value(pResult);
+    }
+    return pLoad->m_Future.get();
+}
+
+ImageHandle ImageManager::insert(const FilePath& filepath, std::shared_ptr<const Image> pImage, bool bPinned) {
+    auto& entry = m_ImageMap[filepath];
+    if(!entry.m_pImage) {
+        entry.m_pImage = std::move(pImage);
+        entry.m_nSize = entry.m_pImage->getDataSize();
+        entry.m_bPinned = false;
+        m_Statistics.m_nResidentBytes += entry.m_nSize;
+        ++m_Statistics.m_nImageCount;
     }
-    auto pImage = glimac::loadImage(filepath);
+    entry.m_bPinned = entry.m_bPinned || bPinned;
+    entry.m_nLastUse = ++m_nUseCounter;
+    // Referenced by the returned handle: not evicted
+    ImageHandle pResult = entry.m_pImage;
+    evict(m_nMemoryBudget);
+    return pResult;
+}
+
+void ImageManager::evict(size_t budget) {
+    if(m_Statistics.m_nResidentBytes <= budget) {
+        return;
+    }
+    // Only the cache refers to an unreferenced image: handles are created under the lock
+    std::vector<std::pair<uint64_t, const FilePath*>> candidates;
+    for(const auto& entry: m_ImageMap) {
+        if(!entry.second.m_bPinned && entry.second.m_pImage.use_count() == 1) {
+            candidates.emplace_back(entry.second.m_nLastUse, &entry.first);
+        }
+    }
+    std::sort(begin(candidates), end(candidates));
+    for(const auto& candidate: candidates) {
+        if(m_Statistics.m_nResidentBytes <= budget) {
+            break;
+        }
+        auto it = m_ImageMap.find(*candidate.second);
+        m_Statistics.m_nResidentBytes -= (*it).second.m_nSize;
+        --m_Statistics.m_nImageCount;
+        ++m_Statistics.m_nEvictionCount;
+        m_ImageMap.erase(it);
+    }
+}
+
+const Image* ImageManager::pin(const FilePath& filepath, const ImageHandle& pImage) {
     if(!pImage) {
         return nullptr;
     }
-    auto& img = m_ImageMap[filepath] = std::move(pImage);
-    return img.get();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // Still cached: the handle prevents the eviction
+    m_ImageMap[filepath].m_bPinned = true;
+    return pImage.get();
+}
+
+ImageHandle ImageManager::acquireImage(const FilePath& filepath) {
+    auto path = filepath.canonical();
+    ImageHandle pImage;
+    bool bCreated;
+    auto pLoad = findOrCreatePendingLoad(path, pImage, bCreated);
+    if(!pLoad) {
+        return pImage;
+    }
+    return complete(path, pLoad);
 }
 
-}
\ No newline at end of file
+std::shared_future<ImageHandle> ImageManager::acquireImageAsync(const FilePath& filepath) {
+    auto path = filepath.canonical();
+    ImageHandle pImage;
+    bool bCreated;
+    auto pLoad = findOrCreatePendingLoad(path, pImage, bCreated);
+    if(!pLoad) {
+        std::promise<ImageHandle> promise;
+        promise.set_value(pImage);
+        return promise.get_future().share();
+    }
+    if(bCreated) {
+        ThreadPool::getInstance().submit([path, pLoad]() {
+            // Exceptions reach the waiters through the promise
+            try {
+                complete(path, pLoad);
+            } catch(...) {
+            }
+        });
+    }
+    return pLoad->m_Future;
+}
+
+const Image* ImageManager::loadImage(const FilePath& filepath) {
+    auto path = filepath.canonical();
+    return pin(path, acquireImage(path));
+}
+
+const Image* ImageManager::findImage(const FilePath& filepath) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_ImageMap.find(filepath.canonical());
+    if(it != std::end(m_ImageMap)) {
+        (*it).second.m_bPinned = true;
+        (*it).second.m_nLastUse = ++m_nUseCounter;
+        return (*it).second.m_pImage.get();
+    }
+    return nullptr;
+}
+
+const Image* ImageManager::insertImage(const FilePath& filepath, std::unique_ptr<Image> pImage) {
+    if(!pImage) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return insert(filepath.canonical(), std::move(pImage), true).get();
+}
+
+void ImageManager::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_nMemoryBudget = bytes;
+    evict(m_nMemoryBudget);
+}
+
+size_t ImageManager::getMemoryBudget() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_nMemoryBudget;
+}
+
+void ImageManager::evictUnusedImages() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    evict(0u);
+}
+
+ImageManagerStatistics ImageManager::getStatistics() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Statistics;
+}
+
+}
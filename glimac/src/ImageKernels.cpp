@@ -0,0 +1,278 @@
+#include "glimac/ImageKernels.hpp"
+#include "glimac/Image.hpp"
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace glimac {
+
+namespace {
+
+const int SRGB_ENCODE_TABLE_SIZE = 16384;
+
+const std::array<float, 256>& srgbDecodeTable() {
+    static const auto table = []() {
+        std::array<float, 256> table;
+        for (auto i = 0u; i < 256u; ++i) {
+            auto c = i / 255.f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    return table;
+}
+
+// Entry i encodes the linear value i / (SRGB_ENCODE_TABLE_SIZE - 1)
+const std::array<uint8_t, SRGB_ENCODE_TABLE_SIZE>& srgbEncodeTable() {
+    static const auto table = []() {
+        std::array<uint8_t, SRGB_ENCODE_TABLE_SIZE> table;
+        for (auto i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i) {
+            auto c = float(i) / (SRGB_ENCODE_TABLE_SIZE - 1);
+            auto s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            table[i] = uint8_t(s * 255.f + 0.5f);
+        }
+        return table;
+    }();
+    return table;
+}
+
+inline uint8_t toUnorm8(float value) {
+    return uint8_t(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+inline int srgbEncodeIndex(float value) {
+    return int(std::min(std::max(value, 0.f), 1.f) * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f);
+}
+
+// x / 255 rounded, for x <= 255 * 255
+inline unsigned int divideBy255(unsigned int x) {
+    x += 128u;
+    return (x + (x >> 8)) >> 8;
+}
+
+#ifdef __SSE2__
+// 16 bytes to 4 x 4 floats
+inline void unpackUnorm8(__m128i bytes, __m128 scale, __m128 out[4]) {
+    auto zero = _mm_setzero_si128();
+    auto low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+    out[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale);
+    out[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale);
+    out[2] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale);
+    out[3] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale);
+}
+
+// int(clamp(value, 0, 1) * scale + 0.5)
+inline __m128i quantize(__m128 value, __m128 scale) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), _mm_set1_ps(0.5f)));
+}
+#endif
+
+}
+
+void unorm8ToFloat(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    auto scale = 1.f / 255;
+#ifdef __SSE2__
+    auto vScale = _mm_set1_ps(scale);
+    for (; i + 16 <= count; i += 16) {
+        __m128 values[4];
+        unpackUnorm8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), vScale, values);
+        for (auto k = 0u; k < 4u; ++k) {
+            _mm_storeu_ps(dst + i + 4 * k, values[k]);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = src[i] * scale;
+    }
+}
+
+void floatToUnorm8(const float* src, uint8_t* dst, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    auto vScale = _mm_set1_ps(255.f);
+    for (; i + 16 <= count; i += 16) {
+        auto a = quantize(_mm_loadu_ps(src + i), vScale), b = quantize(_mm_loadu_ps(src + i + 4), vScale);
+        auto c = quantize(_mm_loadu_ps(src + i + 8), vScale), d = quantize(_mm_loadu_ps(src + i + 12), vScale);
+        auto bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = toUnorm8(src[i]);
+    }
+}
+
+void srgb8ToLinear(const uint8_t* src, float* dst, size_t pixelCount) {
+    // Table lookups have no SSE2 equivalent, the table holds in L1
+    const auto& table = srgbDecodeTable();
+    auto scale = 1.f / 255;
+    for (size_t i = 0; i < pixelCount; ++i, src += 4, dst += 4) {
+        dst[0] = table[src[0]];
+        dst[1] = table[src[1]];
+        dst[2] = table[src[2]];
+        dst[3] = src[3] * scale;
+    }
+}
+
+void linearToSrgb8(const float* src, uint8_t* dst, size_t pixelCount) {
+    const auto& table = srgbEncodeTable();
+    size_t i = 0;
+#ifdef __SSE2__
+    // Indices and alpha computed 4 channels at a time, lookups one by one
+    auto vIndexScale = _mm_set1_ps(SRGB_ENCODE_TABLE_SIZE - 1), vAlphaScale = _mm_set1_ps(255.f);
+    alignas(16) int32_t indices[4], alphas[4];
+    for (; i < pixelCount; ++i, src += 4, dst += 4) {
+        auto value = _mm_loadu_ps(src);
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), quantize(value, vIndexScale));
+        _mm_store_si128(reinterpret_cast<__m128i*>(alphas), quantize(value, vAlphaScale));
+        dst[0] = table[indices[0]];
+        dst[1] = table[indices[1]];
+        dst[2] = table[indices[2]];
+        dst[3] = uint8_t(alphas[3]);
+    }
+#endif
+    for (; i < pixelCount; ++i, src += 4, dst += 4) {
+        dst[0] = table[srgbEncodeIndex(src[0])];
+        dst[1] = table[srgbEncodeIndex(src[1])];
+        dst[2] = table[srgbEncodeIndex(src[2])];
+        dst[3] = toUnorm8(src[3]);
+    }
+}
+
+void premultiplyAlpha(uint8_t* pixels, size_t pixelCount) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // 16 bits lanes: alpha broadcast over its pixel, the alpha lane itself multiplied by 255
+    auto zero = _mm_setzero_si128();
+    auto alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    auto alphaFactor = _mm_and_si128(alphaLanes, _mm_set1_epi16(255));
+    auto bias = _mm_set1_epi16(128);
+    auto premultiply = [&](__m128i values) {
+        auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        auto factor = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaFactor);
+        auto x = _mm_add_epi16(_mm_mullo_epi16(values, factor), bias);
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    };
+    for (; i + 4 <= pixelCount; i += 4) {
+        auto p = reinterpret_cast<__m128i*>(pixels + 4 * i);
+        auto bytes = _mm_loadu_si128(p);
+        auto low = premultiply(_mm_unpacklo_epi8(bytes, zero));
+        auto high = premultiply(_mm_unpackhi_epi8(bytes, zero));
+        _mm_storeu_si128(p, _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < pixelCount; ++i) {
+        auto pPixel = pixels + 4 * i;
+        for (auto c = 0u; c < 3u; ++c) {
+            pPixel[c] = uint8_t(divideBy255(pPixel[c] * pPixel[3]));
+        }
+    }
+}
+
+void premultiplyAlpha(glm::vec4* pixels, size_t pixelCount) {
+    size_t i = 0;
+#ifdef __SSE2__
+    auto alphaLane = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    auto one = _mm_set1_ps(1.f);
+    for (; i < pixelCount; ++i) {
+        auto p = reinterpret_cast<float*>(pixels + i);
+        auto value = _mm_loadu_ps(p);
+        auto alpha = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+        auto factor = _mm_or_ps(_mm_andnot_ps(alphaLane, alpha), _mm_and_ps(alphaLane, one));
+        _mm_storeu_ps(p, _mm_mul_ps(value, factor));
+    }
+#endif
+    for (; i < pixelCount; ++i) {
+        pixels[i] = glm::vec4(glm::vec3(pixels[i]) * pixels[i].a, pixels[i].a);
+    }
+}
+
+void flipVertically(uint8_t* data, size_t rowSize, size_t rowCount) {
+    // Byte loop vectorized by the compiler
+    for (size_t top = 0; 2 * top + 1 < rowCount; ++top) {
+        auto bottom = rowCount - 1 - top;
+        std::swap_ranges(data + top * rowSize, data + (top + 1) * rowSize, data + bottom * rowSize);
+    }
+}
+
+void swizzle(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<unsigned int, 4>& order) {
+    size_t i = 0;
+#ifdef __SSSE3__
+    alignas(16) int8_t shuffle[16];
+    for (auto p = 0u; p < 4u; ++p) {
+        for (auto c = 0u; c < 4u; ++c) {
+            shuffle[4 * p + c] = int8_t(4 * p + order[c]);
+        }
+    }
+    auto vShuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle));
+    for (; i + 4 <= pixelCount; i += 4) {
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_shuffle_epi8(bytes, vShuffle));
+    }
+#elif defined(__SSE2__)
+    // Without byte shuffles: each channel moved with 32 bits shifts (x86 is little endian, channel c is bits 8c)
+    auto mask = _mm_set1_epi32(0xFF);
+    __m128i shiftIn[4], shiftOut[4];
+    for (auto c = 0u; c < 4u; ++c) {
+        shiftIn[c] = _mm_cvtsi32_si128(8 * order[c]);
+        shiftOut[c] = _mm_cvtsi32_si128(8 * c);
+    }
+    for (; i + 4 <= pixelCount; i += 4) {
+        auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        auto result = _mm_setzero_si128();
+        for (auto c = 0u; c < 4u; ++c) {
+            auto channel = _mm_and_si128(_mm_srl_epi32(pixels, shiftIn[c]), mask);
+            result = _mm_or_si128(result, _mm_sll_epi32(channel, shiftOut[c]));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), result);
+    }
+#endif
+    for (; i < pixelCount; ++i) {
+        uint8_t pixel[4] = { src[4 * i], src[4 * i + 1], src[4 * i + 2], src[4 * i + 3] };
+        for (auto c = 0u; c < 4u; ++c) {
+            dst[4 * i + c] = pixel[order[c]];
+        }
+    }
+}
+
+void expandToRGBA8(const uint8_t* src, unsigned int channelCount, uint8_t* dst, size_t pixelCount) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // 8 R8 or RG8 pixels per iteration: interleave with zeros, then the blue / alpha pair (0, 255)
+    if (channelCount == 1u || channelCount == 2u) {
+        auto zero = _mm_setzero_si128();
+        auto blueAlpha = _mm_set1_epi16(int16_t(0xFF00));
+        for (; i + 8 <= pixelCount; i += 8) {
+            __m128i redGreen;
+            if (channelCount == 1u) {
+                redGreen = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)), zero);
+            } else {
+                redGreen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i), _mm_unpacklo_epi16(redGreen, blueAlpha));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * i + 16), _mm_unpackhi_epi16(redGreen, blueAlpha));
+        }
+    }
+#endif
+    static const uint8_t defaults[4] = { 0, 0, 0, 255 };
+    for (; i < pixelCount; ++i) {
+        for (auto c = 0u; c < 4u; ++c) {
+            dst[4 * i + c] = c < channelCount ? src[channelCount * i + c] : defaults[c];
+        }
+    }
+}
+
+void flipVertically(Image& image) {
+    flipVertically(image.getData(), image.getWidth() * getPixelSize(image.getFormat()), image.getHeight());
+}
+
+}
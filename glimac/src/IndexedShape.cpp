@@ -0,0 +1,149 @@
+#include "glimac/IndexedShape.hpp"
+#include "glimac/VertexAttributes.hpp"
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace glimac {
+
+namespace {
+
+template<typename Index>
+std::vector<Index> buildGridIndices(GLsizei columnCount, GLsizei rowCount) {
+    std::vector<Index> indices(size_t(columnCount) * rowCount * 6);
+    auto pIndex = indices.data();
+    for (auto j = 0; j < rowCount; ++j) {
+        Index offset = j * (columnCount + 1);
+        Index nextOffset = offset + columnCount + 1;
+        for (auto i = 0; i < columnCount; ++i, pIndex += 6) {
+            pIndex[0] = offset + i;
+            pIndex[1] = offset + i + 1;
+            pIndex[2] = nextOffset + i + 1;
+            pIndex[3] = offset + i;
+            pIndex[4] = nextOffset + i + 1;
+            pIndex[5] = nextOffset + i;
+        }
+    }
+    return indices;
+}
+
+}
+
+IndexedShape::IndexedShape(std::vector<ShapeVertex> vertices, const std::vector<GLuint>& indices):
+    m_Vertices(std::move(vertices)) {
+    if (m_Vertices.size() <= 65536u) {
+        m_ShortIndices.assign(begin(indices), end(indices));
+    } else {
+        m_Indices = indices;
+    }
+}
+
+IndexedShape IndexedShape::makeGrid(std::vector<ShapeVertex> vertices, GLsizei columnCount, GLsizei rowCount) {
+    IndexedShape shape;
+    shape.m_Vertices = std::move(vertices);
+    if (shape.m_Vertices.size() <= 65536u) {
+        shape.m_ShortIndices = buildGridIndices<GLushort>(columnCount, rowCount);
+    } else {
+        shape.m_Indices = buildGridIndices<GLuint>(columnCount, rowCount);
+    }
+    return shape;
+}
+
+std::vector<ShapeVertex> IndexedShape::expand() const {
+    std::vector<ShapeVertex> vertices;
+    vertices.reserve(getIndexCount());
+    for (auto i = 0; i < getIndexCount(); ++i) {
+        vertices.push_back(m_Vertices[getIndex(i)]);
+    }
+    return vertices;
+}
+
+void computeSinCosTable(GLsizei count, GLfloat* sinTable, GLfloat* cosTable) {
+    auto step = 2 * glm::pi<float>() / count;
+    for (auto i = 0; i < count; ++i) {
+        sinTable[i] = std::sin(i * step);
+        cosTable[i] = std::cos(i * step);
+    }
+    sinTable[count] = sinTable[0];
+    cosTable[count] = cosTable[0];
+}
+
+void buildRing(ShapeVertex* vertices, const GLfloat* sinTable, const GLfloat* cosTable, GLsizei count, GLfloat rcpCount,
+               GLfloat positionScale, GLfloat positionY, GLfloat normalScale, GLfloat normalY, GLfloat texCoordY) {
+    static_assert(sizeof(ShapeVertex) == 8 * sizeof(GLfloat), "ShapeVertex is written as two groups of 4 floats");
+
+    auto i = 0;
+#ifdef __SSE2__
+    // 4 vertices per iteration, computed attribute by attribute, then transposed into two
+    // (position.xyz, normal.x) and (normal.yz, texCoords) rows per vertex
+    auto vPositionScale = _mm_set1_ps(positionScale), vPositionY = _mm_set1_ps(positionY);
+    auto vNormalScale = _mm_set1_ps(normalScale), vNormalY = _mm_set1_ps(normalY);
+    auto vTexCoordY = _mm_set1_ps(texCoordY), vRcpCount = _mm_set1_ps(rcpCount);
+    auto vIndex = _mm_set_ps(3.f, 2.f, 1.f, 0.f), vFour = _mm_set1_ps(4.f);
+    auto pOutput = reinterpret_cast<GLfloat*>(vertices);
+    for (; i + 4 <= count; i += 4, pOutput += 32) {
+        auto vSin = _mm_loadu_ps(sinTable + i), vCos = _mm_loadu_ps(cosTable + i);
+        auto px = _mm_mul_ps(vPositionScale, vSin), py = vPositionY, pz = _mm_mul_ps(vPositionScale, vCos);
+        auto nx = _mm_mul_ps(vNormalScale, vSin), ny = vNormalY, nz = _mm_mul_ps(vNormalScale, vCos);
+        auto u = _mm_mul_ps(vIndex, vRcpCount), v = vTexCoordY;
+        vIndex = _mm_add_ps(vIndex, vFour);
+
+        _MM_TRANSPOSE4_PS(px, py, pz, nx);
+        _MM_TRANSPOSE4_PS(ny, nz, u, v);
+        _mm_storeu_ps(pOutput, px);      _mm_storeu_ps(pOutput + 4, ny);
+        _mm_storeu_ps(pOutput + 8, py);  _mm_storeu_ps(pOutput + 12, nz);
+        _mm_storeu_ps(pOutput + 16, pz); _mm_storeu_ps(pOutput + 20, u);
+        _mm_storeu_ps(pOutput + 24, nx); _mm_storeu_ps(pOutput + 28, v);
+    }
+#endif
+    for (; i < count; ++i) {
+        auto& vertex = vertices[i];
+        vertex.position = glm::vec3(positionScale * sinTable[i], positionY, positionScale * cosTable[i]);
+        vertex.normal = glm::vec3(normalScale * sinTable[i], normalY, normalScale * cosTable[i]);
+        vertex.texCoords = glm::vec2(i * rcpCount, texCoordY);
+    }
+}
+
+ShapeBuffers uploadShape(const IndexedShape& shape, GLuint positionLocation, GLuint normalLocation,
+                         GLuint texCoordsLocation) {
+    ShapeBuffers buffers;
+    buffers.m_IndexType = shape.getIndexType();
+    buffers.m_nIndexCount = shape.getIndexCount();
+
+    glGenBuffers(1, &buffers.m_nVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.m_nVBO);
+    glBufferData(GL_ARRAY_BUFFER, shape.getVertexCount() * sizeof(ShapeVertex), shape.getVertexPointer(), GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &buffers.m_nVAO);
+    glBindVertexArray(buffers.m_nVAO);
+
+    // The element array binding is part of the VAO state
+    glGenBuffers(1, &buffers.m_nIBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.m_nIBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, shape.getIndexCount() * shape.getIndexSize(), shape.getIndexPointer(), GL_STATIC_DRAW);
+
+    setShapeVertexAttribPointers(positionLocation, normalLocation, texCoordsLocation);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return buffers;
+}
+
+void drawShape(const ShapeBuffers& buffers) {
+    glBindVertexArray(buffers.m_nVAO);
+    glDrawElements(GL_TRIANGLES, buffers.m_nIndexCount, buffers.m_IndexType, 0);
+    glBindVertexArray(0);
+}
+
+void deleteShapeBuffers(ShapeBuffers& buffers) {
+    glDeleteVertexArrays(1, &buffers.m_nVAO);
+    glDeleteBuffers(1, &buffers.m_nVBO);
+    glDeleteBuffers(1, &buffers.m_nIBO);
+    buffers = ShapeBuffers();
+}
+
+}
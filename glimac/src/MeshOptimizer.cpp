@@ -0,0 +1,318 @@
+#include "glimac/MeshOptimizer.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace glimac {
+
+VertexCacheStatistics analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                                         unsigned int cacheSize) {
+    VertexCacheStatistics stats = { 0.f, 0.f };
+    if (indexCount < 3) {
+        return stats;
+    }
+
+    // Timestamp of the insertion of each vertex in the FIFO
+    std::vector<unsigned int> insertionTime(vertexCount, 0u);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0, uniqueCount = 0;
+
+    for (auto i = 0u; i < indexCount; ++i) {
+        auto v = indices[i];
+        if (time - insertionTime[v] > cacheSize) {
+            insertionTime[v] = time++;
+            ++misses;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            ++uniqueCount;
+        }
+    }
+
+    stats.m_fACMR = float(misses) / (indexCount / 3);
+    stats.m_fATVR = float(misses) / uniqueCount;
+    return stats;
+}
+
+namespace {
+
+const int kForsythCacheSize = 32;
+
+// Score tables of the Forsyth heuristic
+struct ForsythScores {
+    float m_CachePosition[kForsythCacheSize];
+    float m_Valence[32];
+
+    ForsythScores() {
+        const float lastTriangleScore = 0.75f;
+        const float cacheDecayPower = 1.5f;
+        const float valenceBoostScale = 2.f;
+        const float valenceBoostPower = 0.5f;
+
+        for (auto i = 0; i < kForsythCacheSize; ++i) {
+            if (i < 3) {
+                // The vertices of the last triangle are scored low on purpose, to avoid picking
+                // a triangle which shares an edge with it (strips give poor cache reuse).
+                m_CachePosition[i] = lastTriangleScore;
+            } else {
+                auto scaler = 1.f / (kForsythCacheSize - 3);
+                m_CachePosition[i] = std::pow(1.f - (i - 3) * scaler, cacheDecayPower);
+            }
+        }
+        m_Valence[0] = 0.f;
+        for (auto i = 1; i < 32; ++i) {
+            m_Valence[i] = valenceBoostScale * std::pow(float(i), -valenceBoostPower);
+        }
+    }
+
+    float vertexScore(int cachePosition, unsigned int valence) const {
+        if (valence == 0u) {
+            return -1.f; // No triangle left needs this vertex
+        }
+        auto score = cachePosition < 0 ? 0.f : m_CachePosition[cachePosition];
+        return score + m_Valence[std::min(valence, 31u)];
+    }
+};
+
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount) {
+    static const ForsythScores scores;
+
+    auto triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Vertex -> triangles adjacency (CSR)
+    std::vector<unsigned int> valence(vertexCount, 0u);
+    for (auto i = 0u; i < triangleCount * 3; ++i) {
+        ++valence[indices[i]];
+    }
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0u);
+    for (auto v = 0u; v < vertexCount; ++v) {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+    }
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (auto t = 0u; t < triangleCount; ++t) {
+            for (auto k = 0u; k < 3; ++k) {
+                auto v = indices[3 * t + k];
+                adjacency[fill[v]++] = t;
+            }
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (auto v = 0u; v < vertexCount; ++v) {
+        vertexScore[v] = scores.vertexScore(-1, valence[v]);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+
+    // LRU cache, with room for the 3 vertices pushed before trimming
+    unsigned int cache[kForsythCacheSize + 3];
+    unsigned int cacheCount = 0;
+
+    size_t inputCursor = 0; // Next candidate when the cache gives no triangle
+    int bestTriangle = -1;
+
+    for (auto emittedCount = 0u; emittedCount < triangleCount; ++emittedCount) {
+        if (bestTriangle < 0) {
+            while (emitted[inputCursor]) {
+                ++inputCursor;
+            }
+            bestTriangle = int(inputCursor);
+        }
+
+        auto t = unsigned(bestTriangle);
+        emitted[t] = true;
+
+        unsigned int newCache[kForsythCacheSize + 3];
+        unsigned int newCacheCount = 0;
+
+        for (auto k = 0u; k < 3; ++k) {
+            auto v = indices[3 * t + k];
+            output.push_back(v);
+            newCache[newCacheCount++] = v;
+
+            // Remove the triangle from the adjacency of its vertices
+            auto begin = adjacency.begin() + adjacencyOffset[v];
+            auto end = begin + valence[v];
+            auto it = std::find(begin, end, t);
+            std::iter_swap(it, end - 1);
+            --valence[v];
+        }
+
+        for (auto i = 0u; i < cacheCount; ++i) {
+            auto v = cache[i];
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache[newCacheCount++] = v;
+            }
+        }
+
+        // Vertices pushed out of the cache
+        for (auto i = kForsythCacheSize; i < int(newCacheCount); ++i) {
+            cachePosition[newCache[i]] = -1;
+        }
+
+        cacheCount = std::min<unsigned int>(newCacheCount, kForsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // Update the scores of the cached vertices and of their triangles, pick the best one
+        for (auto i = 0u; i < newCacheCount; ++i) {
+            auto v = newCache[i];
+            cachePosition[v] = i < cacheCount ? int(i) : -1;
+            vertexScore[v] = scores.vertexScore(cachePosition[v], valence[v]);
+        }
+
+        bestTriangle = -1;
+        auto bestScore = 0.f;
+        for (auto i = 0u; i < newCacheCount; ++i) {
+            auto v = newCache[i];
+            for (auto a = adjacencyOffset[v]; a < adjacencyOffset[v] + valence[v]; ++a) {
+                auto tri = adjacency[a];
+                auto score = vertexScore[indices[3 * tri]] + vertexScore[indices[3 * tri + 1]] + vertexScore[indices[3 * tri + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = int(tri);
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount, const glm::vec3* positions, size_t vertexCount,
+                      float threshold) {
+    const unsigned int cacheSize = 16;
+    auto triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    auto inputACMR = analyzeVertexCache(indices, indexCount, vertexCount, cacheSize).m_fACMR;
+
+    // Hard boundaries: triangles whose 3 vertices all miss the FIFO cache. Reordering
+    // clusters starting there doesn't change the number of transformed vertices.
+    std::vector<unsigned int> insertionTime(vertexCount, 0u);
+    unsigned int time = cacheSize + 1;
+    std::vector<unsigned int> hardStart;
+
+    for (auto t = 0u; t < triangleCount; ++t) {
+        auto misses = 0u;
+        for (auto k = 0u; k < 3; ++k) {
+            auto v = indices[3 * t + k];
+            if (time - insertionTime[v] > cacheSize) {
+                insertionTime[v] = time++;
+                ++misses;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            hardStart.push_back(t);
+        }
+    }
+    hardStart.push_back(triangleCount);
+
+    // Soft boundaries: a hard cluster is cut once the current part, simulated with a cold
+    // cache, is cache efficient enough on its own
+    std::vector<unsigned int> clusterStart;
+    for (auto h = 0u; h + 1 < hardStart.size(); ++h) {
+        time += cacheSize + 1; // Flush the cache
+        clusterStart.push_back(hardStart[h]);
+        auto clusterMisses = 0u, clusterTriangles = 0u;
+
+        for (auto t = hardStart[h]; t < hardStart[h + 1]; ++t) {
+            for (auto k = 0u; k < 3; ++k) {
+                auto v = indices[3 * t + k];
+                if (time - insertionTime[v] > cacheSize) {
+                    insertionTime[v] = time++;
+                    ++clusterMisses;
+                }
+            }
+            ++clusterTriangles;
+
+            if (t + 1 < hardStart[h + 1] && float(clusterMisses) / clusterTriangles <= threshold * inputACMR) {
+                time += cacheSize + 1;
+                clusterStart.push_back(t + 1);
+                clusterMisses = 0u;
+                clusterTriangles = 0u;
+            }
+        }
+    }
+    clusterStart.push_back(triangleCount);
+
+    auto clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2) {
+        return;
+    }
+
+    // Area weighted centroids and normals
+    std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.f));
+    glm::vec3 meshCentroid(0.f);
+    auto meshArea = 0.f;
+
+    for (auto c = 0u; c < clusterCount; ++c) {
+        auto clusterArea = 0.f;
+        for (auto t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            const auto& p0 = positions[indices[3 * t]];
+            const auto& p1 = positions[indices[3 * t + 1]];
+            const auto& p2 = positions[indices[3 * t + 2]];
+            auto n = glm::cross(p1 - p0, p2 - p0);
+            auto area = glm::length(n);
+            clusterCentroid[c] += area * (p0 + p1 + p2) / 3.f;
+            clusterNormal[c] += n;
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea;
+        clusterCentroid[c] = clusterArea > 0.f ? clusterCentroid[c] / clusterArea : positions[indices[3 * clusterStart[c]]];
+    }
+    if (meshArea > 0.f) {
+        meshCentroid /= meshArea;
+    }
+
+    std::vector<float> sortKey(clusterCount);
+    for (auto c = 0u; c < clusterCount; ++c) {
+        auto length = glm::length(clusterNormal[c]);
+        auto normal = length > 0.f ? clusterNormal[c] / length : glm::vec3(0.f);
+        sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, normal);
+    }
+
+    std::vector<unsigned int> order(clusterCount);
+    for (auto c = 0u; c < clusterCount; ++c) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (auto c: order) {
+        output.insert(output.end(), indices + 3 * clusterStart[c], indices + 3 * clusterStart[c + 1]);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t optimizeVertexFetchRemap(unsigned int* remap, const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+    std::fill(remap, remap + vertexCount, ~0u);
+
+    auto nextVertex = 0u;
+    for (auto i = 0u; i < indexCount; ++i) {
+        auto v = indices[i];
+        if (remap[v] == ~0u) {
+            remap[v] = nextVertex++;
+        }
+    }
+    return nextVertex;
+}
+
+}
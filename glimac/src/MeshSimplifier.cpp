@@ -0,0 +1,251 @@
+#include "glimac/MeshSimplifier.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace glimac {
+
+namespace {
+
+// Symmetric 4x4 matrix of the sum of the squared distances to a set of planes,
+// weighted by the area of the triangles the planes come from
+struct Quadric {
+    double a00 = 0., a01 = 0., a02 = 0., a03 = 0.;
+    double a11 = 0., a12 = 0., a13 = 0.;
+    double a22 = 0., a23 = 0.;
+    double a33 = 0.;
+    double w = 0.;
+
+    Quadric() = default;
+
+    Quadric(const glm::vec3& n, float d, float weight) {
+        a00 = weight * n.x * n.x; a01 = weight * n.x * n.y; a02 = weight * n.x * n.z; a03 = weight * n.x * d;
+        a11 = weight * n.y * n.y; a12 = weight * n.y * n.z; a13 = weight * n.y * d;
+        a22 = weight * n.z * n.z; a23 = weight * n.z * d;
+        a33 = weight * d * d;
+        w = weight;
+    }
+
+    Quadric& operator +=(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        w += q.w;
+        return *this;
+    }
+
+    /*! weighted sum of squared distances from p to the planes */
+    double evaluate(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return x * x * a00 + y * y * a11 + z * z * a22
+            + 2. * (x * y * a01 + x * z * a02 + y * z * a12)
+            + 2. * (x * a03 + y * a13 + z * a23) + a33;
+    }
+};
+
+struct Collapse {
+    unsigned int m_nFrom, m_nTo;
+    float m_fError; // Squared distance
+};
+
+// Compressed vertex -> triangles adjacency of a triangle list
+void buildTriangleAdjacency(const unsigned int* indices, size_t indexCount, size_t vertexCount,
+                            std::vector<unsigned int>& offsets, std::vector<unsigned int>& triangles) {
+    offsets.assign(vertexCount + 1, 0u);
+    for (auto i = 0u; i < indexCount; ++i) {
+        ++offsets[indices[i] + 1];
+    }
+    for (auto v = 0u; v < vertexCount; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+    triangles.resize(indexCount);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (auto i = 0u; i < indexCount; ++i) {
+        triangles[fill[indices[i]]++] = i / 3;
+    }
+}
+
+bool hasEdge(const unsigned int* indices, const std::vector<unsigned int>& offsets, const std::vector<unsigned int>& triangles,
+             unsigned int a, unsigned int b) {
+    for (auto i = offsets[a]; i < offsets[a + 1]; ++i) {
+        auto t = indices + 3 * triangles[i];
+        if ((t[0] == a && t[1] == b) || (t[1] == a && t[2] == b) || (t[2] == a && t[0] == b)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+size_t simplifyMesh(unsigned int* destination, const unsigned int* indices, size_t indexCount,
+                    const glm::vec3* positions, size_t vertexCount, size_t targetIndexCount, float& error) {
+    error = 0.f;
+    indexCount -= indexCount % 3;
+    std::vector<unsigned int> result(indices, indices + indexCount);
+
+    // Vertices sharing a position (seams) are represented by the first of them
+    std::vector<unsigned int> group(vertexCount);
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::vector<unsigned int> order(vertexCount);
+        for (auto v = 0u; v < vertexCount; ++v) {
+            order[v] = v;
+        }
+        auto less = [&](unsigned int a, unsigned int b) {
+            const auto& pa = positions[a];
+            const auto& pb = positions[b];
+            return pa.x < pb.x || (pa.x == pb.x && (pa.y < pb.y || (pa.y == pb.y && pa.z < pb.z)));
+        };
+        std::sort(order.begin(), order.end(), less);
+        for (auto i = 0u; i < vertexCount;) {
+            auto j = i + 1;
+            while (j < vertexCount && positions[order[j]] == positions[order[i]]) {
+                ++j;
+            }
+            for (auto k = i; k < j; ++k) {
+                group[order[k]] = order[i];
+                locked[order[k]] = j - i > 1;
+            }
+            i = j;
+        }
+    }
+
+    // Border edges have no opposite edge, once the seams are welded
+    {
+        std::vector<unsigned int> welded(indexCount);
+        for (auto i = 0u; i < indexCount; ++i) {
+            welded[i] = group[result[i]];
+        }
+        std::vector<unsigned int> offsets, triangles;
+        buildTriangleAdjacency(welded.data(), indexCount, vertexCount, offsets, triangles);
+
+        std::vector<bool> borderGroup(vertexCount, false);
+        for (auto i = 0u; i < indexCount; ++i) {
+            auto a = welded[i];
+            auto b = welded[i - i % 3 + (i + 1) % 3];
+            if (!hasEdge(welded.data(), offsets, triangles, b, a)) {
+                borderGroup[a] = borderGroup[b] = true;
+            }
+        }
+        for (auto v = 0u; v < vertexCount; ++v) {
+            if (borderGroup[group[v]]) {
+                locked[v] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (auto i = 0u; i < indexCount; i += 3) {
+        const auto& p0 = positions[result[i]];
+        auto n = glm::cross(positions[result[i + 1]] - p0, positions[result[i + 2]] - p0);
+        auto area = glm::length(n);
+        if (area > 0.f) {
+            n /= area;
+            Quadric q(n, -glm::dot(n, p0), area);
+            for (auto k = 0u; k < 3; ++k) {
+                quadrics[group[result[i + k]]] += q;
+            }
+        }
+    }
+
+    auto collapseError = [&](unsigned int from, unsigned int to) {
+        Quadric q = quadrics[group[from]];
+        q += quadrics[group[to]];
+        return q.w > 0. ? float(std::max(0., q.evaluate(positions[to]) / q.w)) : 0.f;
+    };
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned int> offsets, triangles;
+    std::vector<Collapse> collapses;
+
+    while (result.size() > targetIndexCount) {
+        buildTriangleAdjacency(result.data(), result.size(), vertexCount, offsets, triangles);
+
+        // Each interior edge is seen once per direction
+        collapses.clear();
+        for (auto i = 0u; i < result.size(); ++i) {
+            auto a = result[i];
+            auto b = result[i - i % 3 + (i + 1) % 3];
+            if (!locked[a]) {
+                collapses.push_back({ a, b, collapseError(a, b) });
+            }
+        }
+        if (collapses.empty()) {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+            return lhs.m_fError < rhs.m_fError;
+        });
+
+        for (auto v = 0u; v < vertexCount; ++v) {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        // A collapse removes two triangles on average: stop the pass when the target is reached
+        auto trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+
+        for (const auto& c: collapses) {
+            if (removed >= trianglesToRemove) {
+                break;
+            }
+            if (touched[c.m_nFrom] || touched[c.m_nTo]) {
+                continue;
+            }
+
+            // The triangles moving with the vertex must keep their orientation
+            auto flips = false;
+            auto sharedTriangles = 0u;
+            const auto& target = positions[c.m_nTo];
+            for (auto j = offsets[c.m_nFrom]; j < offsets[c.m_nFrom + 1] && !flips; ++j) {
+                auto t = &result[3 * triangles[j]];
+                if (t[0] == c.m_nTo || t[1] == c.m_nTo || t[2] == c.m_nTo) {
+                    ++sharedTriangles;
+                    continue;
+                }
+                glm::vec3 p[3] = { positions[t[0]], positions[t[1]], positions[t[2]] };
+                auto before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (auto k = 0u; k < 3; ++k) {
+                    if (t[k] == c.m_nFrom) {
+                        p[k] = target;
+                    }
+                }
+                auto after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                flips = glm::dot(before, after) <= 1e-2f * glm::length(before) * glm::length(after);
+            }
+            if (flips) {
+                continue;
+            }
+
+            remap[c.m_nFrom] = c.m_nTo;
+            quadrics[group[c.m_nTo]] += quadrics[group[c.m_nFrom]];
+            touched[c.m_nFrom] = touched[c.m_nTo] = true;
+            removed += sharedTriangles;
+            error = std::max(error, c.m_fError);
+        }
+        if (!removed) {
+            break;
+        }
+
+        auto count = 0u;
+        for (auto i = 0u; i < result.size(); i += 3) {
+            auto a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a != b && b != c && c != a) {
+                result[count++] = a;
+                result[count++] = b;
+                result[count++] = c;
+            }
+        }
+        result.resize(count);
+    }
+
+    error = std::sqrt(error);
+    std::copy(result.begin(), result.end(), destination);
+    return result.size();
+}
+
+}
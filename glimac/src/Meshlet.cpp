@@ -0,0 +1,140 @@
+#include "glimac/Meshlet.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace glimac {
+
+namespace {
+
+const glm::vec3& getPosition(const glm::vec3* positions, size_t stride, unsigned int index) {
+    return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const char*>(positions) + index * stride);
+}
+
+void computeBounds(Meshlet& meshlet, const unsigned int* indices, const glm::vec3* positions, size_t stride) {
+    auto first = indices + meshlet.m_nIndexOffset;
+
+    BBox3f box(getPosition(positions, stride, first[0]));
+    glm::vec3 normalSum(0.f);
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.m_nIndexCount / 3);
+
+    for (auto i = 0u; i < meshlet.m_nIndexCount; i += 3) {
+        const auto& p0 = getPosition(positions, stride, first[i]);
+        const auto& p1 = getPosition(positions, stride, first[i + 1]);
+        const auto& p2 = getPosition(positions, stride, first[i + 2]);
+        box.grow(p0);
+        box.grow(p1);
+        box.grow(p2);
+
+        auto n = glm::cross(p1 - p0, p2 - p0);
+        auto length = glm::length(n);
+        if (length > 0.f) {
+            normals.push_back(n / length);
+            normalSum += normals.back();
+        }
+    }
+
+    // The sphere of the box is centered well but too large: shrink it to the farthest vertex
+    boundingSphere(box, meshlet.m_Center, meshlet.m_fRadius);
+    auto radius2 = 0.f;
+    for (auto i = 0u; i < meshlet.m_nIndexCount; ++i) {
+        auto d = getPosition(positions, stride, first[i]) - meshlet.m_Center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.m_fRadius = std::min(meshlet.m_fRadius, std::sqrt(radius2));
+
+    // Never culled unless every normal is within ~84 degrees of the axis
+    meshlet.m_ConeAxis = glm::vec3(0.f, 0.f, 1.f);
+    meshlet.m_fConeCutoff = 1.f;
+
+    auto length = glm::length(normalSum);
+    if (length == 0.f) {
+        return;
+    }
+    auto axis = normalSum / length;
+    auto minDot = 1.f;
+    for (const auto& n: normals) {
+        minDot = std::min(minDot, glm::dot(n, axis));
+    }
+    if (minDot <= 0.1f) {
+        return;
+    }
+    meshlet.m_ConeAxis = axis;
+    meshlet.m_fConeCutoff = std::sqrt(1.f - minDot * minDot); // sin of the cone half angle
+}
+
+}
+
+void buildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t indexCount,
+                   unsigned int indexOffset, const glm::vec3* positions, size_t positionStride, size_t vertexCount,
+                   unsigned int maxVertices, unsigned int maxTriangles) {
+    // Index of the meshlet in which each vertex was last counted
+    std::vector<unsigned int> lastMeshlet(vertexCount, ~0u);
+
+    auto meshletId = unsigned(meshlets.size());
+    Meshlet current = {};
+    current.m_nIndexOffset = 0u;
+
+    auto flush = [&]() {
+        if (current.m_nIndexCount == 0u) {
+            return;
+        }
+        computeBounds(current, indices, positions, positionStride);
+        current.m_nIndexOffset += indexOffset;
+        meshlets.push_back(current);
+
+        current = Meshlet();
+        current.m_nIndexOffset = meshlets.back().m_nIndexOffset - indexOffset + meshlets.back().m_nIndexCount;
+        ++meshletId;
+    };
+
+    for (auto i = 0u; i + 2 < indexCount; i += 3) {
+        auto newVertices = 0u;
+        for (auto k = 0u; k < 3; ++k) {
+            auto v = indices[i + k];
+            if (lastMeshlet[v] != meshletId && (k < 1 || v != indices[i]) && (k < 2 || v != indices[i + 1])) {
+                ++newVertices;
+            }
+        }
+        if (current.m_nVertexCount + newVertices > maxVertices || current.m_nIndexCount / 3 + 1 > maxTriangles) {
+            flush();
+        }
+
+        for (auto k = 0u; k < 3; ++k) {
+            auto v = indices[i + k];
+            if (lastMeshlet[v] != meshletId) {
+                lastMeshlet[v] = meshletId;
+                ++current.m_nVertexCount;
+            }
+        }
+        current.m_nIndexCount += 3;
+    }
+    flush();
+}
+
+Frustum::Frustum(const glm::mat4& matrix) {
+    // Gribb & Hartmann: planes are sums and differences of the rows of the matrix
+    auto row = [&](int i) {
+        return glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+    };
+    m_Planes[0] = row(3) + row(0); // left
+    m_Planes[1] = row(3) - row(0); // right
+    m_Planes[2] = row(3) + row(1); // bottom
+    m_Planes[3] = row(3) - row(1); // top
+    m_Planes[4] = row(3) + row(2); // near
+    m_Planes[5] = row(3) - row(2); // far
+    for (auto& plane: m_Planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for (const auto& plane: m_Planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,302 @@
+#include "glimac/MipChain.hpp"
+#include "glimac/Parallel.hpp"
+#include "glimac/ImageKernels.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace glimac {
+
+namespace {
+
+const char MIP_FILE_MAGIC[4] = { 'G', 'M', 'I', 'P' };
+
+// Rows per thread: below, a level is filtered on the calling thread
+const size_t MIN_ROWS_PER_THREAD = 32;
+
+// Destination rows filtered together
+const size_t ROWS_PER_BAND = 32;
+
+float sinc(float x) {
+    if (std::abs(x) < 1e-6f) {
+        return 1.f;
+    }
+    x *= glm::pi<float>();
+    return std::sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0
+float besselI0(float x) {
+    float sum = 1.f, term = 1.f;
+    for (auto k = 1; k < 32 && term > sum * 1e-8f; ++k) {
+        term *= (x * x) / (4.f * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+float getFilterRadius(MipFilter filter) {
+    return filter == MipFilter::Box ? 0.5f : 3.f;
+}
+
+// Filter at t destination pixels from the center of the destination pixel
+float evaluateFilter(MipFilter filter, float t) {
+    t = std::abs(t);
+    switch (filter) {
+    case MipFilter::Box:
+        return t <= 0.5f ? 1.f : 0.f;
+    case MipFilter::Kaiser: {
+        const float alpha = 4.f, radius = 3.f;
+        if (t >= radius) {
+            return 0.f;
+        }
+        return sinc(t) * besselI0(alpha * std::sqrt(1.f - (t / radius) * (t / radius))) / besselI0(alpha);
+    }
+    case MipFilter::Lanczos:
+        return t < 3.f ? sinc(t) * sinc(t / 3.f) : 0.f;
+    }
+    return 0.f;
+}
+
+// Source pixels and weights of each destination pixel along one axis, indices clamped to the edges
+struct FilterTaps {
+    std::vector<unsigned int> m_Offsets; // First tap of each destination pixel in m_Indices / m_Weights
+    std::vector<unsigned int> m_Indices;
+    std::vector<float> m_Weights;
+
+    FilterTaps(MipFilter filter, unsigned int srcSize, unsigned int dstSize) {
+        auto scale = float(srcSize) / dstSize;
+        auto support = getFilterRadius(filter) * scale;
+        m_Offsets.reserve(dstSize + 1);
+        for (auto x = 0u; x < dstSize; ++x) {
+            m_Offsets.push_back(m_Indices.size());
+            auto center = (x + 0.5f) * scale - 0.5f;
+            auto first = int(std::floor(center - support)), last = int(std::ceil(center + support));
+            auto sum = 0.f;
+            auto firstTap = m_Weights.size();
+            for (auto i = first; i <= last; ++i) {
+                auto weight = evaluateFilter(filter, (i - center) / scale);
+                if (weight != 0.f) {
+                    m_Indices.push_back(unsigned(glm::clamp(i, 0, int(srcSize) - 1)));
+                    m_Weights.push_back(weight);
+                    sum += weight;
+                }
+            }
+            for (auto i = firstTap; i < m_Weights.size(); ++i) {
+                m_Weights[i] /= sum;
+            }
+        }
+        m_Offsets.push_back(m_Indices.size());
+    }
+};
+
+// out[i] += weight * in[i] on count RGBA pixels
+void accumulate(glm::vec4* out, const glm::vec4* in, float weight, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    auto vWeight = _mm_set1_ps(weight);
+    auto pOut = reinterpret_cast<float*>(out);
+    auto pIn = reinterpret_cast<const float*>(in);
+    for (; i < count; ++i) {
+        _mm_storeu_ps(pOut + 4 * i, _mm_add_ps(_mm_loadu_ps(pOut + 4 * i), _mm_mul_ps(vWeight, _mm_loadu_ps(pIn + 4 * i))));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] += weight * in[i];
+    }
+}
+
+// Horizontal pass of a row: each destination pixel is the weighted sum of its taps
+void filterRow(const glm::vec4* in, glm::vec4* out, const FilterTaps& taps, unsigned int dstWidth) {
+    for (auto x = 0u; x < dstWidth; ++x) {
+#ifdef __SSE2__
+        auto sum = _mm_setzero_ps();
+        for (auto t = taps.m_Offsets[x]; t < taps.m_Offsets[x + 1]; ++t) {
+            auto pixel = _mm_loadu_ps(reinterpret_cast<const float*>(in + taps.m_Indices[t]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.m_Weights[t]), pixel));
+        }
+        _mm_storeu_ps(reinterpret_cast<float*>(out + x), sum);
+#else
+        auto sum = glm::vec4(0.f);
+        for (auto t = taps.m_Offsets[x]; t < taps.m_Offsets[x + 1]; ++t) {
+            sum += taps.m_Weights[t] * in[taps.m_Indices[t]];
+        }
+        out[x] = sum;
+#endif
+    }
+}
+
+// Row y of image as linear RGBA floats, decoded with the image kernels for the 8 bits RGBA formats
+const glm::vec4* readRow(const Image& image, unsigned int y, glm::vec4* buffer) {
+    auto width = image.getWidth();
+    auto pRow = image.getData() + size_t(y) * width * getPixelSize(image.getFormat());
+    switch (image.getFormat()) {
+    case PixelFormat::RGBA32F:
+        return image.getPixels() + size_t(y) * width;
+    case PixelFormat::RGBA8:
+        unorm8ToFloat(pRow, &buffer->x, 4 * size_t(width));
+        return buffer;
+    case PixelFormat::SRGB8_A8:
+        srgb8ToLinear(pRow, &buffer->x, width);
+        return buffer;
+    default:
+        for (auto x = 0u; x < width; ++x) {
+            buffer[x] = image.getPixel(x, y);
+        }
+        return buffer;
+    }
+}
+
+// Linear RGBA32F level half the size of src, filtered separably (rows, then columns). Threads filter
+// bands of destination rows, from the horizontally filtered source rows of the band only: the
+// intermediate rows stay in cache and the few rows shared by two bands are filtered twice.
+std::unique_ptr<Image> downsample(const Image& src, MipFilter filter) {
+    auto srcWidth = src.getWidth(), srcHeight = src.getHeight();
+    auto dstWidth = std::max(1u, srcWidth / 2), dstHeight = std::max(1u, srcHeight / 2);
+    FilterTaps horizontalTaps(filter, srcWidth, dstWidth), verticalTaps(filter, srcHeight, dstHeight);
+
+    std::unique_ptr<Image> pDst(new Image(dstWidth, dstHeight, PixelFormat::RGBA32F));
+    auto pOut = pDst->getPixels();
+    parallelFor(dstHeight, [&](size_t begin, size_t end) {
+        std::vector<glm::vec4> srcRow(srcWidth), rows;
+        for (auto bandBegin = begin; bandBegin < end; bandBegin += ROWS_PER_BAND) {
+            auto bandEnd = std::min(end, bandBegin + ROWS_PER_BAND);
+            auto first = *std::min_element(verticalTaps.m_Indices.begin() + verticalTaps.m_Offsets[bandBegin],
+                                           verticalTaps.m_Indices.begin() + verticalTaps.m_Offsets[bandEnd]);
+            auto last = *std::max_element(verticalTaps.m_Indices.begin() + verticalTaps.m_Offsets[bandBegin],
+                                          verticalTaps.m_Indices.begin() + verticalTaps.m_Offsets[bandEnd]);
+            rows.resize(size_t(last - first + 1) * dstWidth);
+            for (auto y = first; y <= last; ++y) {
+                filterRow(readRow(src, y, srcRow.data()), rows.data() + size_t(y - first) * dstWidth, horizontalTaps, dstWidth);
+            }
+
+            for (auto y = bandBegin; y < bandEnd; ++y) {
+                auto pRow = pOut + y * dstWidth;
+                std::fill(pRow, pRow + dstWidth, glm::vec4(0.f));
+                for (auto t = verticalTaps.m_Offsets[y]; t < verticalTaps.m_Offsets[y + 1]; ++t) {
+                    accumulate(pRow, rows.data() + size_t(verticalTaps.m_Indices[t] - first) * dstWidth,
+                               verticalTaps.m_Weights[t], dstWidth);
+                }
+            }
+        }
+    }, MIN_ROWS_PER_THREAD);
+    return pDst;
+}
+
+}
+
+unsigned int getMipLevelCount(unsigned int width, unsigned int height) {
+    auto count = 1u;
+    for (auto size = std::max(width, height); size > 1u; size /= 2) {
+        ++count;
+    }
+    return count;
+}
+
+MipChain generateMipChain(const Image& image, MipFilter filter) {
+    MipChain mips;
+    auto levelCount = getMipLevelCount(image.getWidth(), image.getHeight());
+    mips.reserve(levelCount - 1);
+
+    // The chain is filtered in floats: no requantization between levels
+    std::unique_ptr<Image> pLinear;
+    const Image* pPrevious = &image;
+
+    for (auto level = 1u; level < levelCount; ++level) {
+        auto pLevel = downsample(*pPrevious, filter);
+        pPrevious = pLevel.get();
+        if (image.getFormat() == PixelFormat::RGBA32F) {
+            mips.push_back(std::move(pLevel));
+        } else {
+            mips.push_back(pLevel->convert(image.getFormat()));
+            pLinear = std::move(pLevel);
+        }
+    }
+    return mips;
+}
+
+void uploadMipChain(GLenum target, const Image& image, const MipChain& mips) {
+    uploadImage(target, image, 0);
+    for (auto level = 0u; level < mips.size(); ++level) {
+        uploadImage(target, *mips[level], level + 1);
+    }
+}
+
+bool saveMipChain(const FilePath& filepath, const Image& image, MipFilter filter, const MipChain& mips) {
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open " << filepath << " for writing" << std::endl;
+        return false;
+    }
+
+    uint64_t hash = computeImageHash(image);
+    uint32_t header[3] = { uint32_t(filter), uint32_t(image.getFormat()), uint32_t(mips.size()) };
+    file.write(MIP_FILE_MAGIC, sizeof(MIP_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& pLevel: mips) {
+        file.write(reinterpret_cast<const char*>(pLevel->getData()), pLevel->getDataSize());
+    }
+
+    return bool(file);
+}
+
+bool loadMipChain(const FilePath& filepath, const Image& image, MipFilter filter, MipChain& mips) {
+    std::ifstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    char magic[4];
+    uint64_t hash;
+    uint32_t header[3];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || !std::equal(magic, magic + 4, MIP_FILE_MAGIC)) {
+        std::cerr << filepath << " is not a mip chain file" << std::endl;
+        return false;
+    }
+    if (header[0] != uint32_t(filter) || header[1] != uint32_t(image.getFormat())
+            || header[2] + 1 != getMipLevelCount(image.getWidth(), image.getHeight()) || hash != computeImageHash(image)) {
+        std::clog << filepath << " is out of date" << std::endl;
+        return false;
+    }
+
+    MipChain levels;
+    auto width = image.getWidth(), height = image.getHeight();
+    for (auto level = 0u; level < header[2]; ++level) {
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        levels.emplace_back(new Image(width, height, image.getFormat()));
+        file.read(reinterpret_cast<char*>(levels.back()->getData()), levels.back()->getDataSize());
+    }
+    if (!file) {
+        std::cerr << filepath << " is truncated" << std::endl;
+        return false;
+    }
+
+    mips = std::move(levels);
+    return true;
+}
+
+FilePath getMipCachePath(const FilePath& imagePath) {
+    return imagePath.addExt(".mips");
+}
+
+MipChain loadOrGenerateMipChain(const FilePath& imagePath, const Image& image, MipFilter filter) {
+    MipChain mips;
+    auto cachePath = getMipCachePath(imagePath);
+    if (!loadMipChain(cachePath, image, filter, mips)) {
+        mips = generateMipChain(image, filter);
+        saveMipChain(cachePath, image, filter, mips);
+    }
+    return mips;
+}
+
+}
@@ -0,0 +1,154 @@
+#include "glimac/ShapeRegistry.hpp"
+#include "glimac/Sphere.hpp"
+#include "glimac/Cone.hpp"
+#include "glimac/VertexAttributes.hpp"
+#include <algorithm>
+
+namespace glimac {
+
+namespace {
+
+enum ShapeType {
+    SHAPE_SPHERE,
+    SHAPE_CONE
+};
+
+}
+
+ShapeRegistry::~ShapeRegistry() {
+    glDeleteVertexArrays(1, &m_nVAO);
+    glDeleteBuffers(1, &m_nVBO);
+    glDeleteBuffers(1, &m_nIBO);
+}
+
+void ShapeRegistry::addLevel(const IndexedShape& shape, GLsizei segmentCount) {
+    Level level;
+    level.m_nBaseVertex = m_Vertices.size();
+    level.m_nFirstIndex = m_Indices.size();
+    level.m_nIndexCount = shape.getIndexCount();
+    level.m_nSegmentCount = segmentCount;
+    m_Levels.push_back(level);
+
+    m_Vertices.insert(end(m_Vertices), shape.getVertexPointer(), shape.getVertexPointer() + shape.getVertexCount());
+    for (auto i = 0; i < shape.getIndexCount(); ++i) {
+        m_Indices.push_back(shape.getIndex(i));
+    }
+    m_nMaxLevelVertexCount = std::max(m_nMaxLevelVertexCount, shape.getVertexCount());
+    m_bDirty = true;
+}
+
+ShapeRegistry::ShapeId ShapeRegistry::getSphere(GLfloat radius, GLsizei discLat, GLsizei discLong, unsigned int levelCount) {
+    auto key = ShapeKey(SHAPE_SPHERE, radius, 0.f, discLat, discLong, levelCount);
+    auto it = m_ShapeMap.find(key);
+    if (it != end(m_ShapeMap)) {
+        return it->second;
+    }
+
+    Shape shape = { unsigned(m_Levels.size()), 0u, radius };
+    for (auto i = 0u; i < std::max(levelCount, 1u); ++i) {
+        addLevel(Sphere::buildIndexed(radius, discLat, discLong), discLat);
+        ++shape.m_nLevelCount;
+        if (discLat <= 4 || discLong <= 2) {
+            break;
+        }
+        discLat = std::max(discLat / 2, 4);
+        discLong = std::max(discLong / 2, 2);
+    }
+
+    m_Shapes.push_back(shape);
+    return m_ShapeMap[key] = m_Shapes.size() - 1;
+}
+
+ShapeRegistry::ShapeId ShapeRegistry::getCone(GLfloat height, GLfloat radius, GLsizei discLat, GLsizei discHeight, unsigned int levelCount) {
+    auto key = ShapeKey(SHAPE_CONE, height, radius, discLat, discHeight, levelCount);
+    auto it = m_ShapeMap.find(key);
+    if (it != end(m_ShapeMap)) {
+        return it->second;
+    }
+
+    // The base is centered on the origin
+    Shape shape = { unsigned(m_Levels.size()), 0u, std::max(height, radius) };
+    for (auto i = 0u; i < std::max(levelCount, 1u); ++i) {
+        addLevel(Cone::buildIndexed(height, radius, discLat, discHeight), discLat);
+        ++shape.m_nLevelCount;
+        if (discLat <= 4 && discHeight <= 1) {
+            break;
+        }
+        discLat = std::max(discLat / 2, 4);
+        discHeight = std::max(discHeight / 2, 1);
+    }
+
+    m_Shapes.push_back(shape);
+    return m_ShapeMap[key] = m_Shapes.size() - 1;
+}
+
+unsigned int ShapeRegistry::selectLevel(ShapeId shapeId, const glm::mat4& projMatrix, const glm::mat4& mvMatrix,
+                                        float viewportHeight, float maxEdgeLength) const {
+    const auto& shape = m_Shapes[shapeId];
+
+    auto scale = std::max(glm::length(glm::vec3(mvMatrix[0])), std::max(glm::length(glm::vec3(mvMatrix[1])), glm::length(glm::vec3(mvMatrix[2]))));
+    auto radius = shape.m_fRadius * scale;
+    auto distance = -mvMatrix[3].z;
+    if (distance <= radius) {
+        return 0u; // Camera inside the bounding sphere
+    }
+
+    // Projected radius in pixels, edges of the silhouette are 2 PI radius / segments long
+    auto projectedRadius = radius * projMatrix[1][1] * 0.5f * viewportHeight / distance;
+    for (auto level = shape.m_nLevelCount; level-- > 1u; ) {
+        auto segmentCount = m_Levels[shape.m_nFirstLevel + level].m_nSegmentCount;
+        if (2.f * glm::pi<float>() * projectedRadius / segmentCount <= maxEdgeLength) {
+            return level;
+        }
+    }
+    return 0u;
+}
+
+void ShapeRegistry::upload() {
+    if (!m_nVAO) {
+        glGenVertexArrays(1, &m_nVAO);
+        glGenBuffers(1, &m_nVBO);
+        glGenBuffers(1, &m_nIBO);
+
+        glBindVertexArray(m_nVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_nVBO);
+        setShapeVertexAttribPointers(m_nPositionLocation, m_nNormalLocation, m_nTexCoordsLocation);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_nIBO);
+    } else {
+        glBindVertexArray(m_nVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_nVBO);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(ShapeVertex), m_Vertices.data(), GL_STATIC_DRAW);
+
+    // Local indices fit in 16 bits unless a level has more than 65536 vertices
+    if (m_nMaxLevelVertexCount <= 65536) {
+        m_IndexType = GL_UNSIGNED_SHORT;
+        std::vector<GLushort> indices(begin(m_Indices), end(m_Indices));
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    } else {
+        m_IndexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(GLuint), m_Indices.data(), GL_STATIC_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_bDirty = false;
+}
+
+void ShapeRegistry::bind() {
+    if (m_bDirty) {
+        upload(); // Leaves the VAO bound
+    } else {
+        glBindVertexArray(m_nVAO);
+    }
+}
+
+void ShapeRegistry::draw(ShapeId shapeId, unsigned int level) const {
+    const auto& shape = m_Shapes[shapeId];
+    const auto& l = m_Levels[shape.m_nFirstLevel + std::min(level, shape.m_nLevelCount - 1)];
+    auto indexSize = m_IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    glDrawElementsBaseVertex(GL_TRIANGLES, l.m_nIndexCount, m_IndexType,
+                             (const GLvoid*) (l.m_nFirstIndex * indexSize), l.m_nBaseVertex);
+}
+
+}
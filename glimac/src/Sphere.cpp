@@ -6,7 +6,7 @@
 
 namespace glimac {
 
-void Sphere::build(GLfloat r, GLsizei discLat, GLsizei discLong) {
+IndexedShape Sphere::buildIndexed(GLfloat r, GLsizei discLat, GLsizei discLong) {
     // Equation paramétrique en (r, phi, theta) de la sphère 
     // avec r >= 0, -PI / 2 <= theta <= PI / 2, 0 <= phi <= 2PI
     //
@@ -22,52 +22,37 @@ void Sphere::build(GLfloat r, GLsizei discLat, GLsizei discLong) {
     // z(r, i, j) = r * cos(i * dPhi) * cos(-PI / 2 + j * dTheta)
 
     GLfloat rcpLat = 1.f / discLat, rcpLong = 1.f / discLong;
-    GLfloat dPhi = 2 * glm::pi<float>() * rcpLat, dTheta = glm::pi<float>() * rcpLong;
-    
-    std::vector<ShapeVertex> data;
-    
-    // Construit l'ensemble des vertex
+    GLfloat dTheta = glm::pi<float>() * rcpLong;
+
+    // sin(phi) et cos(phi) ne dépendent que de la colonne: calculés une seule fois pour toutes les bandes
+    std::vector<GLfloat> sinPhi(discLat + 1), cosPhi(discLat + 1);
+    computeSinCosTable(discLat, sinPhi.data(), cosPhi.data());
+
+    // Construit l'ensemble des vertex, bande par bande, directement dans le tableau alloué.
+    // La colonne i = discLat double la colonne i = 0 avec texCoords.x = 1: même position et
+    // même normale (la table reprend phi = 0) pour ne pas créer de fissure
+    std::vector<ShapeVertex> data((discLat + 1) * (discLong + 1));
     for(GLsizei j = 0; j <= discLong; ++j) {
         GLfloat cosTheta = cos(-glm::pi<float>() / 2 + j * dTheta);
         GLfloat sinTheta = sin(-glm::pi<float>() / 2 + j * dTheta);
-        
-        for(GLsizei i = 0; i <= discLat; ++i) {
-            ShapeVertex vertex;
-            
-            vertex.texCoords.x = i * rcpLat;
-            vertex.texCoords.y = 1.f - j * rcpLong;
 
-            vertex.normal.x = sin(i * dPhi) * cosTheta;
-            vertex.normal.y = sinTheta;
-            vertex.normal.z = cos(i * dPhi) * cosTheta;
-            
-            vertex.position = r * vertex.normal;
-            
-            data.push_back(vertex);
-        }
+        // normal = (sin(phi) cos(theta), sin(theta), cos(phi) cos(theta)), position = r * normal
+        buildRing(&data[j * (discLat + 1)], sinPhi.data(), cosPhi.data(), discLat + 1, rcpLat,
+                  r * cosTheta, r * sinTheta, cosTheta, sinTheta, 1.f - j * rcpLong);
     }
 
-    m_nVertexCount = discLat * discLong * 6;
-    
-    GLuint idx = 0;
-    // Construit les vertex finaux en regroupant les données en triangles:
+    // Regroupe les vertex en triangles:
     // Pour une longitude donnée, les deux triangles formant une face sont de la forme:
-    // (i, i + 1, i + discLat + 1), (i, i + discLat + 1, i + discLat)
+    // (i, i + 1, i + discLat + 2), (i, i + discLat + 2, i + discLat + 1)
     // avec i sur la bande correspondant à la longitude
-    for(GLsizei j = 0; j < discLong; ++j) {
-        GLsizei offset = j * (discLat + 1);
-        for(GLsizei i = 0; i < discLat; ++i) {
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + (i + 1)]);
-            m_Vertices.push_back(data[offset + discLat + 1 + (i + 1)]);
-            m_Vertices.push_back(data[offset + i]);
-            m_Vertices.push_back(data[offset + discLat + 1 + (i + 1)]);
-            m_Vertices.push_back(data[offset + i + discLat + 1]);
-        }
-    }
-    
-    // Attention ! dans cette implantation on duplique beaucoup de sommets. Une meilleur stratégie est de passer
-    // par un Index Buffer Object, que nous verrons dans les prochains TDs
+    return IndexedShape::makeGrid(std::move(data), discLat, discLong);
+}
+
+void Sphere::build(GLfloat r, GLsizei discLat, GLsizei discLong) {
+    // Chaque sommet est dupliqué pour chacun des triangles qui l'utilisent (environ 6 fois):
+    // buildIndexed() donne les sommets partagés et un Index Buffer Object
+    m_Vertices = buildIndexed(r, discLat, discLong).expand();
+    m_nVertexCount = m_Vertices.size();
 }
 
 }
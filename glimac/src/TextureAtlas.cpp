@@ -0,0 +1,230 @@
+#include "glimac/TextureAtlas.hpp"
+#include "glimac/MipChain.hpp"
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <climits>
+#include <cstring>
+
+namespace glimac {
+
+SkylinePacker::SkylinePacker(unsigned int width, unsigned int height):
+    m_nWidth(width), m_nHeight(height), m_Skyline(1, Segment { 0u, 0u, width }) {
+}
+
+bool SkylinePacker::insert(unsigned int width, unsigned int height, glm::uvec2& position) {
+    auto bestIndex = m_Skyline.size();
+    auto bestY = UINT_MAX, bestWidth = UINT_MAX;
+    for (auto i = 0u; i < m_Skyline.size(); ++i) {
+        auto x = m_Skyline[i].m_nX;
+        if (x + width > m_nWidth) {
+            break;
+        }
+        // The rectangle rests on the highest segment under [x, x + width)
+        auto y = 0u;
+        for (auto j = i, covered = 0u; covered < width; covered += m_Skyline[j].m_nWidth, ++j) {
+            y = std::max(y, m_Skyline[j].m_nY);
+        }
+        if (y + height > m_nHeight) {
+            continue;
+        }
+        // Lowest top first, then the narrowest segment to keep the wide ones for wide rectangles
+        if (y < bestY || (y == bestY && m_Skyline[i].m_nWidth < bestWidth)) {
+            bestIndex = i;
+            bestY = y;
+            bestWidth = m_Skyline[i].m_nWidth;
+        }
+    }
+    if (bestIndex == m_Skyline.size()) {
+        return false;
+    }
+
+    position = glm::uvec2(m_Skyline[bestIndex].m_nX, bestY);
+
+    // The segments under the rectangle are replaced by its top
+    auto end = position.x + width;
+    auto it = m_Skyline.begin() + bestIndex;
+    while (it != m_Skyline.end() && it->m_nX < end) {
+        auto segmentEnd = it->m_nX + it->m_nWidth;
+        if (segmentEnd > end) {
+            it->m_nX = end;
+            it->m_nWidth = segmentEnd - end;
+            break;
+        }
+        it = m_Skyline.erase(it);
+    }
+    m_Skyline.insert(it, Segment { position.x, bestY + height, width });
+    for (auto i = 0u; i + 1 < m_Skyline.size();) {
+        if (m_Skyline[i].m_nY == m_Skyline[i + 1].m_nY) {
+            m_Skyline[i].m_nWidth += m_Skyline[i + 1].m_nWidth;
+            m_Skyline.erase(m_Skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    m_nUsedArea += size_t(width) * height;
+    return true;
+}
+
+float SkylinePacker::getOccupancy() const {
+    return float(m_nUsedArea) / (float(m_nWidth) * m_nHeight);
+}
+
+bool TextureAtlas::build(const std::vector<const Image*>& images, unsigned int maxPageSize,
+                         unsigned int padding, unsigned int mipLevelCount) {
+    m_bPacked = false;
+    m_nLevelCount = 1u;
+    m_Regions.clear();
+    m_Pages.clear();
+    m_Layers.clear();
+    if (images.empty()) {
+        return true;
+    }
+
+    // Images of a same size and format: one layer each
+    const auto& first = *images[0];
+    auto sameLayout = std::all_of(images.begin(), images.end(), [&first](const Image* pImage) {
+        return pImage->getWidth() == first.getWidth() && pImage->getHeight() == first.getHeight()
+            && pImage->getFormat() == first.getFormat();
+    });
+    if (sameLayout) {
+        for (auto i = 0u; i < images.size(); ++i) {
+            m_Layers.push_back(images[i]);
+            m_Regions.push_back(AtlasRegion { i, glm::vec2(0.f), glm::vec2(1.f) });
+        }
+        m_nLevelCount = getMipLevelCount(first.getWidth(), first.getHeight());
+        return true;
+    }
+
+    // Rectangles of the images with their gutter, aligned on the texels of level mipLevelCount - 1
+    mipLevelCount = std::max(1u, mipLevelCount);
+    auto alignment = 1u << (mipLevelCount - 1);
+    auto gutter = std::max(padding, alignment);
+    auto roundUp = [alignment](unsigned int value) {
+        return (value + alignment - 1) / alignment * alignment;
+    };
+    std::vector<glm::uvec2> sizes;
+    size_t area = 0u;
+    auto largest = 0u;
+    for (auto i = 0u; i < images.size(); ++i) {
+        sizes.emplace_back(roundUp(images[i]->getWidth() + 2 * gutter), roundUp(images[i]->getHeight() + 2 * gutter));
+        area += size_t(sizes.back().x) * sizes.back().y;
+        largest = std::max(largest, std::max(sizes.back().x, sizes.back().y));
+        if (largest > maxPageSize) {
+            std::cerr << "Image " << i << " of " << images[i]->getWidth() << "x" << images[i]->getHeight()
+                      << " does not fit in atlas pages of " << maxPageSize << "x" << maxPageSize << std::endl;
+            return false;
+        }
+    }
+
+    // Tallest first, the usual order for skylines
+    std::vector<size_t> order(images.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+        return sizes[a].y > sizes[b].y || (sizes[a].y == sizes[b].y && sizes[a].x > sizes[b].x);
+    });
+
+    // Starting from the smallest power of two that could hold everything, doubled until a single page
+    // is enough or pages reach maxPageSize
+    auto pageSize = 1u;
+    while (pageSize < largest || size_t(pageSize) * pageSize < area) {
+        pageSize *= 2;
+    }
+    pageSize = std::min(pageSize, maxPageSize);
+    std::vector<glm::uvec2> positions(images.size());
+    std::vector<unsigned int> pages(images.size());
+    std::vector<SkylinePacker> packers;
+    for (;;) {
+        packers.assign(1, SkylinePacker(pageSize, pageSize));
+        for (auto i: order) {
+            auto page = 0u;
+            while (page < packers.size() && !packers[page].insert(sizes[i].x, sizes[i].y, positions[i])) {
+                ++page;
+            }
+            if (page == packers.size()) {
+                packers.emplace_back(pageSize, pageSize);
+                packers.back().insert(sizes[i].x, sizes[i].y, positions[i]);
+            }
+            pages[i] = page;
+        }
+        if (packers.size() == 1 || pageSize >= maxPageSize) {
+            break;
+        }
+        pageSize = std::min(2 * pageSize, maxPageSize);
+    }
+
+    auto format = first.getFormat();
+    if (!std::all_of(images.begin(), images.end(), [format](const Image* pImage) { return pImage->getFormat() == format; })) {
+        format = PixelFormat::RGBA8;
+    }
+    auto pixelSize = getPixelSize(format);
+    for (auto page = 0u; page < packers.size(); ++page) {
+        m_Pages.emplace_back(new Image(pageSize, pageSize, format));
+        std::memset(m_Pages.back()->getData(), 0, m_Pages.back()->getDataSize());
+        m_Layers.push_back(m_Pages.back().get());
+    }
+
+    for (auto i = 0u; i < images.size(); ++i) {
+        std::unique_ptr<Image> pConverted;
+        if (images[i]->getFormat() != format) {
+            pConverted = images[i]->convert(format);
+        }
+        const auto& image = pConverted ? *pConverted : *images[i];
+        auto width = image.getWidth(), height = image.getHeight();
+
+        // The gutter repeats the edges of the image, as GL_CLAMP_TO_EDGE would
+        auto pPage = m_Pages[pages[i]].get();
+        for (auto y = 0u; y < sizes[i].y; ++y) {
+            auto sourceY = unsigned(std::min<int>(std::max<int>(int(y) - int(gutter), 0), int(height) - 1));
+            auto pSource = image.getData() + size_t(sourceY) * width * pixelSize;
+            auto pDestination = pPage->getData() + (size_t(positions[i].y + y) * pageSize + positions[i].x) * pixelSize;
+            for (auto x = 0u; x < gutter; ++x) {
+                std::memcpy(pDestination + x * pixelSize, pSource, pixelSize);
+            }
+            std::memcpy(pDestination + gutter * pixelSize, pSource, width * pixelSize);
+            for (auto x = gutter + width; x < sizes[i].x; ++x) {
+                std::memcpy(pDestination + x * pixelSize, pSource + (width - 1) * pixelSize, pixelSize);
+            }
+        }
+
+        auto offset = glm::vec2(positions[i]) + glm::vec2(float(gutter));
+        m_Regions.push_back(AtlasRegion { pages[i], offset / float(pageSize),
+                                          glm::vec2(width, height) / float(pageSize) });
+    }
+
+    std::clog << "Atlas of " << images.size() << " images: " << packers.size() << " pages of "
+              << pageSize << "x" << pageSize << ", " << int(100.f * packers[0].getOccupancy()) << "% of the first one used"
+              << std::endl;
+
+    m_bPacked = true;
+    m_nLevelCount = std::min(mipLevelCount, getMipLevelCount(pageSize, pageSize));
+    return true;
+}
+
+void TextureAtlas::upload() const {
+    if (m_Layers.empty()) {
+        return;
+    }
+    const auto& first = *m_Layers[0];
+    auto format = first.getFormat();
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, m_nLevelCount, getGLInternalFormat(format), first.getWidth(), first.getHeight(),
+                   GLsizei(m_Layers.size()));
+
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (auto layer = 0u; layer < m_Layers.size(); ++layer) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, first.getWidth(), first.getHeight(), 1,
+                        getGLFormat(format), getGLType(format), m_Layers[layer]->getData());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_nLevelCount - 1);
+    if (m_nLevelCount > 1) {
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+}
+
+}
@@ -0,0 +1,390 @@
+#include "glimac/TextureContainer.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace glimac {
+
+struct TextureContainer::Header {
+    char m_Magic[4];
+    uint32_t m_nVersion;
+    uint32_t m_nCompressed;
+    uint32_t m_nFormat; // PixelFormat or CompressedFormat
+    uint32_t m_nSRGB;
+    uint32_t m_nWidth;
+    uint32_t m_nHeight;
+    uint32_t m_nLevelCount;
+    uint32_t m_nFaceCount;
+    uint32_t m_nReserved;
+};
+
+struct TextureContainer::Entry {
+    uint64_t m_nOffset;
+    uint64_t m_nSize;
+};
+
+namespace {
+
+const char CONTAINER_FILE_MAGIC[4] = { 'G', 'T', 'E', 'X' };
+
+const uint32_t CONTAINER_VERSION = 1;
+
+// Of the data of each entry: enough for any pixel format and for SSE loads of the levels
+const uint64_t CONTAINER_ALIGNMENT = 16;
+
+size_t getLevelSize(bool compressed, uint32_t format, unsigned int width, unsigned int height) {
+    if (compressed) {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(CompressedFormat(format));
+    }
+    return size_t(width) * height * getPixelSize(PixelFormat(format));
+}
+
+// Writes the header, the table and the data of levels sorted as in the container
+bool writeContainer(const FilePath& filepath, bool compressed, uint32_t format, bool sRGB,
+                    unsigned int width, unsigned int height, unsigned int faceCount,
+                    const std::vector<std::pair<const uint8_t*, size_t>>& levels) {
+    if (levels.empty() || (faceCount != 1 && faceCount != 6) || levels.size() % faceCount) {
+        std::cerr << "Unable to write " << filepath << ": expected levels of 1 or 6 faces" << std::endl;
+        return false;
+    }
+    auto levelCount = unsigned(levels.size() / faceCount);
+    if (levelCount > getMipLevelCount(width, height)) {
+        std::cerr << "Unable to write " << filepath << ": too many levels" << std::endl;
+        return false;
+    }
+    for (auto level = 0u; level < levelCount; ++level) {
+        auto expectedSize = getLevelSize(compressed, format, std::max(1u, width >> level), std::max(1u, height >> level));
+        for (auto face = 0u; face < faceCount; ++face) {
+            if (levels[level * faceCount + face].second != expectedSize) {
+                std::cerr << "Unable to write " << filepath << ": level " << level << " of face " << face
+                          << " does not have the size or the format of level 0" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open " << filepath << " for writing" << std::endl;
+        return false;
+    }
+
+    auto align = [](uint64_t offset) {
+        return (offset + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT;
+    };
+    std::vector<uint64_t> table;
+    auto offset = align(sizeof(uint32_t) * 10 + levels.size() * 2 * sizeof(uint64_t));
+    for (const auto& level: levels) {
+        table.push_back(offset);
+        table.push_back(level.second);
+        offset = align(offset + level.second);
+    }
+
+    uint32_t header[9] = { CONTAINER_VERSION, uint32_t(compressed), format, uint32_t(sRGB),
+                           width, height, levelCount, faceCount, 0u };
+    file.write(CONTAINER_FILE_MAGIC, sizeof(CONTAINER_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint64_t));
+    const char padding[CONTAINER_ALIGNMENT] = {};
+    for (auto i = 0u; i < levels.size(); ++i) {
+        file.write(padding, std::streamsize(table[2 * i] - uint64_t(file.tellp())));
+        file.write(reinterpret_cast<const char*>(levels[i].first), levels[i].second);
+    }
+
+    return bool(file);
+}
+
+// Modification time, 0 if the file does not exist
+time_t getModificationTime(const FilePath& filepath) {
+    struct stat status;
+    return stat(filepath.c_str(), &status) == 0 ? status.st_mtime : 0;
+}
+
+}
+
+std::shared_ptr<const TextureContainer> TextureContainer::open(const FilePath& filepath) {
+    static_assert(sizeof(Header) == 10 * sizeof(uint32_t), "the header is written as 10 uint32_t");
+
+    // The mapping is private and writable: pixels written through an Image of the container
+    // are copied on write, never written to the file
+    std::shared_ptr<TextureContainer> pContainer(new TextureContainer);
+#ifdef _WIN32
+    auto hFile = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    pContainer->m_hFile = hFile;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart < LONGLONG(sizeof(Header))) {
+        std::cerr << filepath << " is not a texture container" << std::endl;
+        return nullptr;
+    }
+    pContainer->m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!pContainer->m_hMapping) {
+        std::cerr << "Unable to map " << filepath << std::endl;
+        return nullptr;
+    }
+    pContainer->m_pMapping = static_cast<const uint8_t*>(MapViewOfFile(pContainer->m_hMapping, FILE_MAP_COPY, 0, 0, 0));
+    pContainer->m_nMappingSize = size_t(size.QuadPart);
+#else
+    auto fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || size_t(status.st_size) < sizeof(Header)) {
+        ::close(fd);
+        std::cerr << filepath << " is not a texture container" << std::endl;
+        return nullptr;
+    }
+    // The mapping stays valid once the file is closed
+    auto mapping = mmap(nullptr, size_t(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping != MAP_FAILED) {
+        pContainer->m_pMapping = static_cast<const uint8_t*>(mapping);
+        pContainer->m_nMappingSize = size_t(status.st_size);
+    }
+#endif
+    if (!pContainer->m_pMapping) {
+        std::cerr << "Unable to map " << filepath << std::endl;
+        return nullptr;
+    }
+
+    const auto& header = *reinterpret_cast<const Header*>(pContainer->m_pMapping);
+    if (!std::equal(header.m_Magic, header.m_Magic + 4, CONTAINER_FILE_MAGIC)) {
+        std::cerr << filepath << " is not a texture container" << std::endl;
+        return nullptr;
+    }
+    auto maxFormat = header.m_nCompressed ? uint32_t(CompressedFormat::ETC2_RGB) : uint32_t(PixelFormat::RGBA32F);
+    if (header.m_nVersion != CONTAINER_VERSION || header.m_nFormat > maxFormat
+            || (header.m_nFaceCount != 1 && header.m_nFaceCount != 6) || !header.m_nLevelCount
+            || header.m_nLevelCount > getMipLevelCount(header.m_nWidth, header.m_nHeight)) {
+        std::cerr << filepath << " has an unsupported version or format" << std::endl;
+        return nullptr;
+    }
+    auto entryCount = size_t(header.m_nLevelCount) * header.m_nFaceCount;
+    if (pContainer->m_nMappingSize < sizeof(Header) + entryCount * sizeof(Entry)) {
+        std::cerr << filepath << " is truncated" << std::endl;
+        return nullptr;
+    }
+    for (auto level = 0u; level < header.m_nLevelCount; ++level) {
+        auto size = getLevelSize(header.m_nCompressed != 0, header.m_nFormat, pContainer->getWidth(level),
+                                 pContainer->getHeight(level));
+        for (auto face = 0u; face < header.m_nFaceCount; ++face) {
+            const auto& entry = pContainer->getEntry(level, face);
+            if (entry.m_nSize != size || entry.m_nOffset % CONTAINER_ALIGNMENT
+                    || entry.m_nOffset > pContainer->m_nMappingSize
+                    || entry.m_nSize > pContainer->m_nMappingSize - entry.m_nOffset) {
+                std::cerr << filepath << " is truncated" << std::endl;
+                return nullptr;
+            }
+        }
+    }
+
+    return pContainer;
+}
+
+TextureContainer::~TextureContainer() {
+#ifdef _WIN32
+    if (m_pMapping) {
+        UnmapViewOfFile(m_pMapping);
+    }
+    if (m_hMapping) {
+        CloseHandle(m_hMapping);
+    }
+    if (m_hFile) {
+        CloseHandle(m_hFile);
+    }
+#else
+    if (m_pMapping) {
+        munmap(const_cast<uint8_t*>(m_pMapping), m_nMappingSize);
+    }
+#endif
+}
+
+unsigned int TextureContainer::getWidth(unsigned int level) const {
+    return std::max(1u, reinterpret_cast<const Header*>(m_pMapping)->m_nWidth >> level);
+}
+
+unsigned int TextureContainer::getHeight(unsigned int level) const {
+    return std::max(1u, reinterpret_cast<const Header*>(m_pMapping)->m_nHeight >> level);
+}
+
+unsigned int TextureContainer::getLevelCount() const {
+    return reinterpret_cast<const Header*>(m_pMapping)->m_nLevelCount;
+}
+
+unsigned int TextureContainer::getFaceCount() const {
+    return reinterpret_cast<const Header*>(m_pMapping)->m_nFaceCount;
+}
+
+bool TextureContainer::isCompressed() const {
+    return reinterpret_cast<const Header*>(m_pMapping)->m_nCompressed != 0;
+}
+
+PixelFormat TextureContainer::getPixelFormat() const {
+    return PixelFormat(reinterpret_cast<const Header*>(m_pMapping)->m_nFormat);
+}
+
+CompressedFormat TextureContainer::getCompressedFormat() const {
+    return CompressedFormat(reinterpret_cast<const Header*>(m_pMapping)->m_nFormat);
+}
+
+bool TextureContainer::isSRGB() const {
+    return reinterpret_cast<const Header*>(m_pMapping)->m_nSRGB != 0;
+}
+
+const TextureContainer::Entry& TextureContainer::getEntry(unsigned int level, unsigned int face) const {
+    auto entries = reinterpret_cast<const Entry*>(m_pMapping + sizeof(Header));
+    return entries[level * getFaceCount() + face];
+}
+
+const uint8_t* TextureContainer::getData(unsigned int level, unsigned int face) const {
+    return m_pMapping + getEntry(level, face).m_nOffset;
+}
+
+size_t TextureContainer::getDataSize(unsigned int level, unsigned int face) const {
+    return size_t(getEntry(level, face).m_nSize);
+}
+
+void TextureContainer::uploadFace(GLenum target, unsigned int face) const {
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (auto level = 0u; level < getLevelCount(); ++level) {
+        if (isCompressed()) {
+            glCompressedTexImage2D(target, level, getGLInternalFormat(getCompressedFormat(), isSRGB()),
+                                   getWidth(level), getHeight(level), 0,
+                                   GLsizei(getDataSize(level, face)), getData(level, face));
+        } else {
+            glTexImage2D(target, level, getGLInternalFormat(getPixelFormat()), getWidth(level), getHeight(level), 0,
+                         getGLFormat(getPixelFormat()), getGLType(getPixelFormat()), getData(level, face));
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+void TextureContainer::upload(GLenum target) const {
+    if (getFaceCount() == 1) {
+        uploadFace(target, 0);
+        return;
+    }
+    for (auto face = 0u; face < getFaceCount(); ++face) {
+        uploadFace(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, face);
+    }
+}
+
+std::unique_ptr<Image> TextureContainer::getImage(unsigned int face) const {
+    if (isCompressed()) {
+        return nullptr;
+    }
+    return std::unique_ptr<Image>(new Image(shared_from_this(), face));
+}
+
+bool saveTextureContainer(const FilePath& filepath, const std::vector<const Image*>& levels, unsigned int faceCount) {
+    if (levels.empty()) {
+        std::cerr << "Unable to write " << filepath << ": no level" << std::endl;
+        return false;
+    }
+    std::vector<std::pair<const uint8_t*, size_t>> data;
+    for (auto pLevel: levels) {
+        if (pLevel->getFormat() != levels[0]->getFormat()) {
+            std::cerr << "Unable to write " << filepath << ": levels of different formats" << std::endl;
+            return false;
+        }
+        data.emplace_back(pLevel->getData(), pLevel->getDataSize());
+    }
+    return writeContainer(filepath, false, uint32_t(levels[0]->getFormat()), false,
+                          levels[0]->getWidth(), levels[0]->getHeight(), faceCount, data);
+}
+
+bool saveTextureContainer(const FilePath& filepath, const std::vector<const CompressedImage*>& levels,
+                          unsigned int faceCount) {
+    if (levels.empty()) {
+        std::cerr << "Unable to write " << filepath << ": no level" << std::endl;
+        return false;
+    }
+    std::vector<std::pair<const uint8_t*, size_t>> data;
+    for (auto pLevel: levels) {
+        if (pLevel->getFormat() != levels[0]->getFormat() || pLevel->isSRGB() != levels[0]->isSRGB()) {
+            std::cerr << "Unable to write " << filepath << ": levels of different formats" << std::endl;
+            return false;
+        }
+        data.emplace_back(pLevel->getData(), pLevel->getDataSize());
+    }
+    return writeContainer(filepath, true, uint32_t(levels[0]->getFormat()), levels[0]->isSRGB(),
+                          levels[0]->getWidth(), levels[0]->getHeight(), faceCount, data);
+}
+
+bool bakeTextureContainer(const FilePath& filepath, const std::vector<const Image*>& faces, MipFilter filter) {
+    std::vector<MipChain> mips;
+    for (auto pFace: faces) {
+        mips.push_back(generateMipChain(*pFace, filter));
+    }
+    std::vector<const Image*> levels(faces);
+    for (auto level = 0u; !faces.empty() && level < mips[0].size(); ++level) {
+        for (const auto& chain: mips) {
+            if (level >= chain.size()) {
+                std::cerr << "Unable to write " << filepath << ": faces of different sizes" << std::endl;
+                return false;
+            }
+            levels.push_back(chain[level].get());
+        }
+    }
+    return saveTextureContainer(filepath, levels, unsigned(faces.size()));
+}
+
+bool bakeTextureContainer(const FilePath& filepath, const std::vector<const Image*>& faces, CompressedFormat format,
+                          CompressionQuality quality, MipFilter filter) {
+    std::vector<std::unique_ptr<CompressedImage>> compressed;
+    std::vector<MipChain> mips;
+    for (auto pFace: faces) {
+        compressed.push_back(compressImage(*pFace, format, quality));
+        mips.push_back(generateMipChain(*pFace, filter));
+    }
+    for (auto level = 0u; !faces.empty() && level < mips[0].size(); ++level) {
+        for (const auto& chain: mips) {
+            if (level >= chain.size()) {
+                std::cerr << "Unable to write " << filepath << ": faces of different sizes" << std::endl;
+                return false;
+            }
+            compressed.push_back(compressImage(*chain[level], format, quality));
+        }
+    }
+    std::vector<const CompressedImage*> levels;
+    for (const auto& pLevel: compressed) {
+        levels.push_back(pLevel.get());
+    }
+    return saveTextureContainer(filepath, levels, unsigned(faces.size()));
+}
+
+FilePath getTextureContainerPath(const FilePath& imagePath) {
+    return imagePath.addExt(".gtex");
+}
+
+std::unique_ptr<Image> loadTextureContainerImage(const FilePath& imagePath, PixelFormat format) {
+    auto containerPath = getTextureContainerPath(imagePath);
+    auto pContainer = TextureContainer::open(containerPath);
+    if (!pContainer || pContainer->isCompressed() || pContainer->getPixelFormat() != format) {
+        return nullptr;
+    }
+    // A source edited since the container was baked wins over it
+    if (getModificationTime(imagePath) > getModificationTime(containerPath)) {
+        std::clog << containerPath << " is out of date" << std::endl;
+        return nullptr;
+    }
+    return pContainer->getImage(0);
+}
+
+}
@@ -0,0 +1,191 @@
+#include "glimac/TextureStreamer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace glimac {
+
+namespace {
+
+// Cube map faces are uploaded to their own target but bound as GL_TEXTURE_CUBE_MAP
+GLenum getBindingTarget(GLenum target) {
+    if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) {
+        return GL_TEXTURE_CUBE_MAP;
+    }
+    return target;
+}
+
+}
+
+TextureStreamer::TextureStreamer(unsigned int slotCount, size_t slotSize):
+    m_nSlotSize(slotSize), m_Slots(std::max(1u, slotCount)) {
+    for (auto& slot: m_Slots) {
+        glGenBuffers(1, &slot.m_nBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_nBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, m_nSlotSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer() {
+    for (auto& slot: m_Slots) {
+        if (slot.m_Fence) {
+            glDeleteSync(slot.m_Fence);
+        }
+        glDeleteBuffers(1, &slot.m_nBuffer);
+    }
+}
+
+void TextureStreamer::enqueue(GLuint texture, GLenum target, GLint level, ImageHandle pImage,
+                              std::function<void()> onComplete) {
+    auto format = pImage->getFormat();
+    Upload upload;
+    upload.m_nTexture = texture;
+    upload.m_Target = target;
+    upload.m_nLevel = level;
+    upload.m_pData = pImage->getData();
+    upload.m_nWidth = pImage->getWidth();
+    upload.m_nHeight = pImage->getHeight();
+    upload.m_nRowHeight = 1u;
+    upload.m_nRowSize = size_t(pImage->getWidth()) * getPixelSize(format);
+    upload.m_bCompressed = false;
+    upload.m_Format = getGLFormat(format);
+    upload.m_Type = getGLType(format);
+    upload.m_nNextRow = 0u;
+    upload.m_OnComplete = std::move(onComplete);
+    upload.m_pOwner = std::move(pImage);
+    enqueue(std::move(upload));
+}
+
+void TextureStreamer::enqueue(GLuint texture, GLenum target, GLint level, std::shared_ptr<const CompressedImage> pImage,
+                              std::function<void()> onComplete) {
+    Upload upload;
+    upload.m_nTexture = texture;
+    upload.m_Target = target;
+    upload.m_nLevel = level;
+    upload.m_pData = pImage->getData();
+    upload.m_nWidth = pImage->getWidth();
+    upload.m_nHeight = pImage->getHeight();
+    upload.m_nRowHeight = 4u;
+    upload.m_nRowSize = pImage->getBlockCountX() * getBlockSize(pImage->getFormat());
+    upload.m_bCompressed = true;
+    upload.m_Format = getGLInternalFormat(pImage->getFormat(), pImage->isSRGB());
+    upload.m_Type = GL_NONE;
+    upload.m_nNextRow = 0u;
+    upload.m_OnComplete = std::move(onComplete);
+    upload.m_pOwner = std::move(pImage);
+    enqueue(std::move(upload));
+}
+
+void TextureStreamer::enqueue(Upload upload) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Queue.push_back(std::move(upload));
+}
+
+size_t TextureStreamer::getPendingUploadCount() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Queue.size();
+}
+
+size_t TextureStreamer::issueBand(Upload& upload, Slot& slot) {
+    auto rowCount = (upload.m_nHeight + upload.m_nRowHeight - 1) / upload.m_nRowHeight;
+    auto bandRowCount = std::min<size_t>(rowCount - upload.m_nNextRow, std::max<size_t>(1u, m_nSlotSize / upload.m_nRowSize));
+    auto size = bandRowCount * upload.m_nRowSize;
+    auto pSource = upload.m_pData + upload.m_nNextRow * upload.m_nRowSize;
+
+    // Pixels read from the buffer of the slot, or from client memory when a row does not fit in it
+    // or it can't be mapped
+    const void* pPixels = pSource;
+    void* pMapped = nullptr;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_nBuffer);
+    if (size <= m_nSlotSize) {
+        // The fence of the slot was signaled: nothing reads the buffer anymore
+        pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+    if (pMapped) {
+        std::memcpy(pMapped, pSource, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        pPixels = nullptr; // Offset 0 in the buffer
+    } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    auto y = upload.m_nNextRow * upload.m_nRowHeight;
+    auto height = std::min<size_t>(bandRowCount * upload.m_nRowHeight, upload.m_nHeight - y);
+    glBindTexture(getBindingTarget(upload.m_Target), upload.m_nTexture);
+    if (upload.m_bCompressed) {
+        glCompressedTexSubImage2D(upload.m_Target, upload.m_nLevel, 0, y, upload.m_nWidth, GLsizei(height),
+                                  upload.m_Format, GLsizei(size), pPixels);
+    } else {
+        glTexSubImage2D(upload.m_Target, upload.m_nLevel, 0, y, upload.m_nWidth, GLsizei(height),
+                        upload.m_Format, upload.m_Type, pPixels);
+    }
+    if (pMapped) {
+        slot.m_Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    upload.m_nNextRow += unsigned(bandRowCount);
+    return size;
+}
+
+size_t TextureStreamer::update(float timeBudget) {
+    auto start = std::chrono::steady_clock::now();
+    auto getElapsedTime = [start]() {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    size_t issuedSize = 0u;
+    std::vector<std::function<void()>> completed;
+    for (auto bandCount = 0u; bandCount == 0u || getElapsedTime() < timeBudget; ++bandCount) {
+        auto& slot = m_Slots[m_nNextSlot];
+        if (slot.m_Fence) {
+            // Slots are reused in order: if the oldest one is still read, so are the others
+            if (glClientWaitSync(slot.m_Fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                break;
+            }
+            glDeleteSync(slot.m_Fence);
+            slot.m_Fence = nullptr;
+        }
+
+        // The upload in progress leaves the queue while its band is issued, so that enqueue() never
+        // waits for a copy
+        Upload upload;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Queue.empty()) {
+                break;
+            }
+            upload = std::move(m_Queue.front());
+            m_Queue.pop_front();
+        }
+
+        auto rowCount = (upload.m_nHeight + upload.m_nRowHeight - 1) / upload.m_nRowHeight;
+        if (upload.m_nNextRow < rowCount) {
+            issuedSize += issueBand(upload, slot);
+            m_nNextSlot = (m_nNextSlot + 1) % m_Slots.size();
+        }
+
+        if (upload.m_nNextRow < rowCount) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Queue.push_front(std::move(upload));
+        } else if (upload.m_OnComplete) {
+            completed.push_back(std::move(upload.m_OnComplete));
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    for (const auto& onComplete: completed) {
+        onComplete();
+    }
+    return issuedSize;
+}
+
+}
@@ -0,0 +1,48 @@
+#include "glimac/ThreadPool.hpp"
+#include <algorithm>
+
+namespace glimac {
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0u) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_Threads.reserve(threadCount);
+    for (auto i = 0u; i < threadCount; ++i) {
+        m_Threads.emplace_back([this]() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_Condition.wait(lock, [this]() {
+                        return m_bStop || !m_Tasks.empty();
+                    });
+                    if (m_Tasks.empty()) {
+                        return; // Stopped and nothing left to do
+                    }
+                    task = std::move(m_Tasks.front());
+                    m_Tasks.pop_front();
+                }
+                task();
+            }
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+    }
+    m_Condition.notify_all();
+    for (auto& thread: m_Threads) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::getInstance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}
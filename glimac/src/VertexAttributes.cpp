@@ -0,0 +1,42 @@
+#include "glimac/VertexAttributes.hpp"
+#include <cstddef>
+
+namespace glimac {
+
+void setShapeVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation) {
+    glEnableVertexAttribArray(positionLocation);
+    glEnableVertexAttribArray(normalLocation);
+    glEnableVertexAttribArray(texCoordsLocation);
+    glVertexAttribPointer(positionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex),
+                          (const GLvoid*) offsetof(ShapeVertex, position));
+    glVertexAttribPointer(normalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex),
+                          (const GLvoid*) offsetof(ShapeVertex, normal));
+    glVertexAttribPointer(texCoordsLocation, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex),
+                          (const GLvoid*) offsetof(ShapeVertex, texCoords));
+}
+
+void setPackedVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation) {
+    glEnableVertexAttribArray(positionLocation);
+    glEnableVertexAttribArray(normalLocation);
+    glEnableVertexAttribArray(texCoordsLocation);
+    glVertexAttribPointer(positionLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (const GLvoid*) offsetof(PackedVertex, m_Position));
+    glVertexAttribPointer(normalLocation, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                          (const GLvoid*) offsetof(PackedVertex, m_Normal));
+    glVertexAttribPointer(texCoordsLocation, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                          (const GLvoid*) offsetof(PackedVertex, m_TexCoords));
+}
+
+void setCompactVertexAttribPointers(GLuint positionLocation, GLuint normalLocation, GLuint texCoordsLocation) {
+    glEnableVertexAttribArray(positionLocation);
+    glEnableVertexAttribArray(normalLocation);
+    glEnableVertexAttribArray(texCoordsLocation);
+    glVertexAttribPointer(positionLocation, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex),
+                          (const GLvoid*) offsetof(CompactVertex, m_Position));
+    glVertexAttribPointer(normalLocation, 2, GL_BYTE, GL_TRUE, sizeof(CompactVertex),
+                          (const GLvoid*) offsetof(CompactVertex, m_Normal));
+    glVertexAttribPointer(texCoordsLocation, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex),
+                          (const GLvoid*) offsetof(CompactVertex, m_TexCoords));
+}
+
+}
@@ -0,0 +1,188 @@
+#include "glimac/VertexStreams.hpp"
+#include <limits>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace glimac {
+
+namespace {
+
+const glm::vec3& attribute(const void* vertices, size_t stride, size_t offset, size_t i) {
+    return *reinterpret_cast<const glm::vec3*>(static_cast<const char*>(vertices) + i * stride + offset);
+}
+
+glm::vec3& attribute(void* vertices, size_t stride, size_t offset, size_t i) {
+    return *reinterpret_cast<glm::vec3*>(static_cast<char*>(vertices) + i * stride + offset);
+}
+
+BBox3f emptyBox() {
+    auto inf = std::numeric_limits<float>::infinity();
+    return BBox3f(glm::vec3(inf), glm::vec3(-inf));
+}
+
+}
+
+void VertexStreams::gather(const void* vertices, size_t stride, size_t positionOffset, size_t normalOffset, size_t count) {
+    resize(count);
+    for (auto i = 0u; i < count; ++i) {
+        const auto& p = attribute(vertices, stride, positionOffset, i);
+        const auto& n = attribute(vertices, stride, normalOffset, i);
+        m_PositionX[i] = p.x; m_PositionY[i] = p.y; m_PositionZ[i] = p.z;
+        m_NormalX[i] = n.x; m_NormalY[i] = n.y; m_NormalZ[i] = n.z;
+    }
+}
+
+void VertexStreams::scatter(void* vertices, size_t stride, size_t positionOffset, size_t normalOffset) const {
+    for (auto i = 0u; i < size(); ++i) {
+        attribute(vertices, stride, positionOffset, i) = glm::vec3(m_PositionX[i], m_PositionY[i], m_PositionZ[i]);
+        attribute(vertices, stride, normalOffset, i) = glm::vec3(m_NormalX[i], m_NormalY[i], m_NormalZ[i]);
+    }
+}
+
+void transformPoints(const glm::mat4& matrix, const float* x, const float* y, const float* z,
+                     float* outX, float* outY, float* outZ, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128 m[4][3];
+    for (auto c = 0u; c < 4; ++c) {
+        for (auto r = 0u; r < 3; ++r) {
+            m[c][r] = _mm_set1_ps(matrix[c][r]);
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        auto px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        __m128 result[3];
+        for (auto r = 0u; r < 3; ++r) {
+            result[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], px), _mm_mul_ps(m[1][r], py)),
+                                   _mm_add_ps(_mm_mul_ps(m[2][r], pz), m[3][r]));
+        }
+        _mm_storeu_ps(outX + i, result[0]);
+        _mm_storeu_ps(outY + i, result[1]);
+        _mm_storeu_ps(outZ + i, result[2]);
+    }
+#endif
+    for (; i < count; ++i) {
+        auto p = glm::vec3(matrix * glm::vec4(x[i], y[i], z[i], 1.f));
+        outX[i] = p.x; outY[i] = p.y; outZ[i] = p.z;
+    }
+}
+
+void transformVectors(const glm::mat3& matrix, const float* x, const float* y, const float* z,
+                      float* outX, float* outY, float* outZ, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128 m[3][3];
+    for (auto c = 0u; c < 3; ++c) {
+        for (auto r = 0u; r < 3; ++r) {
+            m[c][r] = _mm_set1_ps(matrix[c][r]);
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        auto vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 result[3];
+        for (auto r = 0u; r < 3; ++r) {
+            result[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], vx), _mm_mul_ps(m[1][r], vy)), _mm_mul_ps(m[2][r], vz));
+        }
+        _mm_storeu_ps(outX + i, result[0]);
+        _mm_storeu_ps(outY + i, result[1]);
+        _mm_storeu_ps(outZ + i, result[2]);
+    }
+#endif
+    for (; i < count; ++i) {
+        auto v = matrix * glm::vec3(x[i], y[i], z[i]);
+        outX[i] = v.x; outY[i] = v.y; outZ[i] = v.z;
+    }
+}
+
+void normalizeVectors(float* x, float* y, float* z, size_t count) {
+    size_t i = 0;
+#ifdef __SSE2__
+    auto zero = _mm_setzero_ps();
+    auto one = _mm_set1_ps(1.f);
+    for (; i + 4 <= count; i += 4) {
+        auto vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        auto length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+        // Null vectors are left as they are
+        auto nonZero = _mm_cmpgt_ps(length, zero);
+        auto scale = _mm_or_ps(_mm_and_ps(nonZero, _mm_div_ps(one, length)), _mm_andnot_ps(nonZero, one));
+        _mm_storeu_ps(x + i, _mm_mul_ps(vx, scale));
+        _mm_storeu_ps(y + i, _mm_mul_ps(vy, scale));
+        _mm_storeu_ps(z + i, _mm_mul_ps(vz, scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        auto length = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        if (length > 0.f) {
+            x[i] /= length; y[i] /= length; z[i] /= length;
+        }
+    }
+}
+
+BBox3f computeBounds(const float* x, const float* y, const float* z, size_t count) {
+    auto box = emptyBox();
+    size_t i = 0;
+#ifdef __SSE2__
+    if (count >= 4) {
+        auto lowerX = _mm_loadu_ps(x), upperX = lowerX;
+        auto lowerY = _mm_loadu_ps(y), upperY = lowerY;
+        auto lowerZ = _mm_loadu_ps(z), upperZ = lowerZ;
+        for (i = 4; i + 4 <= count; i += 4) {
+            auto px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+            lowerX = _mm_min_ps(lowerX, px); upperX = _mm_max_ps(upperX, px);
+            lowerY = _mm_min_ps(lowerY, py); upperY = _mm_max_ps(upperY, py);
+            lowerZ = _mm_min_ps(lowerZ, pz); upperZ = _mm_max_ps(upperZ, pz);
+        }
+        alignas(16) float lanes[6][4];
+        _mm_store_ps(lanes[0], lowerX); _mm_store_ps(lanes[1], lowerY); _mm_store_ps(lanes[2], lowerZ);
+        _mm_store_ps(lanes[3], upperX); _mm_store_ps(lanes[4], upperY); _mm_store_ps(lanes[5], upperZ);
+        for (auto l = 0u; l < 4; ++l) {
+            box.grow(BBox3f(glm::vec3(lanes[0][l], lanes[1][l], lanes[2][l]), glm::vec3(lanes[3][l], lanes[4][l], lanes[5][l])));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        box.grow(glm::vec3(x[i], y[i], z[i]));
+    }
+    return box;
+}
+
+BBox3f computeBounds(const glm::vec3* positions, size_t stride, size_t count) {
+    auto box = emptyBox();
+    size_t i = 0;
+#ifdef __SSE2__
+    // One position per instruction: the 4th lane reads the next float of the vertex and is ignored,
+    // so the last position is done without SSE in case nothing follows it
+    if (stride >= 4 * sizeof(float) && count > 1) {
+        auto bytes = reinterpret_cast<const char*>(positions);
+        auto lower = _mm_loadu_ps(reinterpret_cast<const float*>(bytes)), upper = lower;
+        for (i = 1; i + 1 < count; ++i) {
+            auto p = _mm_loadu_ps(reinterpret_cast<const float*>(bytes + i * stride));
+            lower = _mm_min_ps(lower, p);
+            upper = _mm_max_ps(upper, p);
+        }
+        alignas(16) float lanes[2][4];
+        _mm_store_ps(lanes[0], lower);
+        _mm_store_ps(lanes[1], upper);
+        box = BBox3f(glm::vec3(lanes[0][0], lanes[0][1], lanes[0][2]), glm::vec3(lanes[1][0], lanes[1][1], lanes[1][2]));
+    }
+#endif
+    for (; i < count; ++i) {
+        box.grow(attribute(positions, stride, 0, i));
+    }
+    return box;
+}
+
+void transform(VertexStreams& streams, const glm::mat4& matrix) {
+    auto count = streams.size();
+    transformPoints(matrix, streams.m_PositionX.data(), streams.m_PositionY.data(), streams.m_PositionZ.data(),
+                    streams.m_PositionX.data(), streams.m_PositionY.data(), streams.m_PositionZ.data(), count);
+    transformVectors(glm::transpose(glm::inverse(glm::mat3(matrix))),
+                     streams.m_NormalX.data(), streams.m_NormalY.data(), streams.m_NormalZ.data(),
+                     streams.m_NormalX.data(), streams.m_NormalY.data(), streams.m_NormalZ.data(), count);
+    normalizeVectors(streams.m_NormalX.data(), streams.m_NormalY.data(), streams.m_NormalZ.data(), count);
+}
+
+}
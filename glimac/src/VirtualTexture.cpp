@@ -0,0 +1,482 @@
+#include "glimac/VirtualTexture.hpp"
+#include "glimac/MipChain.hpp"
+#include <iostream>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace glimac {
+
+namespace {
+
+const char TILE_FILE_MAGIC[4] = { 'G', 'V', 'T', 'X' };
+
+const uint32_t TILE_FILE_VERSION = 1;
+
+// Magic, then version, format, width, height, tile size, border, level count and a reserved uint32_t
+const size_t TILE_FILE_HEADER_SIZE = sizeof(TILE_FILE_MAGIC) + 8 * sizeof(uint32_t);
+
+// Modification time, 0 if the file does not exist
+time_t getModificationTime(const FilePath& filepath) {
+    struct stat status;
+    return stat(filepath.c_str(), &status) == 0 ? status.st_mtime : 0;
+}
+
+}
+
+VirtualTextureLayout::VirtualTextureLayout(unsigned int width, unsigned int height, unsigned int tileSize,
+                                           unsigned int border):
+    m_nWidth(width), m_nHeight(height), m_nTileSize(std::max(1u, tileSize)), m_nBorder(border) {
+    while (m_nPageTableWidth < getTileCountX(0)) {
+        m_nPageTableWidth *= 2;
+    }
+    while (m_nPageTableHeight < getTileCountY(0)) {
+        m_nPageTableHeight *= 2;
+    }
+    // One level per level of the page table: the tile counts of the last one are 1x1
+    auto levelCount = getMipLevelCount(m_nPageTableWidth, m_nPageTableHeight);
+    m_LevelOffsets.assign(1, 0u);
+    for (auto level = 0u; level < levelCount; ++level) {
+        m_LevelOffsets.push_back(m_LevelOffsets.back() + size_t(getTileCountX(level)) * getTileCountY(level));
+    }
+}
+
+unsigned int VirtualTextureLayout::getTileCountX(unsigned int level) const {
+    return (std::max(1u, m_nWidth >> level) + m_nTileSize - 1) / m_nTileSize;
+}
+
+unsigned int VirtualTextureLayout::getTileCountY(unsigned int level) const {
+    return (std::max(1u, m_nHeight >> level) + m_nTileSize - 1) / m_nTileSize;
+}
+
+TileResidency::TileResidency(const VirtualTextureLayout& layout, unsigned int slotCountX, unsigned int slotCountY):
+    m_Layout(layout),
+    m_nSlotCountX(std::min(256u, std::max(1u, slotCountX))),
+    m_nSlotCountY(std::min(256u, std::max(1u, slotCountY))),
+    m_TileSlots(layout.getTileCount(), -1),
+    m_TileRequestFrames(layout.getTileCount(), 0u),
+    m_SlotTiles(m_nSlotCountX * m_nSlotCountY, TileId { ~0u, 0u, 0u }),
+    m_LRUPositions(m_SlotTiles.size()) {
+    for (auto slot = 1u; slot < m_SlotTiles.size(); ++slot) {
+        m_LRUPositions[slot] = m_LRUSlots.insert(m_LRUSlots.end(), slot);
+    }
+
+    auto lastLevel = layout.getLevelCount() - 1;
+    TileId root { lastLevel, 0u, 0u };
+    m_TileSlots[layout.getTileIndex(root)] = 0;
+    m_SlotTiles[0] = root;
+
+    // Everything starts on the tile of the last level, the padding of the page table included
+    const uint8_t rootEntry[4] = { 0u, 0u, uint8_t(lastLevel), 255u };
+    for (auto level = 0u; level < layout.getLevelCount(); ++level) {
+        m_PageTable.emplace_back(size_t(layout.getPageTableWidth(level)) * layout.getPageTableHeight(level) * 4);
+        for (size_t i = 0u; i < m_PageTable.back().size(); i += 4) {
+            std::memcpy(&m_PageTable.back()[i], rootEntry, 4);
+        }
+        m_DirtyRows.emplace_back(0u, layout.getPageTableHeight(level));
+    }
+}
+
+TileId TileResidency::getParent(const TileId& tile) const {
+    auto level = tile.m_nLevel + 1;
+    return TileId { level, std::min(tile.m_nX / 2, m_Layout.getTileCountX(level) - 1),
+                    std::min(tile.m_nY / 2, m_Layout.getTileCountY(level) - 1) };
+}
+
+void TileResidency::request(const TileId& tile) {
+    auto lastLevel = m_Layout.getLevelCount() - 1;
+    for (auto current = tile;; current = getParent(current)) {
+        auto index = m_Layout.getTileIndex(current);
+        // Its ancestors were requested with it
+        if (m_TileRequestFrames[index] == m_nFrame) {
+            return;
+        }
+        m_TileRequestFrames[index] = m_nFrame;
+
+        auto slot = m_TileSlots[index];
+        if (slot > 0) {
+            m_LRUSlots.splice(m_LRUSlots.end(), m_LRUSlots, m_LRUPositions[slot]);
+        } else if (slot < 0) {
+            m_MissingTiles.push_back(current);
+        }
+        if (current.m_nLevel == lastLevel) {
+            return;
+        }
+    }
+}
+
+void TileResidency::requestFeedback(const uint8_t* pPixels, size_t pixelCount) {
+    for (size_t i = 0u; i < pixelCount; ++i) {
+        auto pPixel = pPixels + 4 * i;
+        // Neighbouring pixels mostly see the same tile
+        if (!pPixel[3] || (i > 0 && std::memcmp(pPixel, pPixel - 4, 4) == 0)) {
+            continue;
+        }
+        TileId tile { pPixel[3] - 1u, pPixel[0] | (pPixel[2] & 15u) << 8, pPixel[1] | unsigned(pPixel[2] >> 4) << 8 };
+        if (tile.m_nLevel < m_Layout.getLevelCount() && tile.m_nX < m_Layout.getTileCountX(tile.m_nLevel)
+            && tile.m_nY < m_Layout.getTileCountY(tile.m_nLevel)) {
+            request(tile);
+        }
+    }
+}
+
+std::vector<TileLoad> TileResidency::update(unsigned int maxLoadCount) {
+    // Coarsest first: they are the fallback of the finer ones
+    std::stable_sort(m_MissingTiles.begin(), m_MissingTiles.end(), [](const TileId& a, const TileId& b) {
+        return a.m_nLevel > b.m_nLevel;
+    });
+
+    std::vector<TileLoad> loads;
+    for (const auto& tile: m_MissingTiles) {
+        if (loads.size() >= maxLoadCount || m_LRUSlots.empty()) {
+            break;
+        }
+        auto slot = m_LRUSlots.front();
+        auto evicted = m_SlotTiles[slot];
+        if (evicted.m_nLevel != ~0u) {
+            auto evictedIndex = m_Layout.getTileIndex(evicted);
+            // The least recently requested tile is on screen: so are all the others
+            if (m_TileRequestFrames[evictedIndex] == m_nFrame) {
+                break;
+            }
+            m_TileSlots[evictedIndex] = -1;
+            uint8_t parentEntry[4];
+            std::memcpy(parentEntry, getEntry(getParent(evicted)), 4);
+            setEntry(evicted, parentEntry);
+        }
+
+        m_TileSlots[m_Layout.getTileIndex(tile)] = int(slot);
+        m_SlotTiles[slot] = tile;
+        m_LRUSlots.splice(m_LRUSlots.end(), m_LRUSlots, m_LRUPositions[slot]);
+        const uint8_t entry[4] = { uint8_t(slot % m_nSlotCountX), uint8_t(slot / m_nSlotCountX), uint8_t(tile.m_nLevel), 255u };
+        setEntry(tile, entry);
+        loads.push_back(TileLoad { tile, slot });
+    }
+
+    m_nMissingTileCount = m_MissingTiles.size() - loads.size();
+    m_MissingTiles.clear();
+    ++m_nFrame;
+    return loads;
+}
+
+void TileResidency::setEntry(const TileId& tile, const uint8_t entry[4]) {
+    std::memcpy(getEntry(tile), entry, 4);
+    auto& dirtyRows = m_DirtyRows[tile.m_nLevel];
+    if (dirtyRows.first >= dirtyRows.second) {
+        dirtyRows = std::make_pair(tile.m_nY, tile.m_nY + 1);
+    } else {
+        dirtyRows = std::make_pair(std::min(dirtyRows.first, tile.m_nY), std::max(dirtyRows.second, tile.m_nY + 1));
+    }
+    if (tile.m_nLevel == 0) {
+        return;
+    }
+
+    // Children are the tiles whose parent is this one: the last tiles of a level may have 3 per side
+    auto level = tile.m_nLevel - 1;
+    auto lastX = tile.m_nX + 1 == m_Layout.getTileCountX(tile.m_nLevel);
+    auto lastY = tile.m_nY + 1 == m_Layout.getTileCountY(tile.m_nLevel);
+    auto endX = lastX ? m_Layout.getTileCountX(level) : std::min(2 * tile.m_nX + 2, m_Layout.getTileCountX(level));
+    auto endY = lastY ? m_Layout.getTileCountY(level) : std::min(2 * tile.m_nY + 2, m_Layout.getTileCountY(level));
+    for (auto y = 2 * tile.m_nY; y < endY; ++y) {
+        for (auto x = 2 * tile.m_nX; x < endX; ++x) {
+            TileId child { level, x, y };
+            // A resident child is its own entry and the one of its descendants
+            if (m_TileSlots[m_Layout.getTileIndex(child)] < 0) {
+                setEntry(child, entry);
+            }
+        }
+    }
+}
+
+bool TileResidency::getDirtyRows(unsigned int level, unsigned int& begin, unsigned int& end) const {
+    begin = m_DirtyRows[level].first;
+    end = m_DirtyRows[level].second;
+    return begin < end;
+}
+
+void TileResidency::clearDirtyRows() {
+    for (auto& dirtyRows: m_DirtyRows) {
+        dirtyRows = std::make_pair(0u, 0u);
+    }
+}
+
+bool VirtualTextureFile::open(const FilePath& filepath) {
+    m_File.close();
+    m_File.clear();
+    m_File.open(filepath.c_str(), std::ios::binary);
+    if (!m_File) {
+        std::cerr << "Unable to open " << filepath << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(TILE_FILE_MAGIC)];
+    uint32_t header[8];
+    m_File.read(magic, sizeof(magic));
+    m_File.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!m_File || std::memcmp(magic, TILE_FILE_MAGIC, sizeof(magic)) != 0 || header[0] != TILE_FILE_VERSION
+        || header[1] > uint32_t(PixelFormat::RGBA32F)) {
+        std::cerr << filepath << " is not a virtual texture tile file" << std::endl;
+        return false;
+    }
+    m_Format = PixelFormat(header[1]);
+    m_Layout = VirtualTextureLayout(header[2], header[3], header[4], header[5]);
+
+    m_File.seekg(0, std::ios::end);
+    if (header[6] != m_Layout.getLevelCount()
+        || uint64_t(m_File.tellg()) != TILE_FILE_HEADER_SIZE + uint64_t(m_Layout.getTileCount()) * getTileDataSize()) {
+        std::cerr << filepath << " is truncated or does not match its header" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t VirtualTextureFile::getTileDataSize() const {
+    return size_t(m_Layout.getPhysicalTileSize()) * m_Layout.getPhysicalTileSize() * getPixelSize(m_Format);
+}
+
+bool VirtualTextureFile::readTile(const TileId& tile, uint8_t* pData) {
+    m_File.clear();
+    m_File.seekg(std::streamoff(TILE_FILE_HEADER_SIZE + uint64_t(m_Layout.getTileIndex(tile)) * getTileDataSize()));
+    m_File.read(reinterpret_cast<char*>(pData), std::streamsize(getTileDataSize()));
+    if (!m_File) {
+        std::cerr << "Unable to read tile (" << tile.m_nX << ", " << tile.m_nY << ") of level " << tile.m_nLevel
+                  << " of a virtual texture" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool bakeVirtualTexture(const FilePath& filepath, const Image& image, unsigned int tileSize, unsigned int border) {
+    VirtualTextureLayout layout(image.getWidth(), image.getHeight(), tileSize, border);
+    auto mips = generateMipChain(image);
+
+    std::ofstream file(filepath.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Unable to open " << filepath << " for writing" << std::endl;
+        return false;
+    }
+    uint32_t header[8] = { TILE_FILE_VERSION, uint32_t(image.getFormat()), image.getWidth(), image.getHeight(),
+                           layout.getTileSize(), layout.getBorder(), layout.getLevelCount(), 0u };
+    file.write(TILE_FILE_MAGIC, sizeof(TILE_FILE_MAGIC));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    auto pixelSize = getPixelSize(image.getFormat());
+    auto physicalTileSize = layout.getPhysicalTileSize();
+    std::vector<uint8_t> tile(size_t(physicalTileSize) * physicalTileSize * pixelSize);
+    for (auto level = 0u; level < layout.getLevelCount(); ++level) {
+        // Chains stop at 1x1: levels of a single tile past its end repeat its last level
+        const auto& source = level == 0 || mips.empty() ? image : *mips[std::min<size_t>(level, mips.size()) - 1];
+        auto width = int(source.getWidth()), height = int(source.getHeight());
+        for (auto tileY = 0u; tileY < layout.getTileCountY(level); ++tileY) {
+            for (auto tileX = 0u; tileX < layout.getTileCountX(level); ++tileX) {
+                // Pixels outside of the level repeat its edges, as GL_CLAMP_TO_EDGE would
+                auto originX = int(tileX * layout.getTileSize()) - int(border);
+                auto originY = int(tileY * layout.getTileSize()) - int(border);
+                for (auto y = 0u; y < physicalTileSize; ++y) {
+                    auto sourceY = std::min(std::max(originY + int(y), 0), height - 1);
+                    auto pSource = source.getData() + size_t(sourceY) * width * pixelSize;
+                    auto pDestination = tile.data() + size_t(y) * physicalTileSize * pixelSize;
+                    for (auto x = 0u; x < physicalTileSize; ++x) {
+                        auto sourceX = std::min(std::max(originX + int(x), 0), width - 1);
+                        std::memcpy(pDestination + x * pixelSize, pSource + sourceX * pixelSize, pixelSize);
+                    }
+                }
+                file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+            }
+        }
+    }
+
+    return bool(file);
+}
+
+FilePath getVirtualTexturePath(const FilePath& imagePath) {
+    return imagePath.addExt(".gvt");
+}
+
+FeedbackBuffer::FeedbackBuffer(unsigned int width, unsigned int height):
+    m_nWidth(width), m_nHeight(height) {
+    glGenRenderbuffers(2, m_Renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_nFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_nFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Feedback framebuffer of " << width << "x" << height << " is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(2, m_PackBuffers);
+    for (auto buffer: m_PackBuffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FeedbackBuffer::~FeedbackBuffer() {
+    glDeleteBuffers(2, m_PackBuffers);
+    glDeleteFramebuffers(1, &m_nFramebuffer);
+    glDeleteRenderbuffers(2, m_Renderbuffers);
+}
+
+void FeedbackBuffer::begin() {
+    glGetIntegerv(GL_VIEWPORT, m_Viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_nFramebuffer);
+    glViewport(0, 0, m_nWidth, m_nHeight);
+
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+void FeedbackBuffer::end() {
+    auto size = size_t(m_nWidth) * m_nHeight * 4;
+    auto current = m_nPassCount % 2;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PackBuffers[current]);
+    glReadPixels(0, 0, m_nWidth, m_nHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // The copy of the previous pass had a frame to complete
+    if (m_nPassCount > 0) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PackBuffers[1 - current]);
+        auto pPixels = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+        if (pPixels) {
+            m_Pixels.assign(pPixels, pPixels + size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(m_Viewport[0], m_Viewport[1], m_Viewport[2], m_Viewport[3]);
+    ++m_nPassCount;
+}
+
+std::unique_ptr<VirtualTexture> VirtualTexture::load(const FilePath& imagePath, unsigned int slotCountX,
+                                                     unsigned int slotCountY, unsigned int tileSize,
+                                                     unsigned int border) {
+    auto tilePath = getVirtualTexturePath(imagePath);
+    VirtualTextureFile file;
+    // A source edited since the tiles were baked, or other tile settings, wins over the file
+    auto tileTime = getModificationTime(tilePath);
+    auto upToDate = tileTime && tileTime >= getModificationTime(imagePath) && file.open(tilePath)
+        && file.getLayout().getTileSize() == tileSize && file.getLayout().getBorder() == border;
+    if (!upToDate) {
+        if (tileTime) {
+            std::clog << tilePath << " is out of date" << std::endl;
+        }
+        auto pImage = loadImage(imagePath);
+        if (!pImage) {
+            std::cerr << "Unable to load the virtual texture " << imagePath << std::endl;
+            return nullptr;
+        }
+        if (!bakeVirtualTexture(tilePath, *pImage, tileSize, border) || !file.open(tilePath)) {
+            return nullptr;
+        }
+    }
+    return std::unique_ptr<VirtualTexture>(new VirtualTexture(std::move(file), slotCountX, slotCountY));
+}
+
+VirtualTexture::VirtualTexture(VirtualTextureFile file, unsigned int slotCountX, unsigned int slotCountY):
+    m_File(std::move(file)),
+    m_Residency(m_File.getLayout(), slotCountX, slotCountY),
+    m_TileData(m_File.getTileDataSize()) {
+    const auto& layout = m_File.getLayout();
+    auto physicalTileSize = layout.getPhysicalTileSize();
+    auto format = m_File.getFormat();
+
+    glGenTextures(1, &m_nPhysicalTexture);
+    glBindTexture(GL_TEXTURE_2D, m_nPhysicalTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, getGLInternalFormat(format), m_Residency.getSlotCountX() * physicalTileSize,
+                   m_Residency.getSlotCountY() * physicalTileSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // The tile of the last level, in slot 0 for good
+    if (m_File.readTile(TileId { layout.getLevelCount() - 1, 0u, 0u }, m_TileData.data())) {
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, physicalTileSize, physicalTileSize, getGLFormat(format),
+                        getGLType(format), m_TileData.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+
+    glGenTextures(1, &m_nPageTableTexture);
+    glBindTexture(GL_TEXTURE_2D, m_nPageTableTexture);
+    glTexStorage2D(GL_TEXTURE_2D, layout.getLevelCount(), GL_RGBA8, layout.getPageTableWidth(0), layout.getPageTableHeight(0));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, layout.getLevelCount() - 1);
+    uploadPageTable();
+}
+
+VirtualTexture::~VirtualTexture() {
+    glDeleteTextures(1, &m_nPhysicalTexture);
+    glDeleteTextures(1, &m_nPageTableTexture);
+}
+
+unsigned int VirtualTexture::update(unsigned int maxLoadCount) {
+    auto loads = m_Residency.update(maxLoadCount);
+    auto physicalTileSize = m_File.getLayout().getPhysicalTileSize();
+    auto format = m_File.getFormat();
+
+    // Rows are 4 bytes aligned by default, which R8 and RG8 rows are not always
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, m_nPhysicalTexture);
+    for (const auto& load: loads) {
+        if (!m_File.readTile(load.m_Tile, m_TileData.data())) {
+            continue;
+        }
+        auto slotX = load.m_nSlot % m_Residency.getSlotCountX(), slotY = load.m_nSlot / m_Residency.getSlotCountX();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slotX * physicalTileSize, slotY * physicalTileSize,
+                        physicalTileSize, physicalTileSize, getGLFormat(format), getGLType(format), m_TileData.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    uploadPageTable();
+    return unsigned(loads.size());
+}
+
+void VirtualTexture::uploadPageTable() {
+    const auto& layout = m_Residency.getLayout();
+    glBindTexture(GL_TEXTURE_2D, m_nPageTableTexture);
+    for (auto level = 0u; level < layout.getLevelCount(); ++level) {
+        unsigned int begin, end;
+        if (m_Residency.getDirtyRows(level, begin, end)) {
+            auto width = layout.getPageTableWidth(level);
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, begin, width, end - begin, GL_RGBA, GL_UNSIGNED_BYTE,
+                            m_Residency.getPageTable(level) + size_t(begin) * width * 4);
+        }
+    }
+    m_Residency.clearDirtyRows();
+}
+
+void VirtualTexture::setUniforms(GLuint program, GLuint physicalUnit, GLuint pageTableUnit) const {
+    const auto& layout = m_Residency.getLayout();
+    glActiveTexture(GL_TEXTURE0 + physicalUnit);
+    glBindTexture(GL_TEXTURE_2D, m_nPhysicalTexture);
+    glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+    glBindTexture(GL_TEXTURE_2D, m_nPageTableTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(glGetUniformLocation(program, "uVTPhysical"), physicalUnit);
+    glUniform1i(glGetUniformLocation(program, "uVTPageTable"), pageTableUnit);
+    glUniform2i(glGetUniformLocation(program, "uVTVirtualSize"), layout.getWidth(), layout.getHeight());
+    glUniform1i(glGetUniformLocation(program, "uVTTileSize"), layout.getTileSize());
+    glUniform1i(glGetUniformLocation(program, "uVTBorder"), layout.getBorder());
+    glUniform1i(glGetUniformLocation(program, "uVTLevelCount"), layout.getLevelCount());
+    glUniform2i(glGetUniformLocation(program, "uVTSlotCount"), m_Residency.getSlotCountX(), m_Residency.getSlotCountY());
+}
+
+}
@@ -5,6 +5,7 @@
 //
 
 //
+// glimac:        Parse .obj files in parallel chunks split at line boundaries.
 // version 0.9.7: Support multi-materials(per-face material ID) per object/group.
 // version 0.9.6: Support Ni(index of refraction) mtl parameter.
 //                Parse transmittance material parameter correctly.
@@ -27,6 +28,8 @@
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <thread>
 
 #include "tiny_obj_loader.h"
 
@@ -39,16 +42,87 @@ struct vertex_index {
   vertex_index(int vidx, int vtidx, int vnidx) : v_idx(vidx), vt_idx(vtidx), vn_idx(vnidx) {};
 
 };
-// for std::map
-static inline bool operator<(const vertex_index& a, const vertex_index& b)
+static inline bool operator==(const vertex_index& a, const vertex_index& b)
 {
-  if (a.v_idx != b.v_idx) return (a.v_idx < b.v_idx);
-  if (a.vn_idx != b.vn_idx) return (a.vn_idx < b.vn_idx);
-  if (a.vt_idx != b.vt_idx) return (a.vt_idx < b.vt_idx);
-
-  return false;
+  return a.v_idx == b.v_idx && a.vn_idx == b.vn_idx && a.vt_idx == b.vt_idx;
 }
 
+// Flat open-addressing (linear probing) map from vertex_index to the index of
+// the emitted vertex. Keys and values live in two preallocated arrays, so a
+// lookup is a hash and a few contiguous compares, without node allocations.
+class vertex_cache {
+public:
+  // 'expected' is an estimate of the number of unique vertices.
+  explicit vertex_cache(size_t expected) : size_(0) {
+    size_t capacity = 16;
+    while (capacity < 2 * expected) {
+      capacity <<= 1;
+    }
+    allocate(capacity);
+  }
+
+  // Returns the value slot of 'key'. A new slot holds EMPTY.
+  unsigned int& operator[](const vertex_index& key) {
+    size_t slot = probe(key);
+    if (values_[slot] == EMPTY) {
+      // Keep the load factor under 3/4
+      if (4 * (size_ + 1) > 3 * keys_.size()) {
+        grow();
+        slot = probe(key);
+      }
+      keys_[slot] = key;
+      ++size_;
+    }
+    return values_[slot];
+  }
+
+  static const unsigned int EMPTY = 0xFFFFFFFFu;
+
+private:
+  static size_t hash(const vertex_index& key) {
+    unsigned int h = (unsigned int) key.v_idx * 0x9E3779B1u;
+    h ^= (unsigned int) key.vt_idx * 0x85EBCA77u + (h << 6) + (h >> 2);
+    h ^= (unsigned int) key.vn_idx * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    return h;
+  }
+
+  size_t probe(const vertex_index& key) const {
+    size_t mask = keys_.size() - 1;
+    size_t slot = hash(key) & mask;
+    while (values_[slot] != EMPTY && !(keys_[slot] == key)) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void allocate(size_t capacity) {
+    keys_.assign(capacity, vertex_index(-1));
+    values_.assign(capacity, EMPTY);
+  }
+
+  void grow() {
+    std::vector<vertex_index> keys;
+    std::vector<unsigned int> values;
+    keys.swap(keys_);
+    values.swap(values_);
+    allocate(2 * keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (values[i] != EMPTY) {
+        size_t slot = probe(keys[i]);
+        keys_[slot] = keys[i];
+        values_[slot] = values[i];
+      }
+    }
+  }
+
+  std::vector<vertex_index> keys_;
+  std::vector<unsigned int> values_;
+  size_t size_;
+};
+
+const unsigned int vertex_cache::EMPTY;
+
 struct obj_shape {
   std::vector<float> v;
   std::vector<float> vn;
@@ -163,7 +237,7 @@ static vertex_index parseTriple(
 
 static unsigned int
 updateVertex(
-  std::map<vertex_index, unsigned int>& vertexCache,
+  vertex_cache& vertexCache,
   std::vector<float>& positions,
   std::vector<float>& normals,
   std::vector<float>& texcoords,
@@ -172,11 +246,11 @@ updateVertex(
   const std::vector<float>& in_texcoords,
   const vertex_index& i)
 {
-  const std::map<vertex_index, unsigned int>::iterator it = vertexCache.find(i);
+  unsigned int& cached = vertexCache[i];
 
-  if (it != vertexCache.end()) {
+  if (cached != vertex_cache::EMPTY) {
     // found cache
-    return it->second;
+    return cached;
   }
 
   assert(in_positions.size() > (unsigned int) (3*i.v_idx+2));
@@ -197,7 +271,7 @@ updateVertex(
   }
 
   unsigned int idx = positions.size() / 3 - 1;
-  vertexCache[i] = idx;
+  cached = idx;
 
   return idx;
 }
@@ -225,14 +299,12 @@ void InitMaterial(material_t& material) {
 static bool
 exportFaceGroupToShape(
   shape_t& shape,
-  std::map<vertex_index, unsigned int> vertexCache,
   const std::vector<float> &in_positions,
   const std::vector<float> &in_normals,
   const std::vector<float> &in_texcoords,
   const std::vector<std::vector<vertex_index> >& faceGroup,
   const int material_id,
-  const std::string &name,
-  bool clearCache)
+  const std::string &name)
 {
   if (faceGroup.empty()) {
     return false;
@@ -242,6 +314,14 @@ exportFaceGroupToShape(
 
   offset = shape.mesh.indices.size();
 
+  // Vertices are deduplicated within the face group. Most corners are shared,
+  // so the number of referenced positions is a good capacity estimate.
+  size_t cornerCount = 0;
+  for (size_t i = 0; i < faceGroup.size(); i++) {
+    cornerCount += faceGroup[i].size();
+  }
+  vertex_cache vertexCache(std::min(cornerCount, in_positions.size() / 3));
+
   // Flatten vertices and indices
   for (size_t i = 0; i < faceGroup.size(); i++) {
     const std::vector<vertex_index>& face = faceGroup[i];
@@ -272,9 +352,6 @@ exportFaceGroupToShape(
 
   shape.name = name;
 
-  if (clearCache)
-      vertexCache.clear();
-
   return true;
 
 }
@@ -490,31 +567,388 @@ std::string MaterialFileReader::operator() (
   return LoadMtl(matMap, materials, matIStream);
 }
 
+// Face corner parsed by a chunk. Positive indices are already zero-based,
+// negative (relative) ones are resolved against the chunk-local counts and
+// flagged so the merge step can add the number of elements of the previous chunks.
+struct chunk_index {
+  int v_idx, vt_idx, vn_idx;
+  unsigned char relative; // bit 0: v, bit 1: vt, bit 2: vn
+};
+
+enum chunk_command_type {
+  CHUNK_FACE,
+  CHUNK_USEMTL,
+  CHUNK_MTLLIB,
+  CHUNK_GROUP,
+  CHUNK_OBJECT
+};
+
+// Records whose effect depends on the global parser state are replayed in
+// file order by the merge step.
+struct chunk_command {
+  chunk_command_type type;
+  size_t face_offset, face_size; // range in obj_chunk::indices (faces only)
+  std::string name;
+};
+
+struct obj_chunk {
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+  std::vector<chunk_index> indices;
+  std::vector<chunk_command> commands;
+};
+
+static inline int parseChunkIndex(const char*& token, int n, unsigned char bit, unsigned char& relative)
+{
+  int idx = atoi(token);
+  if (idx < 0) {
+    relative |= bit;
+  }
+  token += strcspn(token, "/ \t\r");
+  return fixIndex(idx, n);
+}
+
+// Same grammar as parseTriple()
+static chunk_index parseChunkTriple(
+  const char* &token,
+  int vsize,
+  int vnsize,
+  int vtsize)
+{
+    chunk_index ci;
+    ci.v_idx = ci.vt_idx = ci.vn_idx = -1;
+    ci.relative = 0;
+
+    ci.v_idx = parseChunkIndex(token, vsize, 1, ci.relative);
+    if (token[0] != '/') {
+      return ci;
+    }
+    token++;
+
+    // i//k
+    if (token[0] == '/') {
+      token++;
+      ci.vn_idx = parseChunkIndex(token, vnsize, 4, ci.relative);
+      return ci;
+    }
+
+    // i/j/k or i/j
+    ci.vt_idx = parseChunkIndex(token, vtsize, 2, ci.relative);
+    if (token[0] != '/') {
+      return ci;
+    }
+
+    // i/j/k
+    token++;  // skip '/'
+    ci.vn_idx = parseChunkIndex(token, vnsize, 4, ci.relative);
+    return ci;
+}
+
+// Parses the lines of [begin, end). Line terminators are overwritten with
+// '\0' so each line can be handled like the getline() buffer of the serial path.
+static void parseChunk(obj_chunk& chunk, char* begin, char* end)
+{
+  char* line = begin;
+  while (line < end) {
+    char* eol = static_cast<char*>(memchr(line, '\n', end - line));
+    if (!eol) {
+      eol = end;
+    }
+    *eol = '\0';
+    if (eol > line && eol[-1] == '\r') {
+      eol[-1] = '\0';
+    }
+
+    const char* token = line;
+    line = eol + 1;
+
+    // Skip leading space.
+    token += strspn(token, " \t");
+
+    if (token[0] == '\0') continue; // empty line
+
+    if (token[0] == '#') continue;  // comment line
+
+    // vertex
+    if (token[0] == 'v' && isSpace((token[1]))) {
+      token += 2;
+      float x, y, z;
+      parseFloat3(x, y, z, token);
+      chunk.v.push_back(x);
+      chunk.v.push_back(y);
+      chunk.v.push_back(z);
+      continue;
+    }
+
+    // normal
+    if (token[0] == 'v' && token[1] == 'n' && isSpace((token[2]))) {
+      token += 3;
+      float x, y, z;
+      parseFloat3(x, y, z, token);
+      chunk.vn.push_back(x);
+      chunk.vn.push_back(y);
+      chunk.vn.push_back(z);
+      continue;
+    }
+
+    // texcoord
+    if (token[0] == 'v' && token[1] == 't' && isSpace((token[2]))) {
+      token += 3;
+      float x, y;
+      parseFloat2(x, y, token);
+      chunk.vt.push_back(x);
+      chunk.vt.push_back(y);
+      continue;
+    }
+
+    // face
+    if (token[0] == 'f' && isSpace((token[1]))) {
+      token += 2;
+      token += strspn(token, " \t");
+
+      chunk_command cmd;
+      cmd.type = CHUNK_FACE;
+      cmd.face_offset = chunk.indices.size();
+      while (!isNewLine(token[0])) {
+        chunk_index ci = parseChunkTriple(token, chunk.v.size() / 3, chunk.vn.size() / 3, chunk.vt.size() / 2);
+        chunk.indices.push_back(ci);
+        int n = strspn(token, " \t\r");
+        token += n;
+      }
+      cmd.face_size = chunk.indices.size() - cmd.face_offset;
+      chunk.commands.push_back(cmd);
+
+      continue;
+    }
+
+    // use mtl / load mtl
+    bool usemtl = (0 == strncmp(token, "usemtl", 6)) && isSpace((token[6]));
+    if (usemtl || ((0 == strncmp(token, "mtllib", 6)) && isSpace((token[6])))) {
+      char namebuf[4096];
+      namebuf[0] = '\0';
+      token += 7;
+      sscanf(token, "%s", namebuf);
+
+      chunk_command cmd;
+      cmd.type = usemtl ? CHUNK_USEMTL : CHUNK_MTLLIB;
+      cmd.name = namebuf;
+      chunk.commands.push_back(cmd);
+      continue;
+    }
+
+    // group name
+    if (token[0] == 'g' && isSpace((token[1]))) {
+      std::vector<std::string> names;
+      while (!isNewLine(token[0])) {
+        std::string str = parseString(token);
+        names.push_back(str);
+        token += strspn(token, " \t\r"); // skip tag
+      }
+
+      chunk_command cmd;
+      cmd.type = CHUNK_GROUP;
+      // names[0] must be 'g', so skipt 0th element.
+      if (names.size() > 1) {
+        cmd.name = names[1];
+      }
+      chunk.commands.push_back(cmd);
+      continue;
+    }
+
+    // object name
+    if (token[0] == 'o' && isSpace((token[1]))) {
+      char namebuf[4096];
+      namebuf[0] = '\0';
+      token += 2;
+      sscanf(token, "%s", namebuf);
+
+      chunk_command cmd;
+      cmd.type = CHUNK_OBJECT;
+      cmd.name = namebuf;
+      chunk.commands.push_back(cmd);
+      continue;
+    }
+
+    // Ignore unknown command.
+  }
+}
+
+// Concatenates the attributes of the chunks and replays their commands in
+// file order, exactly like the serial LoadObj() loop does.
+static std::string mergeChunks(
+  std::vector<shape_t>& shapes,
+  std::vector<material_t>& materials,
+  std::vector<obj_chunk>& chunks,
+  MaterialReader& readMatFn)
+{
+  std::vector<float> v;
+  std::vector<float> vn;
+  std::vector<float> vt;
+
+  size_t nv = 0, nvn = 0, nvt = 0;
+  for (size_t c = 0; c < chunks.size(); c++) {
+    nv += chunks[c].v.size();
+    nvn += chunks[c].vn.size();
+    nvt += chunks[c].vt.size();
+  }
+  v.reserve(nv);
+  vn.reserve(nvn);
+  vt.reserve(nvt);
+
+  std::vector<std::vector<vertex_index> > faceGroup;
+  std::string name;
+
+  // material
+  std::map<std::string, int> material_map;
+  int  material = -1;
+
+  shape_t shape;
+
+  for (size_t c = 0; c < chunks.size(); c++) {
+    obj_chunk& chunk = chunks[c];
+
+    // Number of elements defined by the previous chunks.
+    int vOffset = v.size() / 3;
+    int vnOffset = vn.size() / 3;
+    int vtOffset = vt.size() / 2;
+
+    v.insert(v.end(), chunk.v.begin(), chunk.v.end());
+    vn.insert(vn.end(), chunk.vn.begin(), chunk.vn.end());
+    vt.insert(vt.end(), chunk.vt.begin(), chunk.vt.end());
+    std::vector<float>().swap(chunk.v);
+    std::vector<float>().swap(chunk.vn);
+    std::vector<float>().swap(chunk.vt);
+
+    for (size_t k = 0; k < chunk.commands.size(); k++) {
+      const chunk_command& cmd = chunk.commands[k];
+
+      if (cmd.type == CHUNK_FACE) {
+        std::vector<vertex_index> face(cmd.face_size);
+        for (size_t j = 0; j < cmd.face_size; j++) {
+          const chunk_index& ci = chunk.indices[cmd.face_offset + j];
+          face[j].v_idx = (ci.relative & 1) ? ci.v_idx + vOffset : ci.v_idx;
+          face[j].vt_idx = (ci.relative & 2) ? ci.vt_idx + vtOffset : ci.vt_idx;
+          face[j].vn_idx = (ci.relative & 4) ? ci.vn_idx + vnOffset : ci.vn_idx;
+        }
+        faceGroup.push_back(face);
+        continue;
+      }
+
+      if (cmd.type == CHUNK_USEMTL) {
+        exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+        faceGroup.clear();
+
+        if (material_map.find(cmd.name) != material_map.end()) {
+          material = material_map[cmd.name];
+        } else {
+          // { error!! material not found }
+          material = -1;
+        }
+        continue;
+      }
+
+      if (cmd.type == CHUNK_MTLLIB) {
+        std::string err_mtl = readMatFn(cmd.name, materials, material_map);
+        if (!err_mtl.empty()) {
+          return err_mtl;
+        }
+        continue;
+      }
+
+      // group or object name: flush previous face group.
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+      if (ret) {
+        shapes.push_back(shape);
+      }
+
+      shape = shape_t();
+      faceGroup.clear();
+      name = cmd.name;
+    }
+
+    std::vector<chunk_index>().swap(chunk.indices);
+    std::vector<chunk_command>().swap(chunk.commands);
+  }
+
+  bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
+  if (ret) {
+    shapes.push_back(shape);
+  }
+
+  return std::string();
+}
+
 std::string
 LoadObj(
   std::vector<shape_t>& shapes,
   std::vector<material_t>& materials,   // [output]
   const char* filename,
-  const char* mtl_basepath)
+  const char* mtl_basepath,
+  unsigned int num_threads)
 {
 
   shapes.clear();
 
   std::stringstream err;
 
-  std::ifstream ifs(filename);
+  std::ifstream ifs(filename, std::ios::binary);
   if (!ifs) {
     err << "Cannot open file [" << filename << "]" << std::endl;
     return err.str();
   }
 
+  ifs.seekg(0, std::ios::end);
+  std::streamoff fileSize = ifs.tellg();
+  if (fileSize < 0) {
+    err << "Cannot seek in file [" << filename << "]" << std::endl;
+    return err.str();
+  }
+  ifs.seekg(0, std::ios::beg);
+
+  std::vector<char> buf(fileSize + 1);
+  if (fileSize > 0 && !ifs.read(&buf[0], fileSize)) {
+    err << "Cannot read file [" << filename << "]" << std::endl;
+    return err.str();
+  }
+  buf[fileSize] = '\0';
+  ifs.close();
+
   std::string basePath;
   if (mtl_basepath) {
     basePath = mtl_basepath;
   }
   MaterialFileReader matFileReader( basePath );
-  
-  return LoadObj(shapes, materials, ifs, matFileReader);
+
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Don't bother spawning threads for small files.
+  const std::streamoff minChunkSize = 1 << 20;
+  size_t chunkCount = std::max<std::streamoff>(1, std::min<std::streamoff>(num_threads, fileSize / minChunkSize));
+
+  // Split at line boundaries.
+  std::vector<char*> bounds(chunkCount + 1);
+  char* data = &buf[0];
+  bounds[0] = data;
+  bounds[chunkCount] = data + fileSize;
+  for (size_t c = 1; c < chunkCount; c++) {
+    char* p = std::max(bounds[c - 1], data + fileSize * c / chunkCount);
+    char* eol = static_cast<char*>(memchr(p, '\n', data + fileSize - p));
+    bounds[c] = eol ? eol + 1 : data + fileSize;
+  }
+
+  std::vector<obj_chunk> chunks(chunkCount);
+  std::vector<std::thread> workers;
+  for (size_t c = 1; c < chunkCount; c++) {
+    workers.push_back(std::thread(parseChunk, std::ref(chunks[c]), bounds[c], bounds[c + 1]));
+  }
+  parseChunk(chunks[0], bounds[0], bounds[1]);
+  for (size_t c = 0; c < workers.size(); c++) {
+    workers[c].join();
+  }
+
+  return mergeChunks(shapes, materials, chunks, matFileReader);
 }
 
 std::string LoadObj(
@@ -533,7 +967,6 @@ std::string LoadObj(
 
   // material
   std::map<std::string, int> material_map;
-  std::map<vertex_index, unsigned int> vertexCache;
   int  material = -1;
 
   shape_t shape;
@@ -624,7 +1057,7 @@ std::string LoadObj(
       token += 7;
       sscanf(token, "%s", namebuf);
 
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, false);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
       faceGroup.clear();
 
       if (material_map.find(namebuf) != material_map.end()) {
@@ -657,7 +1090,7 @@ std::string LoadObj(
     if (token[0] == 'g' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
       if (ret) {
         shapes.push_back(shape);
       }
@@ -690,7 +1123,7 @@ std::string LoadObj(
     if (token[0] == 'o' && isSpace((token[1]))) {
 
       // flush previous face group.
-      bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+      bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
       if (ret) {
         shapes.push_back(shape);
       }
@@ -712,7 +1145,7 @@ std::string LoadObj(
     // Ignore unknown command.
   }
 
-  bool ret = exportFaceGroupToShape(shape, vertexCache, v, vn, vt, faceGroup, material, name, true);
+  bool ret = exportFaceGroupToShape(shape, v, vn, vt, faceGroup, material, name);
   if (ret) {
     shapes.push_back(shape);
   }
@@ -81,11 +81,15 @@ class MaterialFileReader:
 /// The function returns error string.
 /// Returns empty string when loading .obj success.
 /// 'mtl_basepath' is optional, and used for base path for .mtl file.
+/// The file is split at line boundaries and its chunks are parsed by up to
+/// 'num_threads' threads (0 = hardware concurrency). The result is the same as
+/// the serial std::istream loader.
 std::string LoadObj(
     std::vector<shape_t>& shapes,   // [output]
     std::vector<material_t>& materials,   // [output]
     const char* filename,
-    const char* mtl_basepath = NULL);
+    const char* mtl_basepath = NULL,
+    unsigned int num_threads = 0);
 
 /// Loads object from a std::istream, uses GetMtlIStreamFn to retrieve
 /// std::istream for materials.
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <iostream>
+#include <cstdlib>
+
+// Checks of the test executables: failures are reported on std::cerr and counted, main() returns
+// getTestResult()
+
+inline unsigned int& getFailureCount() {
+    static unsigned int failureCount = 0u;
+    return failureCount;
+}
+
+inline bool check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++getFailureCount();
+    }
+    return condition;
+}
+
+inline int getTestResult() {
+    if (getFailureCount()) {
+        std::cerr << getFailureCount() << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Exit code of a test that can't run here (no GL context)
+const int TEST_SKIPPED = 77;
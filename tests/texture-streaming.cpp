@@ -0,0 +1,219 @@
+#include <glimac/SDLWindowManager.hpp>
+#include <GL/glew.h>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include <glimac/TextureStreamer.hpp>
+#include "Test.hpp"
+
+using namespace glimac;
+
+// Streams textures through TextureStreamer and reads them back. Needs a GL context, skipped without
+// one: on a headless machine, run it on Mesa's software renderer under a virtual display, e.g.
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ctest
+
+namespace {
+
+void fillRandom(uint8_t* pData, size_t size, unsigned int seed) {
+    std::mt19937 random(seed);
+    for (auto i = 0u; i < size; ++i) {
+        pData[i] = uint8_t(random());
+    }
+}
+
+std::shared_ptr<Image> makeImage(unsigned int width, unsigned int height, PixelFormat format, unsigned int seed) {
+    auto pImage = std::make_shared<Image>(width, height, format);
+    fillRandom(pImage->getData(), pImage->getDataSize(), seed);
+    return pImage;
+}
+
+// Texture with storage for the level 0 of the image, no data
+GLuint createTexture(const Image& image) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, getGLInternalFormat(image.getFormat()), image.getWidth(), image.getHeight(), 0,
+                 getGLFormat(image.getFormat()), getGLType(image.getFormat()), nullptr);
+    return texture;
+}
+
+bool isTextureEqual(GLuint texture, const Image& image) {
+    std::vector<uint8_t> pixels(image.getDataSize());
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, getGLFormat(image.getFormat()), getGLType(image.getFormat()), pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    return std::equal(begin(pixels), end(pixels), image.getData());
+}
+
+// Calls update() once per frame until done, returns the number of frames
+unsigned int streamUntil(TextureStreamer& streamer, const bool& done, float timeBudget, size_t maxBandSize) {
+    auto frameCount = 0u;
+    while (!done && frameCount < 100000u) {
+        auto size = streamer.update(timeBudget);
+        if (timeBudget == 0.f) {
+            check(size <= maxBandSize, "a zero budget issues one band per frame at most");
+        }
+        glFlush();
+        ++frameCount;
+    }
+    return frameCount;
+}
+
+void testBandsOverFrames() {
+    auto pImage = makeImage(1000, 777, PixelFormat::RGBA8, 1u);
+    auto texture = createTexture(*pImage);
+
+    // 100 rows per slot: 8 bands
+    const size_t slotSize = 100u * 4000u + 123u;
+    TextureStreamer streamer(3u, slotSize);
+    auto done = false;
+    streamer.enqueue(texture, GL_TEXTURE_2D, 0, pImage, [&done]() {
+        done = true;
+    });
+    check(streamer.getPendingUploadCount() == 1u, "the upload is queued");
+
+    auto frameCount = streamUntil(streamer, done, 0.f, slotSize);
+    check(done, "RGBA8: onComplete ran");
+    check(frameCount >= 8u, "RGBA8: the upload was spread over several frames");
+    check(streamer.getPendingUploadCount() == 0u, "RGBA8: no upload left");
+    check(isTextureEqual(texture, *pImage), "RGBA8: texture equal to the image");
+
+    glDeleteTextures(1, &texture);
+}
+
+void testUnalignedRows() {
+    // 333 bytes rows are not 4 bytes aligned
+    auto pImage = makeImage(333, 211, PixelFormat::R8, 2u);
+    auto texture = createTexture(*pImage);
+
+    TextureStreamer streamer(2u, 333u * 50u);
+    auto done = false;
+    streamer.enqueue(texture, GL_TEXTURE_2D, 0, pImage, [&done]() {
+        done = true;
+    });
+    streamUntil(streamer, done, 2.f, 0u);
+    check(done, "R8: onComplete ran");
+    check(isTextureEqual(texture, *pImage), "R8: texture equal to the image");
+
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    check(alignment == 4, "the unpack alignment is restored");
+
+    glDeleteTextures(1, &texture);
+}
+
+void testClientMemoryFallback() {
+    // Rows of 256 bytes do not fit in slots of 100 bytes
+    auto pImage = makeImage(64, 16, PixelFormat::RGBA8, 3u);
+    auto texture = createTexture(*pImage);
+
+    TextureStreamer streamer(2u, 100u);
+    auto done = false;
+    streamer.enqueue(texture, GL_TEXTURE_2D, 0, pImage, [&done]() {
+        done = true;
+    });
+    streamUntil(streamer, done, 0.f, 256u);
+    check(done, "rows larger than a slot: onComplete ran");
+    check(isTextureEqual(texture, *pImage), "rows larger than a slot: texture equal to the image");
+
+    glDeleteTextures(1, &texture);
+}
+
+void testCompressed() {
+    if (!GLEW_EXT_texture_compression_s3tc) {
+        std::clog << "No S3TC support, compressed uploads not tested" << std::endl;
+        return;
+    }
+
+    // Any bytes are valid BC1 blocks
+    auto pImage = std::make_shared<CompressedImage>(256, 200, CompressedFormat::BC1, false);
+    fillRandom(pImage->getData(), pImage->getDataSize(), 4u);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    auto internalFormat = getGLInternalFormat(CompressedFormat::BC1, false);
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, 256, 200, 0, GLsizei(pImage->getDataSize()), nullptr);
+
+    // 10 rows of blocks per slot
+    const size_t slotSize = 10u * pImage->getBlockCountX() * getBlockSize(CompressedFormat::BC1);
+    TextureStreamer streamer(2u, slotSize);
+    auto done = false;
+    streamer.enqueue(texture, GL_TEXTURE_2D, 0, std::shared_ptr<const CompressedImage>(pImage), [&done]() {
+        done = true;
+    });
+    auto frameCount = streamUntil(streamer, done, 0.f, slotSize);
+    check(done, "BC1: onComplete ran");
+    check(frameCount >= 5u, "BC1: the upload was spread over several frames");
+
+    std::vector<uint8_t> blocks(pImage->getDataSize());
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetCompressedTexImage(GL_TEXTURE_2D, 0, blocks.data());
+    check(std::equal(begin(blocks), end(blocks), pImage->getData()), "BC1: texture equal to the blocks");
+
+    glDeleteTextures(1, &texture);
+}
+
+void testUploadsFromAnotherThread() {
+    std::vector<std::shared_ptr<Image>> images;
+    std::vector<GLuint> textures;
+    for (auto i = 0u; i < 4u; ++i) {
+        images.push_back(makeImage(128, 64 + 16 * i, PixelFormat::RGBA8, 10u + i));
+        textures.push_back(createTexture(*images.back()));
+    }
+
+    TextureStreamer streamer(4u, 128u * 4u * 16u);
+    std::vector<unsigned int> completed; // Only written on this thread, by update()
+    std::thread producer([&]() {
+        for (auto i = 0u; i < images.size(); ++i) {
+            streamer.enqueue(textures[i], GL_TEXTURE_2D, 0, images[i], [&completed, i]() {
+                completed.push_back(i);
+            });
+        }
+    });
+    producer.join();
+
+    auto done = false;
+    for (auto frame = 0u; frame < 100000u && !done; ++frame) {
+        streamer.update(0.5f);
+        glFlush();
+        done = completed.size() == images.size();
+    }
+    check(done, "queued uploads: every onComplete ran");
+    check(std::is_sorted(begin(completed), end(completed)), "queued uploads: completed in order");
+    for (auto i = 0u; i < images.size(); ++i) {
+        check(isTextureEqual(textures[i], *images[i]), "queued uploads: texture equal to the image");
+    }
+
+    glDeleteTextures(GLsizei(textures.size()), textures.data());
+}
+
+}
+
+int main() {
+    SDLWindowManager windowManager(64, 64, "GLImac");
+    if (!SDL_GetVideoSurface()) {
+        std::cerr << "No GL context, test skipped" << std::endl;
+        return TEST_SKIPPED;
+    }
+
+    GLenum glewInitError = glewInit();
+    if (GLEW_OK != glewInitError || !GLEW_VERSION_3_2) {
+        std::cerr << "OpenGL 3.2 is not available, test skipped" << std::endl;
+        return TEST_SKIPPED;
+    }
+    std::cout << "OpenGL Renderer : " << glGetString(GL_RENDERER) << std::endl;
+
+    testBandsOverFrames();
+    testUnalignedRows();
+    testClientMemoryFallback();
+    testCompressed();
+    testUploadsFromAnotherThread();
+
+    return getTestResult();
+}
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <glimac/VirtualTexture.hpp>
+#include <glimac/MipChain.hpp>
+#include "Test.hpp"
+
+using namespace glimac;
+
+// Residency of virtual texture tiles, without GL: layouts of odd sizes, eviction order, loading order,
+// and the page table checked against the mip levels by emulating the lookup of the shader.
+
+namespace {
+
+// Page table entry of the tile: (slot x, slot y, level, 255)
+const uint8_t* getEntry(const TileResidency& residency, const TileId& tile) {
+    const auto& layout = residency.getLayout();
+    return residency.getPageTable(tile.m_nLevel) + 4 * (size_t(tile.m_nY) * layout.getPageTableWidth(tile.m_nLevel) + tile.m_nX);
+}
+
+bool isPowerOfTwo(unsigned int value) {
+    return value && !(value & (value - 1));
+}
+
+void testLayout(unsigned int width, unsigned int height, unsigned int tileSize) {
+    VirtualTextureLayout layout(width, height, tileSize, 4u);
+    auto last = layout.getLevelCount() - 1;
+    check(layout.getTileCountX(last) == 1u && layout.getTileCountY(last) == 1u, "layout: the last level is one tile");
+    check(layout.getPageTableWidth(last) == 1u && layout.getPageTableHeight(last) == 1u
+          && (last == 0u || layout.getPageTableWidth(last - 1) * layout.getPageTableHeight(last - 1) > 1u),
+          "layout: a level per level of the page table");
+
+    size_t tileCount = 0u;
+    for (auto level = 0u; level < layout.getLevelCount(); ++level) {
+        auto levelWidth = std::max(1u, width >> level), levelHeight = std::max(1u, height >> level);
+        check(layout.getTileCountX(level) == (levelWidth + tileSize - 1) / tileSize
+              && layout.getTileCountY(level) == (levelHeight + tileSize - 1) / tileSize,
+              "layout: tile counts round the level size up");
+        check(layout.getPageTableWidth(level) >= layout.getTileCountX(level)
+              && layout.getPageTableHeight(level) >= layout.getTileCountY(level),
+              "layout: the page table has an entry per tile");
+        check(isPowerOfTwo(layout.getPageTableWidth(level)) && isPowerOfTwo(layout.getPageTableHeight(level)),
+              "layout: page table sizes are powers of two");
+        check(layout.getTileIndex(TileId { level, 0u, 0u }) == tileCount, "layout: tiles sorted level by level");
+        tileCount += size_t(layout.getTileCountX(level)) * layout.getTileCountY(level);
+    }
+    check(layout.getTileCount() == tileCount, "layout: tile count of all levels");
+}
+
+void testEvictionOrder() {
+    // Level 0 of 2x2 tiles, level 1 of one tile in slot 0, 3 slots for level 0
+    VirtualTextureLayout layout(256u, 256u, 128u, 4u);
+    TileResidency residency(layout, 2u, 2u);
+    TileId a { 0u, 0u, 0u }, b { 0u, 1u, 0u }, c { 0u, 0u, 1u }, d { 0u, 1u, 1u };
+
+    for (const auto& tile: { a, b, c, a }) {
+        residency.request(tile);
+        residency.update(16u);
+    }
+    check(residency.isResident(a) && residency.isResident(b) && residency.isResident(c), "eviction: 3 tiles loaded");
+
+    // b is the least recently requested
+    residency.request(d);
+    auto loads = residency.update(16u);
+    check(loads.size() == 1u && loads[0].m_Tile.m_nX == 1u && loads[0].m_Tile.m_nY == 1u, "eviction: d loaded");
+    check(!residency.isResident(b), "eviction: the least recently requested tile is evicted");
+    check(residency.isResident(a) && residency.isResident(c) && residency.isResident(d), "eviction: the others stay");
+
+    // The page table of b falls back to the last level, in slot 0
+    auto pEntry = getEntry(residency, b);
+    check(pEntry[0] == 0u && pEntry[1] == 0u && pEntry[2] == 1u && pEntry[3] == 255u,
+          "eviction: an evicted tile points to its resident ancestor");
+    pEntry = getEntry(residency, d);
+    auto slot = loads[0].m_nSlot;
+    check(pEntry[0] == slot % 2u && pEntry[1] == slot / 2u && pEntry[2] == 0u, "eviction: a loaded tile points to its slot");
+
+    // Requested in the same frame, 4 tiles for 3 slots: one waits
+    TileResidency full(layout, 2u, 2u);
+    for (const auto& tile: { a, b, c, d }) {
+        full.request(tile);
+    }
+    check(full.update(16u).size() == 3u && full.getMissingTileCount() == 1u,
+          "eviction: tiles requested in the frame are never evicted");
+}
+
+void testLoadingOrder() {
+    // Levels of 4x4, 2x2 and 1 tiles
+    VirtualTextureLayout layout(512u, 512u, 128u, 4u);
+    TileResidency residency(layout, 4u, 4u);
+    TileId tile { 0u, 3u, 3u };
+
+    residency.request(tile);
+    auto loads = residency.update(1u);
+    check(loads.size() == 1u && loads[0].m_Tile.m_nLevel == 1u, "loading: the coarsest missing tile first");
+    check(getEntry(residency, tile)[2] == 1u, "loading: the page table points to the loaded parent");
+
+    unsigned int begin, end;
+    check(residency.getDirtyRows(0u, begin, end) && begin <= 2u && end == 4u, "loading: the changed rows are dirty");
+    residency.clearDirtyRows();
+    check(!residency.getDirtyRows(0u, begin, end), "loading: no dirty row after clearDirtyRows()");
+
+    residency.request(tile);
+    loads = residency.update(1u);
+    check(loads.size() == 1u && loads[0].m_Tile.m_nLevel == 0u && getEntry(residency, tile)[2] == 0u,
+          "loading: then the tile itself");
+}
+
+// Random views of the image through a residency of 4x4 slots, fed by the feedback pixels of their
+// samples: every page table entry must name the closest resident ancestor, and every sample read
+// through the page table in the slots must be the pixel of the mip level
+void testLookups(unsigned int width, unsigned int height, unsigned int tileSize) {
+    const unsigned int border = 4u, slotCountX = 4u, slotCountY = 4u;
+    const char* path = "tile-residency.gvt";
+
+    Image image(width, height, PixelFormat::RGBA8);
+    std::mt19937 random(width * 31u + height);
+    for (auto i = 0u; i < image.getDataSize(); ++i) {
+        image.getData()[i] = uint8_t(random());
+    }
+    VirtualTextureFile file;
+    auto isBaked = bakeVirtualTexture(path, image, tileSize, border) && file.open(path);
+    std::remove(path);
+    if (!check(isBaked, "lookups: tile file baked")) {
+        return;
+    }
+    auto mips = generateMipChain(image);
+    auto getLevel = [&](unsigned int level) -> const Image& {
+        return level == 0u ? image : *mips[level - 1];
+    };
+
+    const auto& layout = file.getLayout();
+    auto physicalTileSize = layout.getPhysicalTileSize();
+    TileResidency residency(layout, slotCountX, slotCountY);
+    std::vector<std::vector<uint8_t>> slots(slotCountX * slotCountY, std::vector<uint8_t>(file.getTileDataSize()));
+    file.readTile(TileId { layout.getLevelCount() - 1, 0u, 0u }, slots[0].data());
+
+    auto getLevelSize = [&](unsigned int level) {
+        return glm::ivec2(std::max(1u, width >> level), std::max(1u, height >> level));
+    };
+    auto getTileCount = [&](unsigned int level) {
+        return glm::ivec2(layout.getTileCountX(level), layout.getTileCountY(level));
+    };
+    auto getTile = [&](const glm::vec2& uv, unsigned int level) {
+        return glm::min(glm::ivec2(uv * glm::vec2(getLevelSize(level))) / int(tileSize), getTileCount(level) - 1);
+    };
+
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    size_t wrongEntryCount = 0u, wrongSampleCount = 0u;
+    for (auto frame = 0u; frame < 200u; ++frame) {
+        // 300 samples in a region covering a fifth of the image, at one of the 3 first levels
+        auto level = unsigned(random() % std::min(3u, layout.getLevelCount()));
+        auto origin = glm::vec2(uniform(random), uniform(random)) * 0.8f;
+        std::vector<glm::vec2> samples;
+        std::vector<uint8_t> feedback;
+        for (auto i = 0u; i < 300u; ++i) {
+            samples.push_back(origin + 0.2f * glm::vec2(uniform(random), uniform(random)));
+            auto tile = getTile(samples.back(), level);
+            feedback.insert(end(feedback), { uint8_t(tile.x & 255), uint8_t(tile.y & 255),
+                                             uint8_t((tile.x >> 8) | ((tile.y >> 8) << 4)), uint8_t(level + 1) });
+        }
+        feedback.insert(end(feedback), { 0u, 0u, 0u, 0u }); // Nothing drawn
+
+        residency.requestFeedback(feedback.data(), feedback.size() / 4);
+        for (const auto& load: residency.update(6u)) {
+            file.readTile(load.m_Tile, slots[load.m_nSlot].data());
+        }
+
+        for (auto l = 0u; l < layout.getLevelCount(); ++l) {
+            for (auto y = 0u; y < layout.getTileCountY(l); ++y) {
+                for (auto x = 0u; x < layout.getTileCountX(l); ++x) {
+                    TileId ancestor { l, x, y };
+                    while (!residency.isResident(ancestor)) {
+                        auto parentLevel = ancestor.m_nLevel + 1;
+                        ancestor = TileId { parentLevel, std::min(ancestor.m_nX / 2, layout.getTileCountX(parentLevel) - 1),
+                                            std::min(ancestor.m_nY / 2, layout.getTileCountY(parentLevel) - 1) };
+                    }
+                    wrongEntryCount += getEntry(residency, TileId { l, x, y })[2] != ancestor.m_nLevel;
+                }
+            }
+        }
+
+        // Lookup of the shader: the tile of the entry, at the level of the entry
+        for (const auto& uv: samples) {
+            auto tile = getTile(uv, level);
+            auto pEntry = getEntry(residency, TileId { level, unsigned(tile.x), unsigned(tile.y) });
+            unsigned int residentLevel = pEntry[2];
+            for (auto l = level; l < residentLevel; ++l) {
+                tile = glm::min(tile / 2, getTileCount(l + 1) - 1);
+            }
+            auto texel = uv * glm::vec2(getLevelSize(residentLevel));
+            auto inTile = glm::clamp(texel - glm::vec2(tile * int(tileSize)), glm::vec2(0.5f - border),
+                                     glm::vec2(tileSize + border - 0.5f));
+            auto pixel = glm::ivec2(glm::floor(glm::vec2(border) + inTile));
+            const auto& slot = slots[pEntry[0] + pEntry[1] * slotCountX];
+            auto pSample = &slot[4 * (size_t(pixel.y) * physicalTileSize + pixel.x)];
+
+            const auto& levelImage = getLevel(residentLevel);
+            auto expected = glm::min(glm::ivec2(glm::floor(texel)),
+                                     glm::ivec2(levelImage.getWidth() - 1, levelImage.getHeight() - 1));
+            auto pExpected = levelImage.getData() + 4 * (size_t(expected.y) * levelImage.getWidth() + expected.x);
+            wrongSampleCount += std::memcmp(pSample, pExpected, 4) != 0;
+        }
+    }
+    check(wrongEntryCount == 0u, "lookups: every entry names the closest resident ancestor");
+    check(wrongSampleCount == 0u, "lookups: every sample is the pixel of its level");
+}
+
+}
+
+int main() {
+    testLayout(1000u, 600u, 64u);
+    testLayout(3000u, 70u, 128u);
+    testLayout(4097u, 2049u, 128u);
+    testLayout(100u, 100u, 128u);
+
+    testEvictionOrder();
+    testLoadingOrder();
+
+    testLookups(1000u, 600u, 64u);
+    testLookups(3000u, 70u, 64u);
+    testLookups(4097u, 2049u, 128u);
+
+    return getTestResult();
+}